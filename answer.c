@@ -0,0 +1,189 @@
+/*
+* answer.c - hashed answer lookup (see answer.h)
+*
+* Per call: one pass over the input to normalize and hash it, a binary
+* search over the bank's answer index (sorted by hash), then one strcmp against
+* the stored normalized variant to rule out collisions. The cost depends on
+* the total bank size only logarithmically and not at all on how many
+* variants this particular question accepts.
+*
+* The hash is FNV-1a seeded with the question number, matching
+* tools/qbank_pack.py.
+*
+* With ANSWER_FUZZY, a miss falls back to a bounded edit-distance check
+* against the question's variants (Myers' bit-vector algorithm in Hyyrö's
+* formulation for global distance): one 32-bit word holds a whole column of
+* the DP matrix, so each input character costs about 15 word operations.
+*
+* answer_check() works on a loaded qstore item. With the bank in internal
+* flash it uses the index above; with a streamed bank it compares against
+* the item's variants directly.
+*/
+
+#include "answer.h"
+#include "qbank.h"
+#include "probe.h"
+#include <string.h>
+
+#define FNV_OFFSET 0x811C9DC5UL
+#define FNV_PRIME  0x01000193UL
+
+#define FNV_STEP(h, b) (((h) ^ (uint8_t)(b)) * FNV_PRIME)
+
+#ifndef ANSWER_MAX_LEN
+#define ANSWER_MAX_LEN 64
+#endif
+
+static int is_ws(char c)
+{
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+uint32_t answer_normalize_hash(const char *in, uint16_t q, char *out, size_t size)
+{
+   uint32_t h = FNV_OFFSET;
+   h = FNV_STEP(h, q & 0xFF);
+   h = FNV_STEP(h, q >> 8);
+
+   size_t n = 0;
+   uint8_t pending_space = 0;
+   while (*in && is_ws(*in)) in++;            /* leading whitespace */
+   for (; *in && n + 1 < size; ++in) {
+       char c = *in;
+       if (is_ws(c)) { pending_space = 1; continue; }
+       if (pending_space) {                  /* one space between words, */
+           if (n + 2 >= size) break;         /* none at the end */
+           out[n++] = ' ';
+           h = FNV_STEP(h, ' ');
+           pending_space = 0;
+       }
+       if (c >= 'A' && c <= 'Z') c = (char)(c + ('a' - 'A'));
+       out[n++] = c;
+       h = FNV_STEP(h, c);
+   }
+   if (size) out[n] = '\0';
+   return h;
+}
+
+#if ANSWER_FUZZY
+/* Pattern match masks, indexed by byte value. Only the entries for bytes of
+   the current pattern are set, and they are cleared again afterwards, so
+   each call touches O(pattern) entries instead of all 256. */
+static uint32_t peq[256];
+
+unsigned answer_edit_distance(const char *a, size_t la, const char *b, size_t lb, unsigned k)
+{
+   /* pattern = shorter string (distance is symmetric) */
+   if (la > lb) {
+       const char *t = a; a = b; b = t;
+       size_t tl = la; la = lb; lb = tl;
+   }
+   if (lb - la > k) return k + 1;
+   if (la == 0) return (unsigned)lb;
+   if (la > 32) return k + 1;
+
+   for (size_t i = 0; i < la; ++i) peq[(uint8_t)a[i]] |= 1UL << i;
+
+   const uint32_t top = 1UL << (la - 1);
+   uint32_t vp = (la == 32) ? 0xFFFFFFFFUL : ((1UL << la) - 1);
+   uint32_t vn = 0;
+   unsigned score = (unsigned)la;
+
+   for (size_t j = 0; j < lb; ++j) {
+       uint32_t eq = peq[(uint8_t)b[j]];
+       uint32_t xv = eq | vn;
+       uint32_t xh = (((eq & vp) + vp) ^ vp) | eq;
+       uint32_t hp = vn | ~(xh | vp);
+       uint32_t hn = vp & xh;
+       if (hp & top) score++;
+       else if (hn & top) score--;
+       /* global distance: row 0 grows by one per text character */
+       hp = (hp << 1) | 1UL;
+       hn <<= 1;
+       vp = hn | ~(xv | hp);
+       vn = hp & xv;
+       /* the remaining characters can lower the score by at most one each */
+       if (score > k + (unsigned)(lb - j - 1)) { score = k + 1; break; }
+   }
+
+   for (size_t i = 0; i < la; ++i) peq[(uint8_t)a[i]] = 0;
+   return score;
+}
+
+/* Allowed edits for a variant: the question's limit, but never more than
+   about a third of the variant's length, so "php" or "206" stay exact. */
+static unsigned fuzzy_limit(uint8_t max_dist, size_t variant_len)
+{
+   unsigned cap = variant_len ? (unsigned)((variant_len - 1) / 3) : 0;
+   return max_dist < cap ? max_dist : cap;
+}
+
+/* 1 if norm is within reach of one of nv back-to-back variants at v */
+static int fuzzy_any(const char *norm, const char *v, uint16_t nv, uint8_t max_dist)
+{
+   if (max_dist == 0) return 0;
+   size_t n = strlen(norm);
+   for (; nv; --nv, v = qstore_next_variant(v)) {
+       size_t m = strlen(v);
+       unsigned k = fuzzy_limit(max_dist, m);
+       if (k && answer_edit_distance(norm, n, v, m, k) <= k) return 1;
+   }
+   return 0;
+}
+#endif
+
+int answer_is_correct(const char *user_in, uint16_t q)
+{
+   char norm[ANSWER_MAX_LEN];
+   uint32_t h = answer_normalize_hash(user_in, q, norm, sizeof(norm));
+
+   uint16_t count;
+   const qbank_key_t *index = qbank_index(&count);
+   /* lower bound of h */
+   uint32_t lo = 0, hi = count;
+   while (lo < hi) {
+       uint32_t mid = (lo + hi) / 2;
+       if (index[mid].hash < h) lo = mid + 1;
+       else hi = mid;
+   }
+   for (; lo < count && index[lo].hash == h; ++lo) {
+       const qbank_key_t *k = &index[lo];
+       if (k->question == q && strcmp(qbank_variant(q, k->variant), norm) == 0) return 1;
+   }
+
+#if ANSWER_FUZZY
+   /* a question's variants are stored back to back (qbank.h) */
+   return fuzzy_any(norm, qbank_variant(q, 0), qbank_num_variants(q), qbank_max_dist(q));
+#else
+   return 0;
+#endif
+}
+
+static int item_check(const char *user_in, const qstore_item_t *it)
+{
+#if QSTORE_BACKEND == QSTORE_BACKEND_INTERNAL
+   return answer_is_correct(user_in, it->q);
+#else
+   /* streamed: the flash index is not in memory, but the loaded item holds
+      every variant of this question, usually only a handful */
+   char norm[ANSWER_MAX_LEN];
+   answer_normalize_hash(user_in, it->q, norm, sizeof(norm));
+   const char *v = it->variants;
+   for (uint16_t i = 0; i < it->num_variants; ++i, v = qstore_next_variant(v)) {
+       if (strcmp(v, norm) == 0) return 1;
+   }
+#if ANSWER_FUZZY
+   return fuzzy_any(norm, it->variants, it->num_variants, it->max_dist);
+#else
+   return 0;
+#endif
+#endif
+}
+
+int answer_check(const char *user_in, const qstore_item_t *it)
+{
+   PROBE_BEGIN(PROBE_ANSWER_CHECK);
+   int ok = item_check(user_in, it);
+   PROBE_END(PROBE_ANSWER_CHECK);
+   return ok;
+}
@@ -0,0 +1,28 @@
+#ifndef ANSWER_H
+#define ANSWER_H
+#include <stdint.h>
+#include <stddef.h>
+#include "qstore.h"
+/*
+* answer.h - answer checking against the packed question bank (qbank.h).
+*/
+/* Normalize in (trim, ASCII lowercase, collapse whitespace) into out and
+   return the index hash for question q, all in one pass. out is always
+   NUL-terminated; input beyond size-1 normalized bytes is ignored. */
+uint32_t answer_normalize_hash(const char *in, uint16_t q, char *out, size_t size);
+/* Typo-tolerant matching: 1 = accept answers within qbank_max_dist(q) edits
+   of a variant (see answer.c), 0 = exact (normalized) matches only */
+#ifndef ANSWER_FUZZY
+#define ANSWER_FUZZY 1
+#endif
+/* 1 if user_in is an accepted answer for question q of the bank linked
+   into flash (hashed index lookup) */
+int answer_is_correct(const char *user_in, uint16_t q);
+/* 1 if user_in is an accepted answer for a loaded question; works with
+   every qstore backend */
+int answer_check(const char *user_in, const qstore_item_t *it);
+/* Levenshtein distance between a and b if it is <= k, otherwise k + 1.
+   Bit-parallel, no heap; the shorter string must be at most 32 bytes
+   (returns k + 1 otherwise). */
+unsigned answer_edit_distance(const char *a, size_t la, const char *b, size_t lb, unsigned k);
+#endif /* ANSWER_H */
@@ -0,0 +1,127 @@
+/*
+* audio.c - melody sequencer (see audio.h)
+*
+* All state is shared between thread context (audio_play/audio_cancel) and
+* the 1 ms tick interrupt, so the thread side updates it with interrupts
+* masked. The tick itself is a couple of compares per millisecond.
+*/
+
+#include "audio.h"
+#include "buzzer.h"
+#include "stm32f4xx_hal.h"
+#include <stddef.h>
+
+typedef struct {
+   const audio_melody_t *m;
+   uint8_t prio;
+} audio_slot_t;
+
+/* Currently playing */
+static const audio_melody_t *cur = NULL;
+static uint8_t cur_prio = 0;
+static uint8_t cur_idx = 0;
+static uint8_t in_gap = 0;
+static uint16_t remaining_ms = 0;
+
+/* Waiting melodies, highest priority first (FIFO within one priority) */
+static audio_slot_t queue[AUDIO_QUEUE_LEN];
+static uint8_t queue_len = 0;
+
+static void start_note(void)
+{
+   const audio_note_t *n = &cur->notes[cur_idx];
+   in_gap = 0;
+   remaining_ms = n->dur_ms ? n->dur_ms : 1;
+   tone_start(n->freq);
+}
+
+static void start_melody(const audio_melody_t *m, uint8_t prio)
+{
+   cur = m;
+   cur_prio = prio;
+   cur_idx = 0;
+   if (m == NULL || m->count == 0) {
+       cur = NULL;
+       tone_stop();
+       return;
+   }
+   start_note();
+}
+
+static void start_next_queued(void)
+{
+   if (queue_len == 0) {
+       cur = NULL;
+       tone_stop();
+       return;
+   }
+   audio_slot_t next = queue[0];
+   for (uint8_t i = 1; i < queue_len; ++i) queue[i - 1] = queue[i];
+   queue_len--;
+   start_melody(next.m, next.prio);
+}
+
+static int enqueue(const audio_melody_t *m, uint8_t prio)
+{
+   if (queue_len >= AUDIO_QUEUE_LEN) return -1;
+   uint8_t pos = queue_len;
+   while (pos > 0 && queue[pos - 1].prio < prio) {
+       queue[pos] = queue[pos - 1];
+       pos--;
+   }
+   queue[pos].m = m;
+   queue[pos].prio = prio;
+   queue_len++;
+   return 0;
+}
+
+int audio_play(const audio_melody_t *m, uint8_t prio)
+{
+   int rc = 0;
+   uint32_t primask = __get_PRIMASK();
+   __disable_irq();
+   if (cur == NULL) {
+       start_melody(m, prio);
+   } else if (prio > cur_prio) {
+       /* preempt; the interrupted melody is dropped, not resumed */
+       start_melody(m, prio);
+   } else {
+       rc = enqueue(m, prio);
+   }
+   if (!primask) __enable_irq();
+   return rc;
+}
+
+void audio_cancel(void)
+{
+   uint32_t primask = __get_PRIMASK();
+   __disable_irq();
+   queue_len = 0;
+   cur = NULL;
+   tone_stop();
+   if (!primask) __enable_irq();
+}
+
+int audio_busy(void)
+{
+   return cur != NULL;
+}
+
+void audio_tick_1ms(void)
+{
+   if (cur == NULL) return;
+   if (--remaining_ms) return;
+
+   const audio_note_t *n = &cur->notes[cur_idx];
+   if (!in_gap && n->gap_ms) {
+       tone_stop();
+       in_gap = 1;
+       remaining_ms = n->gap_ms;
+       return;
+   }
+   if (++cur_idx < cur->count) {
+       start_note();
+   } else {
+       start_next_queued();
+   }
+}
@@ -0,0 +1,40 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+#include <stdint.h>
+/*
+* audio.h - non-blocking melody sequencer on top of buzzer.h.
+*
+* A melody is a table of notes (freq, duration, gap after). audio_play()
+* queues it and returns at once; audio_tick_1ms(), called from a 1 ms timer
+* interrupt, walks the table and retunes the PWM. Higher priority melodies
+* preempt lower ones; equal or lower priority ones wait in the queue.
+*/
+typedef struct {
+   uint16_t freq;     /* Hz, 0 = rest */
+   uint16_t dur_ms;   /* tone length */
+   uint16_t gap_ms;   /* silence after the tone */
+} audio_note_t;
+
+typedef struct {
+   const audio_note_t *notes;
+   uint8_t count;
+} audio_melody_t;
+
+enum {
+   AUDIO_PRIO_LOW = 0,
+   AUDIO_PRIO_NORMAL = 1,
+   AUDIO_PRIO_HIGH = 2
+};
+
+#ifndef AUDIO_QUEUE_LEN
+#define AUDIO_QUEUE_LEN 4
+#endif
+
+/* Queue a melody. Returns 0 if playing/queued, -1 if the queue is full. */
+int audio_play(const audio_melody_t *m, uint8_t prio);
+/* Stop the current melody and drop everything queued */
+void audio_cancel(void);
+int audio_busy(void);
+/* Call every millisecond from a timer ISR */
+void audio_tick_1ms(void);
+#endif /* AUDIO_H */
@@ -0,0 +1,74 @@
+/*
+* buzzer.c - timer PWM tone generator (see buzzer.h)
+*
+* The tone is produced entirely by the timer: the CPU only writes PSC/ARR/CCR
+* when a tone starts or changes, so the cost of a tone does not depend on its
+* length, and the pitch is exact to one timer tick instead of depending on a
+* fixed NOP count.
+*/
+
+#include "buzzer.h"
+#include "probe.h"
+
+static TIM_HandleTypeDef *tone_htim = NULL;
+static uint32_t tone_channel = 0;
+static uint8_t tone_compl = 0;
+static uint8_t tone_running = 0;
+
+/* Timer input clock: APB timer clocks run at 2x PCLK when the APB prescaler
+   is not 1. TIM1/TIM8 sit on APB2. */
+static uint32_t tone_timer_clk(void)
+{
+   uint32_t clk = HAL_RCC_GetPCLK2Freq();
+   if (clk != HAL_RCC_GetHCLKFreq()) clk *= 2;
+   return clk;
+}
+
+void buzzer_init(TIM_HandleTypeDef *htim, uint32_t channel, uint8_t complementary)
+{
+   tone_htim = htim;
+   tone_channel = channel;
+   tone_compl = complementary;
+   tone_running = 0;
+}
+
+void tone_start(uint32_t freq)
+{
+   if (tone_htim == NULL) return;
+   if (freq == 0) {
+       tone_stop();
+       return;
+   }
+
+   PROBE_BEGIN(PROBE_TONE_START);
+   if (freq > 50000UL) freq = 50000UL; /* keeps freq * 65536 within 32 bits */
+
+   /* Pick the smallest prescaler that keeps ARR within 16 bits, which gives
+      the finest frequency resolution. */
+   uint32_t clk = tone_timer_clk();
+   uint32_t psc = clk / (freq * 65536UL);
+   uint32_t ticks = (clk / (psc + 1) + freq / 2) / freq;
+   if (ticks < 2) ticks = 2;
+   if (ticks > 65536UL) ticks = 65536UL;
+
+   __HAL_TIM_SET_PRESCALER(tone_htim, psc);
+   __HAL_TIM_SET_AUTORELOAD(tone_htim, ticks - 1);
+   __HAL_TIM_SET_COMPARE(tone_htim, tone_channel, ticks / 2);
+
+   if (!tone_running) {
+       /* load PSC/ARR now instead of at the end of the previous period */
+       tone_htim->Instance->EGR = TIM_EGR_UG;
+       if (tone_compl) HAL_TIMEx_PWMN_Start(tone_htim, tone_channel);
+       else HAL_TIM_PWM_Start(tone_htim, tone_channel);
+       tone_running = 1;
+   }
+   PROBE_END(PROBE_TONE_START);
+}
+
+void tone_stop(void)
+{
+   if (tone_htim == NULL || !tone_running) return;
+   if (tone_compl) HAL_TIMEx_PWMN_Stop(tone_htim, tone_channel);
+   else HAL_TIM_PWM_Stop(tone_htim, tone_channel);
+   tone_running = 0;
+}
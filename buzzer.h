@@ -0,0 +1,18 @@
+#ifndef BUZZER_H
+#define BUZZER_H
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+/*
+* buzzer.h - hardware PWM tone generator for a passive buzzer.
+*
+* Default wiring: buzzer on PB0 = TIM1_CH2N (AF1). TIM3_CH3 is also on PB0,
+* but TIM3 already drives the WS2812B strip on PB1 at a fixed 800 kHz.
+* The timer only needs PWM mode on the channel; buzzer_init() sets the
+* prescaler/period for each tone itself.
+*/
+/* complementary = 1 when the pin is a CHxN output (TIM1/TIM8) */
+void buzzer_init(TIM_HandleTypeDef *htim, uint32_t channel, uint8_t complementary);
+/* Start (or retune) a 50% square wave at freq Hz; 0 stops. Returns at once. */
+void tone_start(uint32_t freq);
+void tone_stop(void);
+#endif /* BUZZER_H */
@@ -0,0 +1,180 @@
+/*
+* buzzin.c - timestamped multi-contestant arbitration (see buzzin.h)
+*
+* Each player has one buzz slot per question. A button ISR fills stamp and
+* then sets state, so the main loop never sees a half-written slot; answer
+* lines are filled from the main loop with the stamp uart_rx took in its
+* ISR. Stamps are compared as signed differences from the open time, which
+* keeps the order right across the 32-bit timer wrap.
+*/
+
+#include "buzzin.h"
+#include <string.h>
+
+typedef enum {
+   BUZZ_NONE = 0,
+   BUZZ_CORRECT,        /* answer line, judged right */
+   BUZZ_WRONG,          /* answer line, judged wrong */
+   BUZZ_PRESSED,        /* button, not judged yet */
+   BUZZ_DONE            /* taken and wrong: player is out */
+} buzz_t;
+
+typedef struct {
+   uint8_t is_button;
+   uint8_t rx_port;
+   uint16_t pin;
+   volatile uint8_t state;      /* buzz_t */
+   volatile uint32_t stamp;
+} player_t;
+
+static TIM_HandleTypeDef *buzz_tim = NULL;
+static player_t players[BUZZIN_MAX_PLAYERS];
+static uint8_t num_players = 0;
+static volatile uint8_t is_open = 0;
+static uint32_t open_us = 0;
+static int8_t floor_player = -1;
+
+void buzzin_init(TIM_HandleTypeDef *htim)
+{
+   buzz_tim = htim;
+   HAL_TIM_Base_Start(htim);
+}
+
+uint32_t buzzin_now_us(void)
+{
+   return buzz_tim ? __HAL_TIM_GET_COUNTER(buzz_tim) : 0;
+}
+
+static int add_player(uint8_t is_button, uint8_t rx_port, uint16_t pin)
+{
+   if (num_players >= BUZZIN_MAX_PLAYERS) return -1;
+   player_t *p = &players[num_players];
+   memset(p, 0, sizeof(*p));
+   p->is_button = is_button;
+   p->rx_port = rx_port;
+   p->pin = pin;
+   return num_players++;
+}
+
+int buzzin_add_uart(uint8_t rx_port)
+{
+   return add_player(0, rx_port, 0);
+}
+
+int buzzin_add_button(uint16_t gpio_pin)
+{
+   return add_player(1, 0, gpio_pin);
+}
+
+uint8_t buzzin_players(void)
+{
+   return num_players;
+}
+
+int buzzin_rx_port(uint8_t player)
+{
+   if (player >= num_players || players[player].is_button) return -1;
+   return players[player].rx_port;
+}
+
+void buzzin_open(void)
+{
+   uint32_t primask = __get_PRIMASK();
+   __disable_irq();
+   for (uint8_t i = 0; i < num_players; ++i) players[i].state = BUZZ_NONE;
+   floor_player = -1;
+   open_us = buzzin_now_us();
+   is_open = 1;
+   if (!primask) __enable_irq();
+}
+
+/* Stamp relative to the open time; negative = before the question */
+static int32_t since_open(uint32_t stamp)
+{
+   return (int32_t)(stamp - open_us);
+}
+
+void buzzin_answer(uint8_t player, uint32_t stamp, int correct)
+{
+   if (!is_open || player >= num_players) return;
+   player_t *p = &players[player];
+   if (p->is_button || p->state != BUZZ_NONE || since_open(stamp) < 0) return;
+   p->stamp = stamp;
+   p->state = correct ? BUZZ_CORRECT : BUZZ_WRONG;
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+   uint32_t now = buzzin_now_us();   /* first thing: this is the stamp */
+   if (!is_open) return;
+   for (uint8_t i = 0; i < num_players; ++i) {
+       player_t *p = &players[i];
+       if (p->is_button && p->pin == GPIO_Pin) {
+           /* first press only: later presses and contact bounce are ignored */
+           if (p->state == BUZZ_NONE) {
+               p->stamp = now;
+               p->state = BUZZ_PRESSED;
+           }
+           return;
+       }
+   }
+}
+
+void buzzin_rule(int correct)
+{
+   if (floor_player < 0) return;
+   players[floor_player].state = correct ? BUZZ_CORRECT : BUZZ_DONE;
+   if (!correct) floor_player = -1;
+}
+
+uint32_t buzzin_stamp(uint8_t player)
+{
+   return player < num_players ? players[player].stamp : 0;
+}
+
+buzzin_state_t buzzin_task(uint8_t *player)
+{
+   if (!is_open) return BUZZIN_WAITING;
+   if (floor_player >= 0) {
+       *player = (uint8_t)floor_player;
+       if (players[floor_player].state != BUZZ_CORRECT) return BUZZIN_FLOOR;
+       is_open = 0;
+       return BUZZIN_WON;
+   }
+
+   int32_t now = since_open(buzzin_now_us());
+   for (;;) {
+       /* earliest buzz not taken yet */
+       int8_t first = -1;
+       uint8_t out = 0;
+       for (uint8_t i = 0; i < num_players; ++i) {
+           uint8_t st = players[i].state;
+           if (st == BUZZ_DONE) { out++; continue; }
+           if (st == BUZZ_NONE) continue;
+           if (first < 0 || since_open(players[i].stamp) < since_open(players[first].stamp)) {
+               first = (int8_t)i;
+           }
+       }
+       if (num_players && out == num_players) {
+           is_open = 0;
+           return BUZZIN_ALL_OUT;
+       }
+       if (first < 0 || now - since_open(players[first].stamp) < BUZZIN_WINDOW_US) {
+           return BUZZIN_WAITING;
+       }
+
+       player_t *p = &players[first];
+       *player = (uint8_t)first;
+       switch (p->state) {
+       case BUZZ_CORRECT:
+           is_open = 0;
+           return BUZZIN_WON;
+       case BUZZ_PRESSED:
+           floor_player = first;
+           return BUZZIN_FLOOR;
+       default:            /* wrong: out, take the next buzz */
+           p->state = BUZZ_DONE;
+           break;
+       }
+   }
+}
@@ -0,0 +1,61 @@
+#ifndef BUZZIN_H
+#define BUZZIN_H
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+/*
+* buzzin.h - several contestants, fastest correct answer wins.
+*
+* Contestants answer on their own UART terminal (a line per answer, read
+* through uart_rx) or press a buzzer button on an EXTI pin. Every input is
+* stamped in its ISR from a free-running 1 MHz timer, so who was first is
+* decided by the stamps and never by the order the main loop happens to
+* read the inputs in.
+*
+* Per question each player gets one buzz: their first answer line or first
+* button press after buzzin_open(). Buzzes are then taken in stamp order:
+*   - an answer line is judged at once; correct wins, wrong locks the player
+*     out and the next buzz is taken
+*   - a button press gives the player the floor; the quizmaster judges what
+*     they say with buzzin_rule()
+* A buzz is only taken once BUZZIN_WINDOW_US have passed since its stamp, so
+* an earlier buzz whose ISR or line read is still pending cannot be
+* overtaken.
+*
+* CubeMX: TIM2 (32-bit) free running at 1 MHz, no interrupts; buttons as
+* GPIO_EXTI falling edge with pull-up and their EXTI IRQs enabled.
+*/
+#ifndef BUZZIN_MAX_PLAYERS
+#define BUZZIN_MAX_PLAYERS 4
+#endif
+#ifndef BUZZIN_WINDOW_US
+#define BUZZIN_WINDOW_US 2000
+#endif
+
+typedef enum {
+   BUZZIN_WAITING,      /* nobody has won yet */
+   BUZZIN_FLOOR,        /* *player pressed first and must answer aloud */
+   BUZZIN_WON,          /* *player answered correctly first */
+   BUZZIN_ALL_OUT       /* every player answered wrong */
+} buzzin_state_t;
+
+/* htim: TIM2 set up for 1 MHz; started here */
+void buzzin_init(TIM_HandleTypeDef *htim);
+/* Microseconds from the free-running timer (wraps after ~71 minutes) */
+uint32_t buzzin_now_us(void);
+/* Add a contestant; returns the player number, or -1 if full */
+int buzzin_add_uart(uint8_t rx_port);
+int buzzin_add_button(uint16_t gpio_pin);
+uint8_t buzzin_players(void);
+/* rx port of a UART player, or -1 for a button */
+int buzzin_rx_port(uint8_t player);
+/* Question is on screen: forget the last question's buzzes, start taking new ones */
+void buzzin_open(void);
+/* A UART player's answer line, stamped by uart_rx, and whether it is right */
+void buzzin_answer(uint8_t player, uint32_t stamp, int correct);
+/* Quizmaster verdict for the player holding the floor */
+void buzzin_rule(int correct);
+/* Stamp of a player's buzz this question (answer line or button press) */
+uint32_t buzzin_stamp(uint8_t player);
+/* Arbitration step (scheduler); *player is set for FLOOR and WON */
+buzzin_state_t buzzin_task(uint8_t *player);
+#endif /* BUZZIN_H */
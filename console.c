@@ -0,0 +1,112 @@
+/*
+* console.c - '!' commands and DMA-buffered UART output (see console.h)
+*/
+
+#include "console.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+   const char *name;
+   console_cmd_fn_t fn;
+} console_cmd_t;
+
+static UART_HandleTypeDef *con_huart = NULL;
+static console_cmd_t cmds[CONSOLE_MAX_CMDS];
+static uint8_t cmd_count = 0;
+
+/* TX ring: thread appends at tx_head, DMA sends [tx_tail, tx_tail+tx_inflight) */
+static uint8_t tx_ring[CONSOLE_TX_SIZE];
+static volatile uint16_t tx_head = 0;
+static volatile uint16_t tx_tail = 0;
+static volatile uint16_t tx_inflight = 0;
+
+void console_init(UART_HandleTypeDef *huart)
+{
+   con_huart = huart;
+}
+
+int console_register(const char *name, console_cmd_fn_t fn)
+{
+   if (cmd_count >= CONSOLE_MAX_CMDS) return -1;
+   cmds[cmd_count].name = name;
+   cmds[cmd_count].fn = fn;
+   cmd_count++;
+   return 0;
+}
+
+int console_handle_line(const char *line)
+{
+   if (line[0] != '!') return 0;
+   const char *name = line + 1;
+   size_t n = strcspn(name, " ");
+   const char *args = name + n;
+   while (*args == ' ') args++;
+
+   for (uint8_t i = 0; i < cmd_count; ++i) {
+       if (strlen(cmds[i].name) == n && strncmp(cmds[i].name, name, n) == 0) {
+           cmds[i].fn(args);
+           return 1;
+       }
+   }
+   console_printf("unknown command\r\n");
+   return 1;
+}
+
+/* Start DMA on the next contiguous chunk. ISR or IRQs masked. */
+static void tx_kick(void)
+{
+   if (tx_inflight || tx_head == tx_tail || con_huart == NULL) return;
+   uint16_t len = (tx_head > tx_tail) ? (uint16_t)(tx_head - tx_tail)
+                                      : (uint16_t)(CONSOLE_TX_SIZE - tx_tail);
+   tx_inflight = len;
+   if (HAL_UART_Transmit_DMA(con_huart, &tx_ring[tx_tail], len) != HAL_OK) {
+       tx_inflight = 0;
+   }
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+   if (huart != con_huart) return;
+   tx_tail = (uint16_t)((tx_tail + tx_inflight) % CONSOLE_TX_SIZE);
+   tx_inflight = 0;
+   tx_kick();
+}
+
+void console_write(const char *data, uint16_t len)
+{
+   while (len--) {
+       uint16_t next = (uint16_t)((tx_head + 1) % CONSOLE_TX_SIZE);
+       while (next == tx_tail) {
+           /* ring full: make sure it is draining, then wait */
+           uint32_t primask = __get_PRIMASK();
+           __disable_irq();
+           tx_kick();
+           if (!primask) __enable_irq();
+       }
+       tx_ring[tx_head] = (uint8_t)*data++;
+       tx_head = next;
+   }
+   uint32_t primask = __get_PRIMASK();
+   __disable_irq();
+   tx_kick();
+   if (!primask) __enable_irq();
+}
+
+uint16_t console_tx_free(void)
+{
+   return (uint16_t)((tx_tail + CONSOLE_TX_SIZE - tx_head - 1) % CONSOLE_TX_SIZE);
+}
+
+void console_printf(const char *fmt, ...)
+{
+   char buf[96];
+   va_list ap;
+   va_start(ap, fmt);
+   int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+   va_end(ap);
+   if (n < 0) return;
+   if (n >= (int)sizeof(buf)) n = sizeof(buf) - 1;
+   console_write(buf, (uint16_t)n);
+}
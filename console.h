@@ -0,0 +1,33 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+/*
+* console.h - hidden operator commands and buffered DMA output on the quiz UART.
+*
+* Any received line starting with '!' is a command ("!name args"), never an
+* answer. Handlers print with console_printf(), which queues into a TX ring
+* drained by HAL_UART_Transmit_DMA. If the ring is full the caller waits,
+* so keep command output short or emit it in chunks.
+*
+* CubeMX: USART1_TX on DMA2 Stream7 Channel4 (normal mode).
+*/
+#ifndef CONSOLE_TX_SIZE
+#define CONSOLE_TX_SIZE 512
+#endif
+#ifndef CONSOLE_MAX_CMDS
+#define CONSOLE_MAX_CMDS 8
+#endif
+
+typedef void (*console_cmd_fn_t)(const char *args);
+
+void console_init(UART_HandleTypeDef *huart);
+/* Register a command by name (without the '!'). Returns 0, or -1 if full. */
+int console_register(const char *name, console_cmd_fn_t fn);
+/* Returns 1 if line was a command (and has been handled), 0 otherwise */
+int console_handle_line(const char *line);
+void console_write(const char *data, uint16_t len);
+void console_printf(const char *fmt, ...);
+/* Bytes console_write() can take right now without waiting for the UART */
+uint16_t console_tx_free(void);
+#endif /* CONSOLE_H */
@@ -0,0 +1,31 @@
+/*
+* delay.c - DWT cycle-counter based microsecond delays (see delay.h)
+*/
+
+#include "delay.h"
+
+static uint32_t cycles_per_us = 0;
+
+void delay_init(void)
+{
+   /* Trace must be enabled for the DWT unit to run */
+   CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+   DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+   cycles_per_us = SystemCoreClock / 1000000UL;
+   if (cycles_per_us == 0) cycles_per_us = 1;
+}
+
+uint32_t delay_us_to_cycles(uint32_t us)
+{
+   if (cycles_per_us == 0) delay_init();
+   return us * cycles_per_us;
+}
+
+void delay_us(uint32_t us)
+{
+   uint32_t start = DWT->CYCCNT;
+   uint32_t wait = delay_us_to_cycles(us);
+   /* unsigned subtraction handles CYCCNT wrap-around */
+   while ((DWT->CYCCNT - start) < wait) { }
+}
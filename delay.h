@@ -0,0 +1,20 @@
+#ifndef DELAY_H
+#define DELAY_H
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+/*
+* delay.h - microsecond busy-wait on the Cortex-M4 DWT cycle counter.
+*
+* HAL_Delay() has 1 ms granularity (and really waits 1..2 ms), which is far
+* too coarse for HD44780/PCF8574 timing. DWT->CYCCNT counts core clocks, so
+* the resolution is 1/SystemCoreClock and the wait is independent of -O level.
+*/
+/* Enable the cycle counter and cache cycles-per-us. Safe to call more than
+   once; call again if SystemCoreClock changes. */
+void delay_init(void);
+/* Busy-wait at least us microseconds */
+void delay_us(uint32_t us);
+/* Raw cycle counter and conversion helpers */
+static inline uint32_t delay_cycles_now(void) { return DWT->CYCCNT; }
+uint32_t delay_us_to_cycles(uint32_t us);
+#endif /* DELAY_H */
@@ -0,0 +1,341 @@
+/*
+* flog.c - append-only flash record log (see flog.h)
+*
+* Sector layout: slot 0 is the HEADER record, then records in the order
+* they were logged, then erased slots. A sector taken into use is written
+* back to front as far as the header goes: erase, TOTAL records, header
+* last, so a reset in the middle of a switch leaves a sector without a
+* header, which start-up ignores (the old sector is still intact).
+*/
+
+#include "flog.h"
+#include <string.h>
+
+/* Where a flash address can be read; the host build maps it onto its mock */
+#ifndef FLOG_PTR
+#define FLOG_PTR(addr) ((const uint8_t *)(uintptr_t)(addr))
+#endif
+
+#define FLOG_VERSION 1
+#define REC_SIZE     ((uint32_t)sizeof(flog_rec_t))
+#define SLOTS        (FLOG_SECTOR_SIZE / REC_SIZE)
+
+static const uint32_t sec_addr[2] = { FLOG_ADDR_A, FLOG_ADDR_B };
+static const uint32_t sec_num[2] = { FLOG_SECTOR_A, FLOG_SECTOR_B };
+
+static uint8_t active = 0;
+static uint32_t seq = 0;
+static uint32_t tail = 0;          /* first free slot of the active sector */
+static uint32_t round_no = 0;
+static uint32_t errors = 0;
+static flog_rec_t page[FLOG_PAGE_RECS];
+static uint8_t page_len = 0;
+static flog_total_t totals[FLOG_MAX_Q];
+
+static uint16_t crc16(const uint8_t *p, uint32_t n)
+{
+   uint16_t crc = 0xFFFF;
+   while (n--) {
+       crc ^= (uint16_t)(*p++ << 8);
+       for (int b = 0; b < 8; ++b) {
+           crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+       }
+   }
+   return crc;
+}
+
+static void rec_seal(flog_rec_t *r)
+{
+   r->crc = crc16((const uint8_t *)r, REC_SIZE - 2);
+}
+
+static int rec_valid(const flog_rec_t *r)
+{
+   return r->type != 0xFFFF && r->crc == crc16((const uint8_t *)r, REC_SIZE - 2);
+}
+
+static void slot_read(uint8_t s, uint32_t slot, flog_rec_t *r)
+{
+   memcpy(r, FLOG_PTR(sec_addr[s] + slot * REC_SIZE), REC_SIZE);
+}
+
+/* Programmed at all? Records are written first word first, so a slot a
+   reset cut short still counts as used. */
+static int slot_used(uint8_t s, uint32_t slot)
+{
+   uint32_t w;
+   memcpy(&w, FLOG_PTR(sec_addr[s] + slot * REC_SIZE), sizeof(w));
+   return w != 0xFFFFFFFFUL;
+}
+
+/* n records at addr, one word at a time, in one unlock. If a word fails,
+   it and the rest of the burst are programmed to 0 instead: the caller
+   moves the tail past all n slots, and flog_init()'s bisection needs
+   every slot below the tail to read as used (all-zero slots fail
+   rec_valid()). */
+static int program(uint32_t addr, const flog_rec_t *r, uint32_t n)
+{
+   const uint32_t *w = (const uint32_t *)r;
+   int rc = 0;
+   HAL_FLASH_Unlock();
+   for (uint32_t i = 0; i < n * REC_SIZE / 4; ++i) {
+       uint32_t v = rc ? 0 : w[i];
+       if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr + i * 4, v) != HAL_OK && !rc) {
+           rc = -1;
+           (void)HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr + i * 4, 0);
+       }
+   }
+   HAL_FLASH_Lock();
+   if (rc) errors++;
+   return rc;
+}
+
+static int erase(uint8_t s)
+{
+   FLASH_EraseInitTypeDef e;
+   uint32_t bad = 0;
+   memset(&e, 0, sizeof(e));
+   e.TypeErase = FLASH_TYPEERASE_SECTORS;
+   e.Sector = sec_num[s];
+   e.NbSectors = 1;
+   e.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+   HAL_FLASH_Unlock();
+   HAL_StatusTypeDef st = HAL_FLASHEx_Erase(&e, &bad);
+   HAL_FLASH_Lock();
+   if (st != HAL_OK) {
+       errors++;
+       return -1;
+   }
+   return 0;
+}
+
+/* 1 if sector s carries a valid header (copied to *h) */
+static int header(uint8_t s, flog_rec_t *h)
+{
+   slot_read(s, 0, h);
+   return rec_valid(h) && h->type == FLOG_T_HEADER && h->q == FLOG_VERSION;
+}
+
+static uint16_t sat16(uint32_t v)
+{
+   return v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+}
+
+/* Take sector s into use as sequence number new_seq: erase, carry totals[]
+   over, header last */
+static int sector_open(uint8_t s, uint32_t new_seq)
+{
+   uint32_t slot = 1;
+   if (erase(s) != 0) return -1;
+   for (uint16_t q = 0; q < FLOG_MAX_Q; ++q) {
+       const flog_total_t *t = &totals[q];
+       if (!t->asked) continue;
+       flog_rec_t r;
+       r.type = FLOG_T_TOTAL;
+       r.q = q;
+       r.a = sat16(t->asked) | ((uint32_t)sat16(t->correct) << 16);
+       r.b = t->ms_sum;
+       r.c = sat16(t->timed);
+       rec_seal(&r);
+       if (program(sec_addr[s] + slot * REC_SIZE, &r, 1) != 0) return -1;
+       slot++;
+   }
+   flog_rec_t h;
+   h.type = FLOG_T_HEADER;
+   h.q = FLOG_VERSION;
+   h.a = new_seq;
+   h.b = round_no;
+   h.c = 0;
+   rec_seal(&h);
+   if (program(sec_addr[s], &h, 1) != 0) return -1;
+
+   active = s;
+   seq = new_seq;
+   tail = slot;
+   return 0;
+}
+
+/* Fold slots [1, end) of sector s into totals[] */
+static void totals_add(uint8_t s, uint32_t end)
+{
+   flog_rec_t r;
+   for (uint32_t i = 1; i < end; ++i) {
+       slot_read(s, i, &r);
+       if (!rec_valid(&r) || r.q >= FLOG_MAX_Q) continue;
+       flog_total_t *t = &totals[r.q];
+       if (r.type == FLOG_T_TOTAL) {
+           t->asked += r.a & 0xFFFF;
+           t->correct += r.a >> 16;
+           t->timed += r.c;
+           t->ms_sum += r.b;
+       } else if (r.type == FLOG_T_ANSWER) {
+           t->asked++;
+           t->correct += r.c & 1;
+           if (r.b != FLOG_NO_TIME) {
+               t->timed++;
+               t->ms_sum = (t->ms_sum + r.b < t->ms_sum) ? 0xFFFFFFFFUL : t->ms_sum + r.b;
+           }
+       }
+   }
+}
+
+static int sector_switch(void)
+{
+   flog_totals_build();
+   return sector_open((uint8_t)(active ^ 1), seq + 1);
+}
+
+int flog_init(void)
+{
+   flog_rec_t h[2];
+   int ok0 = header(0, &h[0]);
+   int ok1 = header(1, &h[1]);
+
+   page_len = 0;
+   if (!ok0 && !ok1) {
+       /* blank (or foreign) flash: start over in sector A */
+       memset(totals, 0, sizeof(totals));
+       round_no = 0;
+       return sector_open(0, 1);
+   }
+   active = (ok0 && ok1) ? ((int32_t)(h[1].a - h[0].a) > 0) : (uint8_t)ok1;
+   seq = h[active].a;
+   round_no = h[active].b;
+
+   /* slots [1, lo) are used, [hi, SLOTS) erased */
+   uint32_t lo = 1, hi = SLOTS;
+   while (lo < hi) {
+       uint32_t mid = lo + (hi - lo) / 2;
+       if (slot_used(active, mid)) lo = mid + 1;
+       else hi = mid;
+   }
+   tail = lo;
+
+   /* the round logged last (finished or cut short) is over: next number.
+      Only the newest records are looked at, back to the carried totals. */
+   for (uint32_t i = tail; i > 1 && tail - i < 2u * FLOG_PAGE_RECS; --i) {
+       flog_rec_t r;
+       slot_read(active, i - 1, &r);
+       if (!rec_valid(&r)) continue;
+       if (r.type == FLOG_T_TOTAL) break;
+       if (r.type == FLOG_T_ANSWER || r.type == FLOG_T_ROUND) {
+           round_no = r.a + 1;
+           break;
+       }
+   }
+   return 0;
+}
+
+static void append(flog_rec_t *r)
+{
+   rec_seal(r);
+   page[page_len++] = *r;
+   if (page_len >= FLOG_PAGE_RECS) flog_flush();
+}
+
+void flog_answer(uint16_t q, uint8_t player, uint8_t correct, uint32_t ms)
+{
+   flog_rec_t r;
+   r.type = FLOG_T_ANSWER;
+   r.q = q;
+   r.a = round_no;
+   r.b = ms;
+   r.c = (uint16_t)((correct ? 1u : 0u) | ((uint16_t)player << 8));
+   append(&r);
+}
+
+void flog_round_end(const int *scores, uint8_t players, uint16_t questions)
+{
+   for (uint8_t p = 0; p < players; ++p) {
+       flog_rec_t r;
+       r.type = FLOG_T_ROUND;
+       r.q = p;
+       r.a = round_no;
+       r.b = (uint32_t)scores[p];
+       r.c = questions;
+       append(&r);
+   }
+   flog_flush();
+   round_no++;
+   /* switch now rather than in the middle of the next round */
+   if (SLOTS - tail < FLOG_SWITCH_MARGIN) sector_switch();
+}
+
+int flog_flush(void)
+{
+   if (page_len == 0) return 0;
+   int rc = 0;
+   if (tail + page_len > SLOTS) rc = sector_switch();
+   if (rc == 0) {
+       rc = program(sec_addr[active] + tail * REC_SIZE, page, page_len);
+       tail += page_len;   /* a failed burst is zero-filled, see program() */
+   }
+   page_len = 0;
+   return rc;
+}
+
+uint32_t flog_round_no(void)
+{
+   return round_no;
+}
+
+uint32_t flog_records(void)
+{
+   return tail ? tail - 1 : 0;
+}
+
+uint32_t flog_capacity(void)
+{
+   return SLOTS - 1;
+}
+
+uint32_t flog_seq(void)
+{
+   return seq;
+}
+
+uint32_t flog_errors(void)
+{
+   return errors;
+}
+
+/* The older sector is only read if it is the one right before the active
+   one (its records are summed up in the active sector's TOTALs) */
+void flog_read_start(flog_cursor_t *c)
+{
+   flog_rec_t h;
+   uint8_t old = (uint8_t)(active ^ 1);
+   c->sector = (header(old, &h) && h.a == seq - 1) ? 0 : 1;
+   c->off = 1;
+}
+
+int flog_read(flog_cursor_t *c, flog_rec_t *out)
+{
+   while (c->sector < 2) {
+       uint8_t s = (c->sector == 0) ? (uint8_t)(active ^ 1) : active;
+       uint32_t end = (c->sector == 0) ? SLOTS : tail;
+       if (c->off >= end || (c->sector == 0 && !slot_used(s, c->off))) {
+           c->sector++;
+           c->off = 1;
+           continue;
+       }
+       slot_read(s, c->off++, out);
+       if (rec_valid(out)) return 1;
+   }
+   return 0;
+}
+
+void flog_totals_build(void)
+{
+   memset(totals, 0, sizeof(totals));
+   totals_add(active, tail);
+}
+
+void flog_total(uint16_t q, flog_total_t *out)
+{
+   if (q >= FLOG_MAX_Q) {
+       memset(out, 0, sizeof(*out));
+       return;
+   }
+   *out = totals[q];
+}
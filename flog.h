@@ -0,0 +1,104 @@
+#ifndef FLOG_H
+#define FLOG_H
+#include "main.h"
+#include <stdint.h>
+/*
+* flog.h - append-only record log in a reserved pair of internal flash
+* sectors, for per-question accuracy and response times across rounds.
+*
+* Records are 16 bytes and are appended to the active sector. They are
+* collected in a RAM page and programmed as one burst when the page fills
+* and at the end of every round. When the active sector is nearly full, the
+* other one is erased and becomes active. It starts with a TOTAL record per
+* question that carries the counts forward, so history survives every
+* switch and each sector is erased once per pass (wear levelling).
+*
+* Start-up does not walk the log: it reads both sector headers, then finds
+* the first free slot by bisection on "slot still erased" (the log only
+* ever grows), about 15 reads for 8191 slots. A reset loses what is still
+* in the RAM page; a record it cuts off fails its CRC and is skipped.
+*
+* Erasing a 128 KB sector stalls code fetch from flash for one or two
+* seconds. That only happens at a round end, once every few hundred rounds.
+*
+* The default sectors are F407/F429 sectors 10 and 11 (the last 256 KB of
+* 1 MB). Keep them out of the linker script's FLASH region.
+*/
+#ifndef FLOG_SECTOR_A
+#define FLOG_SECTOR_A    FLASH_SECTOR_10
+#define FLOG_ADDR_A      0x080C0000UL
+#define FLOG_SECTOR_B    FLASH_SECTOR_11
+#define FLOG_ADDR_B      0x080E0000UL
+#define FLOG_SECTOR_SIZE 0x20000UL
+#endif
+/* Records per RAM page (one programming burst) */
+#ifndef FLOG_PAGE_RECS
+#define FLOG_PAGE_RECS 16
+#endif
+/* Questions whose totals are carried into the next sector */
+#ifndef FLOG_MAX_Q
+#define FLOG_MAX_Q 128
+#endif
+/* A round end switches sectors early when less than this many records are
+   left, so the erase does not land in the middle of a round */
+#ifndef FLOG_SWITCH_MARGIN
+#define FLOG_SWITCH_MARGIN 256
+#endif
+
+#define FLOG_T_ANSWER 0x0A41   /* q, a = round, b = ms, c = correct | player << 8 */
+#define FLOG_T_ROUND  0x0A52   /* q = player, a = round, b = score, c = questions */
+#define FLOG_T_TOTAL  0x0A54   /* q, a = asked | correct << 16, b = ms sum, c = timed */
+#define FLOG_T_HEADER 0x4C47   /* q = version, a = sector sequence, b = next round */
+
+#define FLOG_NO_PLAYER 0xFF    /* nobody got it (buzz-in) */
+#define FLOG_NO_TIME   0xFFFFFFFFUL
+
+typedef struct {
+   uint16_t type;
+   uint16_t q;
+   uint32_t a;
+   uint32_t b;
+   uint16_t c;
+   uint16_t crc;          /* CRC-16/CCITT of the first 14 bytes */
+} flog_rec_t;
+
+/* Per-question history, from the TOTAL records plus everything logged since */
+typedef struct {
+   uint32_t asked;
+   uint32_t correct;
+   uint32_t timed;        /* answers with a response time */
+   uint32_t ms_sum;
+} flog_total_t;
+
+/* Reading position for flog_read() (oldest record first) */
+typedef struct {
+   uint8_t sector;        /* 0 = the older sector, 1 = the active one, 2 = done */
+   uint32_t off;
+} flog_cursor_t;
+
+/* Find the active sector and its tail; formats sector A on a blank chip.
+   Returns 0, or -1 if flash could not be erased/programmed. */
+int flog_init(void);
+/* One answered (or abandoned) question: ms = FLOG_NO_TIME if not timed */
+void flog_answer(uint16_t q, uint8_t player, uint8_t correct, uint32_t ms);
+/* End of a round: one ROUND record per player, then everything is
+   programmed and the next round begins. May switch sectors. */
+void flog_round_end(const int *scores, uint8_t players, uint16_t questions);
+/* Program the RAM page now. Returns 0, or -1 on a flash error. */
+int flog_flush(void);
+
+uint32_t flog_round_no(void);      /* rounds logged so far */
+uint32_t flog_records(void);       /* records in the active sector */
+uint32_t flog_capacity(void);      /* record slots per sector */
+uint32_t flog_seq(void);           /* active sector's sequence number */
+uint32_t flog_errors(void);
+
+/* Walk every valid record, older sector first. flog_read() returns 1 with
+   *out filled, or 0 at the end. Unflushed records are not seen. */
+void flog_read_start(flog_cursor_t *c);
+int flog_read(flog_cursor_t *c, flog_rec_t *out);
+/* History of question q (zero if q >= FLOG_MAX_Q). flog_totals_build()
+   walks the active sector once; flog_total() then reads its table. */
+void flog_totals_build(void);
+void flog_total(uint16_t q, flog_total_t *out);
+#endif /* FLOG_H */
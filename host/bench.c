@@ -0,0 +1,973 @@
+/*
+* host/bench.c - driver benchmarks on the recording HAL mock.
+*
+*   bench [-l limits.txt] [bank.bin ...]
+*
+* Prints one "metric value unit" line per measurement:
+*   lcd_*     bytes / transactions per screen update and the simulated
+*             time until it is on the glass (bus time at Init.ClockSpeed
+*             plus any blocking waits), checked against an HD44780 model
+*             fed from the recorded I2C stream. lcd_first_screen_ms is
+*             reset to the first full screen on the glass. lcd_bus_*, lcd_fallback_*
+*             and lcd_recover_* cover the speed probe, the fallback of a
+*             display that only works at 100 kHz and recovery from a burst
+*             of failed transfers. lcd_start_bus_ops and lcd_boot_scl_pulses
+*             check that claiming a handle leaves the bus alone and that a
+*             healthy bus comes up without the recovery clocks;
+*             lcd_busy_flush_us is the time lcd_flush() spends when the
+*             queue is still busy with earlier flushes
+*   led_*     WS2812B edge timing of the selected backend against its
+*             targets, and bits that decode wrongly or fall outside the
+*             datasheet windows
+*   flog_*    flash log programming bursts and words per round, flash
+*             reads to recover after a reset, rounds per sector erase, and
+*             totals that disagree with a reference model after sector
+*             switches, after a write torn by a power cut and after a
+*             program error in the middle of a burst
+*   proto_*   binary frames through uart_rx at 921600 baud, mixed with
+*             typed lines: frames and lines lost or damaged, corrupted
+*             frames let through, replies that do not decode, recovery
+*             from a stalled frame, and the scripted answers per minute
+*             the wire carries in PROTO_T_CHECK batches
+*   ledfx_*   LED effects: HSV conversion error against a float model,
+*             frames per second on the strip, frames that reach the wire
+*             different from the buffer handed over while the next one is
+*             rendered, and host CPU time per ledfx_task()
+*   answer_*  answer_is_correct() throughput (host CPU time, so it only
+*             compares runs on one machine) and wrong verdicts, for each
+*             bank blob (qbank_pack.py --bin) given on the command line
+*
+* With -l, every metric named in the limits file ("metric <= value" or
+* "metric >= value" per line, # comments) is checked and the exit status
+* is 1 if any limit is broken.
+*/
+
+#define _POSIX_C_SOURCE 199309L   /* clock_gettime() under -std=c99 */
+#include "stm32f4xx_hal.h"
+#include "i2c.h"
+#include "ws2812b.h"
+#include "answer.h"
+#include "qbank.h"
+#include "flog.h"
+#include "uart_rx.h"
+#include "proto.h"
+#include "ledfx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if WS2812B_BACKEND == WS2812B_BACKEND_SPI
+#error "host bench: the mock has no SPI DMA; build with the bit-bang or timer backend"
+#endif
+
+#ifndef LCD_ASYNC
+#define LCD_ASYNC 1   /* i2c.c default; the Makefile passes it to both */
+#endif
+
+extern const uint8_t qbank_blob[];
+
+/* ---------- Metrics and limits ---------- */
+#define MAX_LIMITS 64
+typedef struct {
+   char name[48];
+   char op;          /* '<' for <=, '>' for >= */
+   double value;
+} limit_t;
+
+static limit_t limits[MAX_LIMITS];
+static int num_limits = 0;
+static int broken = 0;
+
+static void load_limits(const char *path)
+{
+   FILE *f = fopen(path, "r");
+   if (!f) {
+       fprintf(stderr, "bench: cannot open %s\n", path);
+       exit(2);
+   }
+   char line[128];
+   while (fgets(line, sizeof(line), f) && num_limits < MAX_LIMITS) {
+       limit_t *l = &limits[num_limits];
+       char op[3];
+       if (line[0] == '#') continue;
+       if (sscanf(line, "%47s %2s %lf", l->name, op, &l->value) != 3) continue;
+       if (strcmp(op, "<=") == 0) l->op = '<';
+       else if (strcmp(op, ">=") == 0) l->op = '>';
+       else continue;
+       num_limits++;
+   }
+   fclose(f);
+}
+
+static void metric(const char *name, double value, const char *unit)
+{
+   const char *verdict = "";
+   for (int i = 0; i < num_limits; ++i) {
+       const limit_t *l = &limits[i];
+       if (strcmp(l->name, name) != 0) continue;
+       int ok = (l->op == '<') ? value <= l->value : value >= l->value;
+       verdict = ok ? "  ok" : "  FAIL";
+       if (!ok) broken++;
+   }
+   printf("%-32s %12.2f %-8s%s\n", name, value, unit, verdict);
+}
+
+static double cycles_to_us(uint64_t cycles)
+{
+   return (double)cycles * 1e6 / SystemCoreClock;
+}
+
+/* ---------- HD44780 model on the I2C tap ---------- */
+typedef struct {
+   uint8_t addr;
+   uint8_t four_bit;     /* seen the 0x02 nibble that selects 4-bit mode */
+   uint8_t have_high;    /* first nibble of a byte latched */
+   uint8_t high;
+   uint8_t prev;         /* last expander byte, for the EN falling edge */
+   uint8_t cgram;        /* data goes to CGRAM (after a 0x40 command) */
+   uint8_t ac;
+   char ddram[128];
+} hd44780_t;
+
+static hd44780_t panels[2];
+
+static void hd_exec(hd44780_t *p, uint8_t rs, uint8_t v)
+{
+   if (rs) {
+       if (!p->cgram) p->ddram[p->ac & 0x7F] = (char)v;
+       p->ac++;
+   } else if (v & 0x80) {
+       p->ac = v & 0x7F;
+       p->cgram = 0;
+   } else if (v & 0x40) {
+       p->cgram = 1;
+   } else if (v == 0x01) {
+       memset(p->ddram, ' ', sizeof(p->ddram));
+       p->ac = 0;
+       p->cgram = 0;
+   } else if (v == 0x02 || v == 0x03) {
+       p->ac = 0;
+   }
+}
+
+static void hd_tap(uint8_t addr7, const uint8_t *data, uint16_t len)
+{
+   hd44780_t *p = NULL;
+   for (int i = 0; i < 2; ++i) {
+       if (panels[i].addr == addr7) p = &panels[i];
+   }
+   if (!p) return;
+   for (uint16_t i = 0; i < len; ++i) {
+       uint8_t b = data[i];
+       if ((p->prev & P_CF_EN) && !(b & P_CF_EN)) {   /* latches on EN falling */
+           uint8_t nib = (uint8_t)(p->prev >> 4);
+           uint8_t rs = p->prev & P_CF_RS;
+           if (!p->four_bit) {
+               if (nib == 0x02) p->four_bit = 1;
+           } else if (!p->have_high) {
+               p->high = nib;
+               p->have_high = 1;
+           } else {
+               p->have_high = 0;
+               hd_exec(p, rs, (uint8_t)(p->high << 4 | nib));
+           }
+       }
+       p->prev = b;
+   }
+}
+
+/* 1 if the panel shows rows[] (16x2 DDRAM layout) */
+static int hd_shows(const hd44780_t *p, const char *row0, const char *row1)
+{
+   return memcmp(p->ddram, row0, LCD_COLS) == 0 && memcmp(p->ddram + 0x40, row1, LCD_COLS) == 0;
+}
+
+/* ---------- LCD ---------- */
+#define BOOT_SETUP_MS 20   /* rest of main()'s set-up, overlapped with the LCD power-up */
+static I2C_HandleTypeDef hi2c1, hi2c2;
+static uint32_t lcd_wrong = 0;
+
+/* Flush what the framebuffer holds and report what it cost */
+static void lcd_measure(lcd_t *d, const char *name, const char *row0, const char *row1)
+{
+   char key[48];
+   mock_i2c_stats_t st;
+   mock_i2c_reset_stats();
+   uint64_t t0 = mock_cycles();
+   lcd_flush(d);
+   mock_run_until_idle();
+   uint64_t t1 = mock_cycles();
+   mock_i2c_stats(&st);
+   if (!hd_shows(&panels[0], row0, row1)) {
+       lcd_wrong++;
+       printf("  %s: panel shows |%.16s|%.16s|\n", name, panels[0].ddram, panels[0].ddram + 0x40);
+   }
+
+   snprintf(key, sizeof(key), "lcd_%s_bytes", name);
+   metric(key, st.bytes, "bytes");
+   snprintf(key, sizeof(key), "lcd_%s_xfers", name);
+   metric(key, st.xfers, "xfers");
+   snprintf(key, sizeof(key), "lcd_%s_us", name);
+   metric(key, cycles_to_us(t1 - t0), "us");
+}
+
+static void lcd_draw(lcd_t *d, const char *row0, const char *row1)
+{
+   lcd_fb_write_row(d, 0, row0);
+   lcd_fb_write_row(d, 1, row1);
+}
+
+/* SCL pulses the recovery clocked out by hand since the edge log was cleared */
+static uint32_t scl_pulses(void)
+{
+   uint32_t n, pulses = 0;
+   const mock_edge_t *e = mock_edges(&n);
+   for (uint32_t i = 0; i < n; ++i) {
+       if (e[i].port == 1 && e[i].pin == GPIO_PIN_8 && e[i].level == 0) pulses++;
+   }
+   return pulses;
+}
+
+/* Speed fallback and error recovery. A second display on its own bus only
+   works at 100 kHz, so lcd_init() must settle there; then the first
+   display's bus drops a burst of transfers, and the next flush must
+   recover it one step slower and still end up showing the right screen. */
+static void bench_lcd_bus(lcd_t *d)
+{
+   static const char r0[] = "Second display  ", r1[] = "at 100 kHz      ";
+   static const char c0[] = "After a bus     ", c1[] = "recovery        ";
+
+   hi2c2.Instance = I2C2;
+   hi2c2.Init.ClockSpeed = 100000;
+   mock_i2c_set_max_hz(&hi2c2, 100000);
+   panels[1].addr = 0x26;
+   lcd_t *d2 = lcd_init(&hi2c2, 0x26, LCD_COLS, LCD_ROWS);
+   mock_run_until_idle();
+   lcd_draw(d2, r0, r1);
+   lcd_flush(d2);
+   mock_run_until_idle();
+   metric("lcd_fallback_khz", lcd_bus_hz(d2) / 1000.0, "kHz");
+   if (!hd_shows(&panels[1], r0, r1)) lcd_wrong++;
+
+   uint32_t inits = mock_i2c_inits();
+   uint32_t errs = lcd_errors(d);
+   mock_edges_clear();
+   lcd_draw(d, c0, c1);
+   mock_i2c_fail_next(4);   /* LCD_I2C_ERR_LIMIT */
+   /* each flush is one transfer: four fail, the fifth recovers and redraws */
+   for (uint8_t i = 0; i < 8 && lcd_bus_recoveries(d) == 0; ++i) {
+       lcd_flush(d);
+       mock_run_until_idle();
+   }
+   metric("lcd_recover_errors", lcd_errors(d) - errs, "errors");
+   metric("lcd_recoveries", lcd_bus_recoveries(d), "recoveries");
+   metric("lcd_recover_reinits", mock_i2c_inits() - inits, "inits");
+   metric("lcd_recover_scl_pulses", scl_pulses(), "pulses");
+   metric("lcd_recover_khz", lcd_bus_hz(d) / 1000.0, "kHz");
+   if (!hd_shows(&panels[0], c0, c1)) {
+       lcd_wrong++;
+       printf("  recover: panel shows |%.16s|%.16s|\n", panels[0].ddram, panels[0].ddram + 0x40);
+   }
+}
+
+static void bench_lcd(void)
+{
+   mock_i2c_stats_t st;
+   hi2c1.Instance = I2C1;
+   hi2c1.Init.ClockSpeed = 100000;   /* as MX_I2C1_Init(); lcd_init() probes faster */
+   memset(panels, 0, sizeof(panels));
+   panels[0].addr = 0x27;
+   mock_i2c_set_tap(hd_tap);
+
+   /* boot as main() does it: claim the display, set everything else up,
+      then poll the bring-up from the 1 ms quiz task until it is done */
+   mock_i2c_reset_stats();
+   uint64_t t0 = mock_cycles();
+   uint32_t inits = mock_i2c_inits();
+   mock_edges_clear();
+   lcd_t *d = lcd_init_start(&hi2c1, 0x27, LCD_COLS, LCD_ROWS);
+   mock_i2c_stats(&st);
+   /* claiming the handle must not touch the bus */
+   metric("lcd_start_bus_ops", st.xfers + (mock_i2c_inits() - inits), "ops");
+   mock_advance((uint64_t)BOOT_SETUP_MS * (SystemCoreClock / 1000U));
+   while (!lcd_init_poll(d)) mock_advance(SystemCoreClock / 1000U);
+   mock_run_until_idle();
+   /* a healthy bus is switched to 400 kHz without the recovery clocks */
+   metric("lcd_boot_scl_pulses", scl_pulses(), "pulses");
+   mock_i2c_stats(&st);
+   metric("lcd_init_bytes", st.bytes, "bytes");
+   metric("lcd_init_ms", cycles_to_us(mock_cycles() - t0) / 1000.0, "ms");
+   metric("lcd_bus_khz", lcd_bus_hz(d) / 1000.0, "kHz");
+
+   static const char blank[] = "                ";
+   static const char a0[] = "What is the capi", a1[] = "tal of Japan?   ";
+   static const char b0[] = "Currency of the ", b1[] = "Philippines is? ";
+   static const char s1[] = "Philippines is?7";
+
+   lcd_draw(d, a0, a1);
+   lcd_measure(d, "full", a0, a1);
+   metric("lcd_first_screen_ms", cycles_to_us(mock_cycles() - t0) / 1000.0, "ms");
+   lcd_measure(d, "same", a0, a1);
+   lcd_draw(d, a0, b1);
+   lcd_measure(d, "row", a0, b1);
+   lcd_draw(d, a0, s1);
+   lcd_measure(d, "cell", a0, s1);
+   lcd_draw(d, b0, b1);
+   lcd_measure(d, "page", b0, b1);
+
+   /* page turns over the linked bank: every page of every question, drawn
+      after the previous one, as the quiz does */
+   qbank_open(qbank_blob);
+   uint64_t bytes = 0, cycles = 0;
+   uint32_t pages = 0;
+   for (uint16_t q = 0; q < qbank_count(); ++q) {
+       uint8_t lines;
+       const char *rows = qbank_lines(q, &lines);
+       for (uint8_t l = 0; l < lines; l = (uint8_t)(l + LCD_ROWS)) {
+           lcd_fb_write_row(d, 0, rows + l * LCD_COLS);
+           lcd_fb_write_row(d, 1, rows + (l + 1) * LCD_COLS);
+           mock_i2c_reset_stats();
+           uint64_t p0 = mock_cycles();
+           lcd_flush(d);
+           mock_run_until_idle();
+           mock_i2c_stats(&st);
+           bytes += st.bytes;
+           cycles += mock_cycles() - p0;
+           pages++;
+           if (!hd_shows(&panels[0], rows + l * LCD_COLS, rows + (l + 1) * LCD_COLS)) lcd_wrong++;
+       }
+   }
+   metric("lcd_bank_page_bytes", pages ? (double)bytes / pages : 0, "bytes");
+   metric("lcd_bank_page_us", pages ? cycles_to_us(cycles) / pages : 0, "us");
+
+   /* direct (unbuffered) path: cursor + a 16 character string */
+   mock_i2c_reset_stats();
+   t0 = mock_cycles();
+   lcd_put_cur(d, 0, 0);
+   lcd_send_string(d, blank);
+   mock_run_until_idle();
+   mock_i2c_stats(&st);
+   metric("lcd_string16_bytes", st.bytes, "bytes");
+   metric("lcd_string16_us", cycles_to_us(mock_cycles() - t0), "us");
+
+#if LCD_ASYNC
+   /* flushes coming faster than the bus drains them must not wait for a
+      queue slot; the newest screen goes out on a later flush */
+   uint64_t spent = 0;
+   mock_i2c_set_timed(1);
+   for (uint8_t i = 0; i < 8; ++i) {
+       if (i & 1) lcd_draw(d, a0, a1);
+       else lcd_draw(d, b0, b1);
+       uint64_t f0 = mock_cycles();
+       lcd_flush(d);
+       spent += mock_cycles() - f0;
+   }
+   mock_run_until_idle();
+   if (lcd_is_idle(d)) lcd_wrong++;   /* the last diff is still pending */
+   lcd_flush(d);
+   mock_run_until_idle();
+   if (!lcd_is_idle(d) || !hd_shows(&panels[0], a0, a1)) lcd_wrong++;
+   mock_i2c_set_timed(0);
+   metric("lcd_busy_flush_us", cycles_to_us(spent) / 8, "us");
+#endif
+
+   bench_lcd_bus(d);
+   metric("lcd_wrong_screens", lcd_wrong, "screens");
+   mock_i2c_set_tap(NULL);
+}
+
+/* ---------- WS2812B ---------- */
+#define LED_COUNT 60
+/* Driver targets per bit, ns (ws2812b.c / ws2812b_tim.c) */
+#define LED_T0H 350
+#define LED_T1H 700
+#if WS2812B_BACKEND == WS2812B_BACKEND_BITBANG
+#define LED_T0BIT 1150
+#define LED_T1BIT 1300
+#else
+#define LED_T0BIT 1250
+#define LED_T1BIT 1250
+static TIM_TypeDef tim3_regs;
+static TIM_HandleTypeDef htim3 = { .Instance = &tim3_regs };
+#endif
+/* Datasheet windows (WS2812B: T0H 0.4 us, T1H 0.8 us, +-150 ns) */
+#define LED_T0H_MIN 250
+#define LED_T0H_MAX 550
+#define LED_T1H_MIN 650
+#define LED_T1H_MAX 950
+
+static void bench_led(void)
+{
+   static uint8_t frame[LED_COUNT * 3];
+   uint32_t seed = 12345;
+   for (uint32_t i = 0; i < sizeof(frame); ++i) {
+       seed = seed * 1103515245U + 12345U;
+       frame[i] = (uint8_t)(seed >> 16);
+   }
+
+   mock_edges_clear();
+   mock_irq_off_reset();
+   uint64_t t0 = mock_cycles();
+#if WS2812B_BACKEND == WS2812B_BACKEND_BITBANG
+   ws2812b_init();
+   ws2812b_send(frame, LED_COUNT);
+   metric("led_irq_off_us", cycles_to_us(mock_irq_off_max()), "us");
+#else
+   mock_tim_set_output(&htim3, WS2812B_PORT, WS2812B_PIN);
+   ws2812b_init(&htim3, TIM_CHANNEL_4);
+   ws2812b_send_async(frame, LED_COUNT, NULL);
+   mock_tim_run();
+#endif
+   metric("led_frame_us", cycles_to_us(mock_cycles() - t0), "us");
+
+   uint32_t n;
+   const mock_edge_t *e = mock_edges(&n);
+   uint32_t bit = 0, wrong = 0, out_of_spec = 0;
+   double high_err_max = 0, high_err_sum = 0, period_err_max = 0;
+   for (uint32_t i = 0; i + 1 < n; ++i) {
+       if (!e[i].level || e[i + 1].level) continue;   /* rising, then falling */
+       if (bit >= sizeof(frame) * 8) break;
+       uint8_t want = (frame[bit / 8] >> (7 - bit % 8)) & 1;
+       double high = cycles_to_us(e[i + 1].at - e[i].at) * 1000.0;
+       double target = want ? LED_T1H : LED_T0H;
+       double err = high > target ? high - target : target - high;
+       if (err > high_err_max) high_err_max = err;
+       high_err_sum += err;
+       if ((high > 525) != want) wrong++;
+       if (want ? (high < LED_T1H_MIN || high > LED_T1H_MAX) : (high < LED_T0H_MIN || high > LED_T0H_MAX)) {
+           out_of_spec++;
+       }
+       /* bit period up to the next rising edge (not for the last bit) */
+       if (i + 2 < n && bit + 1 < sizeof(frame) * 8) {
+           double period = cycles_to_us(e[i + 2].at - e[i].at) * 1000.0;
+           double pt = want ? LED_T1BIT : LED_T0BIT;
+           double perr = period > pt ? period - pt : pt - period;
+           if (perr > period_err_max) period_err_max = perr;
+       }
+       bit++;
+   }
+   wrong += (uint32_t)(sizeof(frame) * 8 - bit);   /* bits never sent */
+   metric("led_high_err_max_ns", high_err_max, "ns");
+   metric("led_high_err_mean_ns", bit ? high_err_sum / bit : 0, "ns");
+   metric("led_period_err_max_ns", period_err_max, "ns");
+   metric("led_bits_out_of_spec", out_of_spec, "bits");
+   metric("led_bits_wrong", wrong, "bits");
+}
+
+/* ---------- Flash log ---------- */
+#define FLOG_BENCH_Q       40
+#define FLOG_BENCH_PLAYERS 3
+#define FLOG_BENCH_ASKED   10      /* questions per round */
+#define REC_WORDS          ((uint32_t)sizeof(flog_rec_t) / 4)
+static flog_total_t flog_model[FLOG_BENCH_Q];
+
+/* A deterministic round r: which question, right or wrong, how fast */
+static void flog_pick(uint32_t r, uint16_t i, uint16_t *q, uint8_t *correct, uint32_t *ms)
+{
+   *q = (uint16_t)((r * 7 + i * 3) % FLOG_BENCH_Q);
+   *correct = ((r + i) % 3) != 0;
+   *ms = (i % 4 == 3) ? FLOG_NO_TIME : 800 + (r * 37 + i * 91) % 4000;
+}
+
+static void flog_model_add(uint16_t q, uint8_t correct, uint32_t ms)
+{
+   flog_model[q].asked++;
+   flog_model[q].correct += correct;
+   if (ms != FLOG_NO_TIME) {
+       flog_model[q].timed++;
+       flog_model[q].ms_sum += ms;
+   }
+}
+
+static void flog_play_round(void)
+{
+   uint32_t r = flog_round_no();
+   int scores[FLOG_BENCH_PLAYERS] = { 0 };
+   for (uint16_t i = 0; i < FLOG_BENCH_ASKED; ++i) {
+       uint16_t q;
+       uint8_t correct;
+       uint32_t ms;
+       flog_pick(r, i, &q, &correct, &ms);
+       uint8_t player = (uint8_t)(i % FLOG_BENCH_PLAYERS);
+       flog_answer(q, player, correct, ms);
+       flog_model_add(q, correct, ms);
+       scores[player] += correct;
+   }
+   flog_round_end(scores, FLOG_BENCH_PLAYERS, FLOG_BENCH_ASKED);
+}
+
+static uint32_t flog_totals_wrong(void)
+{
+   uint32_t wrong = 0;
+   flog_totals_build();
+   for (uint16_t q = 0; q < FLOG_BENCH_Q; ++q) {
+       flog_total_t t;
+       flog_total(q, &t);
+       if (memcmp(&t, &flog_model[q], sizeof(t)) != 0) wrong++;
+   }
+   return wrong;
+}
+
+static void bench_flog(void)
+{
+   mock_flash_stats_t fs;
+   uint32_t wrong = 0;
+
+   if (flog_init() != 0) wrong++;   /* formats the blank mock */
+
+   /* steady state: rounds of 10 answers and 3 scores */
+   const uint32_t rounds = 50;
+   mock_flash_reset_stats();
+   for (uint32_t i = 0; i < rounds; ++i) flog_play_round();
+   mock_flash_stats(&fs);
+   metric("flog_bursts_per_round", (double)fs.bursts / rounds, "bursts");
+   metric("flog_words_per_round", (double)fs.words / rounds, "words");
+
+   /* reset: both headers plus the tail search */
+   uint32_t expect_round = flog_round_no();
+   mock_flash_reset_stats();
+   if (flog_init() != 0) wrong++;
+   mock_flash_stats(&fs);
+   metric("flog_recover_reads", fs.reads, "reads");
+   if (flog_round_no() != expect_round) wrong++;
+
+   /* fill the log through two sector switches */
+   mock_flash_reset_stats();
+   uint32_t start = flog_round_no();
+   while (flog_seq() < 3) flog_play_round();
+   mock_flash_stats(&fs);
+   metric("flog_rounds_per_erase", fs.erases ? (double)(flog_round_no() - start) / fs.erases : 0, "rounds");
+   if (flog_init() != 0) wrong++;
+   wrong += flog_totals_wrong();
+   metric("flog_totals_wrong", wrong, "questions");
+
+   /* power cut in the middle of a burst: the first record makes it, the
+      second is torn, the rest never leave RAM */
+   uint32_t torn = 0;
+   expect_round = flog_round_no() + 1;
+   flog_answer(1, 0, 1, 1500);
+   flog_answer(2, 1, 1, 1600);
+   flog_answer(3, 2, 1, 1700);
+   mock_flash_cut_after(REC_WORDS);
+   flog_flush();
+   mock_flash_cut_after(MOCK_FLASH_NO_CUT);
+   flog_model_add(1, 1, 1500);
+   if (flog_init() != 0) torn++;
+   if (flog_round_no() != expect_round) torn++;
+   torn += flog_totals_wrong();
+   /* and the log carries on behind the torn slot */
+   flog_play_round();
+   if (flog_init() != 0) torn++;
+   if (flog_round_no() != expect_round + 1) torn++;
+   torn += flog_totals_wrong();
+   metric("flog_torn_wrong", torn, "questions");
+
+   /* program error in the middle of a burst, no reset: the first record
+      is written, the second's first word fails. Every slot below the tail
+      must still read as used, or the tail search after a reset can land
+      in the gap and the log would write over records. */
+   uint32_t failed = 0;
+   flog_answer(4, 0, 1, 1800);
+   flog_answer(5, 1, 0, 1900);
+   flog_answer(6, 2, 1, 2000);
+   mock_flash_fail_after(REC_WORDS);
+   if (flog_flush() == 0) failed++;
+   flog_model_add(4, 1, 1800);
+   uint32_t records = flog_records();
+   uint32_t base = ((flog_seq() - 1) & 1) ? FLOG_ADDR_B : FLOG_ADDR_A;
+   for (uint32_t s = 1; s <= records; ++s) {
+       uint32_t w;
+       memcpy(&w, mock_flash_ptr(base + s * (uint32_t)sizeof(flog_rec_t)), sizeof(w));
+       if (w == 0xFFFFFFFFUL) failed++;
+   }
+   flog_play_round();
+   records = flog_records();
+   expect_round = flog_round_no();
+   if (flog_init() != 0) failed++;
+   if (flog_records() != records || flog_round_no() != expect_round) failed++;
+   failed += flog_totals_wrong();
+   metric("flog_fail_wrong", failed, "questions");
+}
+
+/* ---------- Binary protocol ---------- */
+#define PROTO_BAUD 921600
+static UART_HandleTypeDef huart_rig = { .Init = { .BaudRate = PROTO_BAUD } };
+static uint8_t rig_reply[4096];          /* what the device sent back */
+static uint32_t rig_reply_len = 0;
+static uint32_t rig_entries = 0;         /* CHECK entries the handler saw intact */
+static uint32_t rig_damaged = 0;         /* ... and ones that were not */
+
+static void rig_tx(const char *data, uint16_t len)
+{
+   if (rig_reply_len + len > sizeof(rig_reply)) return;
+   memcpy(&rig_reply[rig_reply_len], data, len);
+   rig_reply_len += len;
+}
+
+static uint16_t rig_crc(uint16_t crc, const uint8_t *p, uint32_t n)
+{
+   while (n--) {
+       crc ^= (uint16_t)(*p++ << 8);
+       for (int b = 0; b < 8; ++b) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+   }
+   return crc;
+}
+
+static uint32_t rig_frame(uint8_t *out, uint8_t type, const uint8_t *payload, uint16_t len)
+{
+   out[0] = PROTO_SYNC;
+   out[1] = (uint8_t)len;
+   out[2] = (uint8_t)(len >> 8);
+   out[3] = type;
+   memcpy(&out[4], payload, len);
+   uint16_t crc = rig_crc(0xFFFF, &out[1], 3U + len);
+   out[4 + len] = (uint8_t)crc;
+   out[5 + len] = (uint8_t)(crc >> 8);
+   return 6U + len;
+}
+
+/* Entry i of a batch: question i, answer text that encodes i */
+static uint8_t rig_entry(uint8_t *out, uint32_t i)
+{
+   char text[24];
+   int n = snprintf(text, sizeof(text), "answer %lu", (unsigned long)i);
+   out[0] = (uint8_t)i;
+   out[1] = (uint8_t)(i >> 8);
+   out[2] = (uint8_t)n;
+   memcpy(&out[3], text, (size_t)n);
+   return (uint8_t)(3 + n);
+}
+
+/* Stand-in for main.c's checker: verifies each entry arrived as sent */
+static void rig_check(const uint8_t *p, uint16_t len)
+{
+   uint8_t verdicts[PROTO_MAX_PAYLOAD];
+   uint8_t want[32];
+   uint16_t at = 0, n = 0;
+   while (at + 3U <= len && n < 200) {
+       uint8_t el = rig_entry(want, proto_u16(&p[at]));
+       if (at + el > len || memcmp(&p[at], want, el) != 0) {
+           rig_damaged++;
+           break;
+       }
+       verdicts[2 + n++] = PROTO_RIGHT;
+       at = (uint16_t)(at + el);
+   }
+   rig_entries += n;
+   verdicts[0] = (uint8_t)n;
+   verdicts[1] = (uint8_t)(n >> 8);
+   proto_reply(PROTO_T_CHECK, PROTO_OK, verdicts, (uint16_t)(2 + n));
+}
+
+/* Replies must be whole frames: count the ones that are not */
+static uint32_t rig_replies_wrong(uint32_t *count)
+{
+   uint32_t at = 0, wrong = 0;
+   *count = 0;
+   while (at + 6 <= rig_reply_len) {
+       uint16_t len = (uint16_t)(rig_reply[at + 1] | (rig_reply[at + 2] << 8));
+       if (rig_reply[at] != PROTO_SYNC || at + 6U + len > rig_reply_len) {
+           rig_reply_len = 0;
+           return wrong + 1;
+       }
+       uint16_t crc = (uint16_t)(rig_reply[at + 4 + len] | (rig_reply[at + 5 + len] << 8));
+       if (crc != rig_crc(0xFFFF, &rig_reply[at + 1], 3U + len) || rig_reply[at + 4] != PROTO_OK) wrong++;
+       (*count)++;
+       at += 6U + len;
+   }
+   wrong += (at != rig_reply_len);
+   rig_reply_len = 0;
+   return wrong;
+}
+
+static void bench_proto(void)
+{
+   uint8_t payload[PROTO_MAX_PAYLOAD], wire[PROTO_MAX_PAYLOAD + 64];
+   char line[UART_LINE_MAX];
+   uint32_t lost = 0, lines_wrong = 0, wrong = 0, replies = 0, r;
+   uint32_t sent_frames = 0, sent_entries = 0, bad_sent = 0, wire_bytes = 0;
+
+   int port = uart_rx_start(&huart_rig);
+   uart_rx_set_hook((uint8_t)port, proto_rx_byte);
+   proto_init(rig_tx);
+   proto_register(PROTO_T_CHECK, rig_check);
+
+   /* full CHECK batches, every 8th one corrupted, a typed line after every
+      4th; proto_task runs after each frame as the 1 ms task would */
+   uint32_t next = 0, crc_before = proto_crc_errors();
+   for (uint32_t f = 0; f < 400; ++f) {
+       uint16_t len = 0;
+       uint32_t first = next;
+       while (len + 16 <= PROTO_MAX_PAYLOAD) len = (uint16_t)(len + rig_entry(&payload[len], next++));
+       uint32_t n = rig_frame(wire, PROTO_T_CHECK, payload, len);
+       if (f % 8 == 7) {
+           wire[10] ^= 0x20;
+           next = first;                 /* not taken: resend these */
+           bad_sent++;
+       } else {
+           sent_frames++;
+           sent_entries += next - first;
+       }
+       mock_uart_receive(&huart_rig, wire, n);
+       wire_bytes += n;
+       proto_task();
+       if (f % 4 == 3) {
+           char typed[32];
+           int tl = snprintf(typed, sizeof(typed), "typed %lu\r\n", (unsigned long)f);
+           mock_uart_receive(&huart_rig, (const uint8_t *)typed, (uint32_t)tl);
+           typed[tl - 2] = '\0';
+           if (uart_rx_get_line_port((uint8_t)port, line, sizeof(line), NULL) < 0 ||
+               strcmp(line, typed) != 0) {
+               lines_wrong++;
+           }
+       }
+       wrong += rig_replies_wrong(&r);
+       replies += r;
+   }
+   lost += sent_entries - rig_entries;
+   lost += sent_frames - replies;
+   if (proto_crc_errors() - crc_before != bad_sent) wrong++;
+
+   /* a frame cut off mid-way, silence, then a good one */
+   uint32_t n = rig_frame(wire, PROTO_T_CHECK, payload, rig_entry(payload, 7));
+   uint32_t entries_before = rig_entries;
+   mock_uart_receive(&huart_rig, wire, n / 2);
+   mock_advance((uint64_t)(PROTO_RX_TIMEOUT_MS + 5) * (SystemCoreClock / 1000UL));
+   proto_task();
+   mock_uart_receive(&huart_rig, wire, n);
+   proto_task();
+   if (rig_entries != entries_before + 1) lost++;
+   /* an impossible length: swallowed until the line goes quiet, then text works */
+   uint8_t junk[8] = { PROTO_SYNC, 0xFF, 0xFF, PROTO_T_CHECK, 'x', '\r', '\n', 'y' };
+   mock_uart_receive(&huart_rig, junk, sizeof(junk));
+   mock_advance((uint64_t)(PROTO_RX_TIMEOUT_MS + 5) * (SystemCoreClock / 1000UL));
+   proto_task();
+   mock_uart_receive(&huart_rig, (const uint8_t *)"after\r\n", 7);
+   if (uart_rx_get_line_port((uint8_t)port, line, sizeof(line), NULL) < 0 || strcmp(line, "after") != 0) {
+       lines_wrong++;
+   }
+   if (uart_rx_get_line_port((uint8_t)port, line, sizeof(line), NULL) >= 0) lines_wrong++;   /* junk as text */
+   wrong += rig_replies_wrong(&r);
+
+   metric("proto_frames_lost", lost, "frames");
+   metric("proto_lines_wrong", lines_wrong, "lines");
+   metric("proto_bad_accepted", rig_damaged, "frames");
+   metric("proto_replies_wrong", wrong, "frames");
+   metric("proto_answers_per_min", sent_entries * 60.0 * PROTO_BAUD / 10 / wire_bytes, "1/min");
+}
+
+/* ---------- Answer matching ---------- */
+static uint8_t *read_file(const char *path, long *size)
+{
+   FILE *f = fopen(path, "rb");
+   if (!f) return NULL;
+   fseek(f, 0, SEEK_END);
+   *size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   uint8_t *buf = malloc((size_t)*size + 4);   /* malloc is 4-byte aligned */
+   if (buf && fread(buf, 1, (size_t)*size, f) != (size_t)*size) {
+       free(buf);
+       buf = NULL;
+   }
+   fclose(f);
+   return buf;
+}
+
+static double now_s(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* How a player types a variant: padded, shouted, doubled spaces */
+static void player_input(const char *v, char *out, size_t size)
+{
+   size_t n = 0;
+   out[n++] = ' ';
+   for (; *v && n + 3 < size; ++v) {
+       out[n++] = (*v >= 'a' && *v <= 'z') ? (char)(*v - 32) : *v;
+       if (*v == ' ') out[n++] = ' ';
+   }
+   out[n++] = ' ';
+   out[n] = '\0';
+}
+
+static void bench_answers(const char *path)
+{
+   long size;
+   uint8_t *blob = read_file(path, &size);
+   if (!blob || qbank_open(blob) != 0) {
+       fprintf(stderr, "bench: %s is not a question bank\n", path);
+       free(blob);
+       broken++;
+       return;
+   }
+   uint16_t count = qbank_count();
+   char key[48], in[96];
+   uint32_t wrong = 0;
+
+   /* verdicts: every variant as typed, one wrong answer, one typo */
+   for (uint16_t q = 0; q < count; ++q) {
+       for (uint16_t v = 0; v < qbank_num_variants(q); ++v) {
+           player_input(qbank_variant(q, v), in, sizeof(in));
+           if (!answer_is_correct(in, q)) wrong++;
+       }
+       if (answer_is_correct("qwxqwx", q)) wrong++;
+#if ANSWER_FUZZY
+       if (qbank_max_dist(q) > 0) {
+           snprintf(in, sizeof(in), "%sx", qbank_variant(q, 0));
+           if (!answer_is_correct(in, q)) wrong++;
+       }
+#endif
+   }
+
+   /* throughput: a correct and a wrong answer per question, over and over */
+   uint32_t checks = 0;
+   volatile int sink = 0;
+   double t0 = now_s(), t1;
+   do {
+       for (uint16_t q = 0; q < count; ++q) {
+           player_input(qbank_variant(q, 0), in, sizeof(in));
+           sink += answer_is_correct(in, q);
+           sink += answer_is_correct("qwxqwx", q);
+           checks += 2;
+       }
+       t1 = now_s();
+   } while (t1 - t0 < 0.2);
+   (void)sink;
+
+   snprintf(key, sizeof(key), "answer_%u_checks_per_s", (unsigned)count);
+   metric(key, checks / (t1 - t0), "1/s");
+   snprintf(key, sizeof(key), "answer_%u_ns_per_check", (unsigned)count);
+   metric(key, (t1 - t0) * 1e9 / checks, "ns");
+   snprintf(key, sizeof(key), "answer_%u_wrong", (unsigned)count);
+   metric(key, wrong, "verdicts");
+   free(blob);
+}
+
+/* ---------- LED effects ---------- */
+
+/* Bytes of a strip frame read back from the GPIO edge log */
+static uint32_t led_decode(uint8_t *out, uint32_t size)
+{
+   uint32_t n, bit = 0;
+   const mock_edge_t *e = mock_edges(&n);
+   memset(out, 0, size);
+   for (uint32_t i = 0; i + 1 < n && bit < size * 8; ++i) {
+       if (!e[i].level || e[i + 1].level) continue;
+       if (cycles_to_us(e[i + 1].at - e[i].at) * 1000.0 > 525) out[bit / 8] |= (uint8_t)(0x80 >> (bit % 8));
+       bit++;
+   }
+   return bit / 8;
+}
+
+static uint32_t frame_diff(const uint8_t *a, const uint8_t *b, uint32_t n)
+{
+   uint32_t d = 0;
+   for (uint32_t i = 0; i < n; ++i) d += a[i] != b[i];
+   return d;
+}
+
+/* Let the simulated clock reach tick ms, as the scheduler would */
+static void advance_to_ms(uint64_t ms)
+{
+   uint64_t at = ms * (SystemCoreClock / 1000UL);
+   if (at > mock_cycles()) mock_advance(at - mock_cycles());
+}
+
+static void bench_ledfx(void)
+{
+   /* every hue, a spread of saturations and values */
+   double err_max = 0;
+   for (uint32_t h = 0; h < LEDFX_HUE_MAX; ++h) {
+       for (uint32_t s = 0; s <= 255; s += 51) {
+           for (uint32_t v = 0; v <= 255; v += 15) {
+               uint8_t rgb[3];
+               ledfx_hsv((uint16_t)h, (uint8_t)s, (uint8_t)v, rgb);
+               double f = (h % 256) / 256.0, sf = s / 255.0;
+               double p = v * (1 - sf), q = v * (1 - sf * f), t = v * (1 - sf * (1 - f));
+               double ref[6][3] = { { v, t, p }, { q, v, p }, { p, v, t },
+                                    { p, q, v }, { t, p, v }, { v, p, q } };
+               for (int c = 0; c < 3; ++c) {
+                   double d = rgb[c] - ref[h / 256][c];
+                   if (d < 0) d = -d;
+                   if (d > err_max) err_max = d;
+               }
+           }
+       }
+   }
+   metric("ledfx_hsv_err_max", err_max, "levels");
+
+   /* 2 s of countdown at the task period; the frame goes out between runs */
+   ledfx_init();
+   uint64_t ms = mock_cycles() / (SystemCoreClock / 1000UL) + 1;
+   advance_to_ms(ms);
+   ledfx_play(LEDFX_COUNTDOWN, 10000);
+   uint32_t first = ledfx_frames(), runs = 0;
+   uint64_t c0 = mock_cycles();
+   double task_s = 0;
+   for (uint32_t t = 0; t < 2000; t += LEDFX_FRAME_MS) {
+       advance_to_ms(ms + t);
+       double t0 = now_s();
+       ledfx_task();
+       task_s += now_s() - t0;
+       runs++;
+       mock_tim_run();
+   }
+   advance_to_ms(ms + 2000);
+   metric("ledfx_fps", (ledfx_frames() - first) / (cycles_to_us(mock_cycles() - c0) / 1e6), "1/s");
+   metric("ledfx_task_host_us", task_s * 1e6 / runs, "us");
+
+   /* the next frame is rendered while the last one is still on the wire;
+      what goes out must be exactly what was handed over */
+   static uint8_t sent[LEDFX_COUNT * 3], wire[LEDFX_COUNT * 3];
+   uint32_t torn = 0;
+   ms += 2000;
+   advance_to_ms(ms);
+   ledfx_play(LEDFX_SWEEP, 1000);
+   for (int k = 0; k < 3; ++k) {
+       ms += 250;
+       advance_to_ms(ms);
+       mock_edges_clear();
+       ledfx_task();
+       memcpy(sent, ledfx_front(), sizeof(sent));
+       advance_to_ms(ms + LEDFX_FRAME_MS);
+       ledfx_task();   /* renders the next frame; the strip may still be busy */
+       mock_tim_run();
+       if (led_decode(wire, sizeof(wire)) != sizeof(wire)) torn++;
+       torn += frame_diff(sent, wire, sizeof(wire));
+   }
+   metric("ledfx_frames_torn", torn, "bytes");
+   ledfx_stop();
+   ledfx_task();
+   mock_tim_run();
+}
+
+int main(int argc, char **argv)
+{
+   int i = 1;
+   if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+       load_limits(argv[i + 1]);
+       i += 2;
+   }
+
+   printf("# LCD_ASYNC=%d, I2C set up at 100 kHz, %u MHz core\n", LCD_ASYNC, (unsigned)(SystemCoreClock / 1000000UL));
+   bench_lcd();
+   printf("# WS2812B backend %d, %d LEDs\n", WS2812B_BACKEND, LED_COUNT);
+   bench_led();
+   printf("# flash log, %u record slots per sector\n", (unsigned)flog_capacity());
+   bench_flog();
+   printf("# binary protocol at %u baud, %u-byte payloads\n", (unsigned)PROTO_BAUD, (unsigned)PROTO_MAX_PAYLOAD);
+   bench_proto();
+   printf("# LED effects, %d LEDs every %d ms\n", LEDFX_COUNT, LEDFX_FRAME_MS);
+   bench_ledfx();
+   for (; i < argc; ++i) {
+       printf("# %s\n", argv[i]);
+       bench_answers(argv[i]);
+   }
+
+   if (broken) printf("%d limit(s) broken\n", broken);
+   return broken ? 1 : 0;
+}
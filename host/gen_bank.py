@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+"""Write a synthetic questions.txt with N questions for the host benchmark.
+
+Answers are made-up words, so the hashed index gets realistic collisions
+between questions but no accidental matches; some questions allow typos
+(D:) so the fuzzy path is exercised too. Output is deterministic for a
+given N and --seed. Pack it with tools/qbank_pack.py --bin as usual.
+"""
+import argparse
+import random
+
+SYLLABLES = ["ka", "ri", "to", "na", "mel", "zu", "po", "lin", "dar", "os",
+             "ve", "qui", "sam", "te", "bor", "ix", "lu", "ghe", "fa", "no"]
+
+
+def word(rng, lo=2, hi=4):
+    return "".join(rng.choice(SYLLABLES) for _ in range(rng.randint(lo, hi)))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument("count", type=int, help="number of questions")
+    ap.add_argument("-o", "--output", required=True, help="questions file to write")
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+
+    rng = random.Random(args.seed)
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write("# synthetic bank: %d questions (host/gen_bank.py)\n" % args.count)
+        for i in range(args.count):
+            f.write("Q: Question %d: what is the %s of %s?\n" % (i + 1, word(rng), word(rng)))
+            answers = []
+            n = rng.randint(1, 3)
+            while len(answers) < n:
+                a = word(rng) if rng.random() < 0.7 else "%s %s" % (word(rng), word(rng))
+                if a not in answers:
+                    answers.append(a)
+            f.write("A: %s\n" % " | ".join(answers))
+            if rng.random() < 0.3:
+                f.write("D: %d\n" % rng.randint(1, 2))
+            f.write("\n")
+
+
+if __name__ == "__main__":
+    main()
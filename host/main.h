@@ -0,0 +1,5 @@
+#ifndef MAIN_H
+#define MAIN_H
+/* host/main.h - stands in for the CubeMX main.h (included via qstore.h) */
+#include "stm32f4xx_hal.h"
+#endif /* MAIN_H */
@@ -0,0 +1,588 @@
+/*
+* host/mock_hal.c - recording HAL for host builds (see stm32f4xx_hal.h)
+*/
+
+#include "stm32f4xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t SystemCoreClock = 84000000UL;   /* as SystemClock_Config() sets it */
+CoreDebug_Type mock_core_debug;
+GPIO_TypeDef mock_gpio[8];
+
+static DWT_Type dwt;
+static uint64_t now = 0;
+static void i2c_poll(void);
+
+/* ---------- Clock ---------- */
+uint64_t mock_cycles(void)
+{
+   return now;
+}
+
+void mock_advance(uint64_t cycles)
+{
+   now += cycles;
+}
+
+uint32_t HAL_GetTick(void)
+{
+   now += MOCK_DWT_POLL_CYCLES;   /* polled in wait loops like CYCCNT */
+   i2c_poll();
+   return (uint32_t)(now / (SystemCoreClock / 1000UL));
+}
+
+void HAL_Delay(uint32_t ms)
+{
+   /* HAL_Delay() waits one extra tick */
+   now += (uint64_t)(ms + 1) * (SystemCoreClock / 1000UL);
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+   return SystemCoreClock;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+   return SystemCoreClock / 2;   /* APB1 prescaler 2 */
+}
+
+/* ---------- GPIO ---------- */
+#define MOCK_MAX_EDGES 65536
+static mock_edge_t edges[MOCK_MAX_EDGES];
+static uint32_t edge_count = 0;
+
+static void gpio_set_odr(GPIO_TypeDef *port, uint32_t odr)
+{
+   uint32_t changed = (port->ODR ^ odr) & 0xFFFFU;
+   port->ODR = odr;
+   for (uint16_t pin = 1; changed; pin = (uint16_t)(pin << 1)) {
+       if (!(changed & pin)) continue;
+       changed &= ~(uint32_t)pin;
+       if (edge_count >= MOCK_MAX_EDGES) continue;
+       mock_edge_t *e = &edges[edge_count++];
+       e->at = now;
+       e->port = (uint8_t)(port - mock_gpio);
+       e->pin = pin;
+       e->level = (odr & pin) ? 1 : 0;
+   }
+}
+
+/* A BSRR store takes effect once the core gets to its next instruction,
+   which the mock only sees at the next DWT access */
+static void gpio_apply_bsrr(void)
+{
+   for (uint8_t i = 0; i < 8; ++i) {
+       uint32_t bsrr = mock_gpio[i].BSRR;
+       if (!bsrr) continue;
+       mock_gpio[i].BSRR = 0;
+       uint32_t odr = mock_gpio[i].ODR;
+       odr &= ~(bsrr >> 16);
+       odr |= bsrr & 0xFFFFU;
+       gpio_set_odr(&mock_gpio[i], odr);
+   }
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state)
+{
+   gpio_set_odr(port, state ? (port->ODR | pin) : (port->ODR & ~(uint32_t)pin));
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *port, uint16_t pin)
+{
+   gpio_set_odr(port, port->ODR ^ pin);
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init)
+{
+   (void)port;
+   (void)init;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin)
+{
+   return (port->IDR & pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+const mock_edge_t *mock_edges(uint32_t *count)
+{
+   *count = edge_count;
+   return edges;
+}
+
+void mock_edges_clear(void)
+{
+   edge_count = 0;
+}
+
+DWT_Type *mock_dwt_access(void)
+{
+   gpio_apply_bsrr();
+   now += MOCK_DWT_POLL_CYCLES;
+   dwt.CYCCNT = (uint32_t)now;
+   return &dwt;
+}
+
+/* ---------- Interrupt mask ---------- */
+static uint32_t primask = 0;
+static uint64_t irq_off_at = 0;
+static uint64_t irq_off_max = 0;
+static void i2c_deliver(void);
+static uint8_t i2c_timed = 0;
+
+void __disable_irq(void)
+{
+   if (!primask) irq_off_at = now;
+   primask = 1;
+}
+
+void __enable_irq(void)
+{
+   if (primask && now - irq_off_at > irq_off_max) irq_off_max = now - irq_off_at;
+   primask = 0;
+   i2c_deliver();
+}
+
+/* Timed I2C: a transfer that has ended completes when the clock is read */
+static void i2c_poll(void)
+{
+   if (i2c_timed && !primask) i2c_deliver();
+}
+
+uint32_t __get_PRIMASK(void)
+{
+   return primask;
+}
+
+uint64_t mock_irq_off_max(void)
+{
+   return irq_off_max;
+}
+
+void mock_irq_off_reset(void)
+{
+   irq_off_max = 0;
+}
+
+/* ---------- UART ---------- */
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *buf, uint16_t size)
+{
+   huart->rx_buf = buf;
+   huart->rx_size = size;
+   huart->rx_pos = 0;
+   return HAL_OK;
+}
+
+void mock_uart_receive(UART_HandleTypeDef *huart, const uint8_t *data, uint32_t len)
+{
+   uint64_t per_byte = (uint64_t)SystemCoreClock * 10U / huart->Init.BaudRate;
+   uint16_t told = huart->rx_pos;   /* index of the last event */
+   if (!huart->rx_buf) return;
+   while (len--) {
+       huart->rx_buf[huart->rx_pos++] = *data++;
+       now += per_byte;
+       if (huart->rx_pos == huart->rx_size / 2) {
+           HAL_UARTEx_RxEventCallback(huart, huart->rx_pos);
+           told = huart->rx_pos;
+       } else if (huart->rx_pos == huart->rx_size) {
+           HAL_UARTEx_RxEventCallback(huart, huart->rx_pos);
+           huart->rx_pos = 0;
+           told = 0;
+       }
+   }
+   if (huart->rx_pos != told) HAL_UARTEx_RxEventCallback(huart, huart->rx_pos);   /* IDLE */
+}
+
+/* ---------- FLASH ---------- */
+#define MOCK_FLASH_BASE   0x080C0000UL
+#define MOCK_FLASH_SECTOR 0x20000UL
+static uint8_t flash_mem[2 * MOCK_FLASH_SECTOR];
+static uint8_t flash_blanked = 0;
+static uint8_t flash_locked = 1;
+static uint32_t flash_budget = MOCK_FLASH_NO_CUT;
+static uint8_t flash_dead = 0;         /* after a cut */
+static uint32_t flash_fail = MOCK_FLASH_NO_CUT;
+static mock_flash_stats_t flash_stats;
+
+static void flash_blank(void)
+{
+   if (flash_blanked) return;
+   memset(flash_mem, 0xFF, sizeof(flash_mem));
+   flash_blanked = 1;
+}
+
+const uint8_t *mock_flash_ptr(uint32_t addr)
+{
+   flash_blank();
+   if (addr < MOCK_FLASH_BASE || addr >= MOCK_FLASH_BASE + sizeof(flash_mem)) {
+       fprintf(stderr, "mock: flash read outside sectors 10/11 at 0x%08lx\n", (unsigned long)addr);
+       abort();
+   }
+   flash_stats.reads++;
+   return &flash_mem[addr - MOCK_FLASH_BASE];
+}
+
+void mock_flash_stats(mock_flash_stats_t *out)
+{
+   *out = flash_stats;
+}
+
+void mock_flash_reset_stats(void)
+{
+   memset(&flash_stats, 0, sizeof(flash_stats));
+}
+
+void mock_flash_cut_after(uint32_t words)
+{
+   flash_budget = words;
+   flash_dead = 0;
+}
+
+void mock_flash_fail_after(uint32_t words)
+{
+   flash_fail = words;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+   flash_locked = 0;
+   flash_stats.bursts++;
+   return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+   flash_locked = 1;
+   return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *init, uint32_t *sector_error)
+{
+   flash_blank();
+   *sector_error = 0xFFFFFFFFU;
+   if (flash_locked || flash_dead) return HAL_ERROR;
+   for (uint32_t i = 0; i < init->NbSectors; ++i) {
+       uint32_t sec = init->Sector + i;
+       if (sec != FLASH_SECTOR_10 && sec != FLASH_SECTOR_11) {
+           *sector_error = sec;
+           return HAL_ERROR;
+       }
+       memset(&flash_mem[(sec - FLASH_SECTOR_10) * MOCK_FLASH_SECTOR], 0xFF, MOCK_FLASH_SECTOR);
+       now += (uint64_t)MOCK_FLASH_ERASE_MS * (SystemCoreClock / 1000UL);
+       flash_stats.erases++;
+   }
+   return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t type, uint32_t addr, uint64_t data)
+{
+   flash_blank();
+   if (flash_locked || type != FLASH_TYPEPROGRAM_WORD || (addr & 3U) ||
+       addr < MOCK_FLASH_BASE || addr + 4 > MOCK_FLASH_BASE + sizeof(flash_mem)) {
+       return HAL_ERROR;
+   }
+   uint32_t w = (uint32_t)data;
+   if (flash_dead) return HAL_ERROR;
+   if (flash_fail != MOCK_FLASH_NO_CUT && flash_fail-- == 0) {
+       flash_fail = MOCK_FLASH_NO_CUT;
+       return HAL_ERROR;
+   }
+   if (flash_budget != MOCK_FLASH_NO_CUT) {
+       if (flash_budget == 0) {
+           w |= 0xFFFF0000UL;          /* torn: only the low half made it */
+           flash_dead = 1;
+       } else {
+           flash_budget--;
+       }
+   }
+   uint8_t *p = &flash_mem[addr - MOCK_FLASH_BASE];
+   for (int i = 0; i < 4; ++i) p[i] &= (uint8_t)(w >> (8 * i));
+   now += (uint64_t)MOCK_FLASH_WORD_US * (SystemCoreClock / 1000000UL);
+   flash_stats.words++;
+   return HAL_OK;
+}
+
+/* ---------- I2C ---------- */
+I2C_TypeDef mock_i2c1, mock_i2c2;
+static mock_i2c_tap_fn_t i2c_tap = NULL;
+static mock_i2c_stats_t i2c_stats;
+static uint64_t bus_free_at = 0;
+static uint32_t i2c_inits = 0;
+static uint32_t fail_next = 0;
+static uint8_t latch[128];   /* last byte written per 7-bit address */
+static struct { I2C_HandleTypeDef *h; uint32_t max_hz; } limits[4];
+
+/* Pending DMA/IT write (one in flight, as on the real peripheral) */
+static I2C_HandleTypeDef *pend_h = NULL;
+static uint8_t pend_failed = 0;
+static uint8_t delivering = 0;
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+   (void)hi2c;
+   i2c_inits++;
+   return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
+{
+   /* aborts whatever is in flight without a callback */
+   if (pend_h == hi2c) pend_h = NULL;
+   return HAL_OK;
+}
+
+uint32_t mock_i2c_inits(void)
+{
+   return i2c_inits;
+}
+
+void mock_i2c_set_max_hz(I2C_HandleTypeDef *hi2c, uint32_t max_hz)
+{
+   for (int i = 0; i < 4; ++i) {
+       if (limits[i].h == hi2c || limits[i].h == NULL) {
+           limits[i].h = hi2c;
+           limits[i].max_hz = max_hz;
+           return;
+       }
+   }
+}
+
+void mock_i2c_fail_next(uint32_t n)
+{
+   fail_next = n;
+}
+
+/* 1 if this transfer is to be NACKed */
+static int i2c_fault(I2C_HandleTypeDef *hi2c)
+{
+   if (fail_next) {
+       fail_next--;
+       return 1;
+   }
+   for (int i = 0; i < 4; ++i) {
+       if (limits[i].h == hi2c && limits[i].max_hz && hi2c->Init.ClockSpeed > limits[i].max_hz) return 1;
+   }
+   return 0;
+}
+
+void mock_i2c_set_tap(mock_i2c_tap_fn_t tap)
+{
+   i2c_tap = tap;
+}
+
+void mock_i2c_stats(mock_i2c_stats_t *out)
+{
+   *out = i2c_stats;
+}
+
+void mock_i2c_reset_stats(void)
+{
+   memset(&i2c_stats, 0, sizeof(i2c_stats));
+}
+
+uint64_t mock_i2c_busy_until(void)
+{
+   return bus_free_at > now ? bus_free_at : now;
+}
+
+/* Put one write on the bus model: START, address, len data bytes, STOP.
+   Every byte is 9 SCL periods (8 bits + ACK); START/STOP about one more. */
+static uint64_t i2c_bus(I2C_HandleTypeDef *hi2c, uint16_t addr, const uint8_t *data, uint16_t len)
+{
+   uint32_t speed = hi2c->Init.ClockSpeed ? hi2c->Init.ClockSpeed : 100000UL;
+   uint64_t bits = 9ULL * (len + 1U) + 1U;
+   uint64_t cycles = (bits * SystemCoreClock + speed - 1) / speed;
+   uint64_t start = bus_free_at > now ? bus_free_at : now;
+
+   (void)addr;
+   (void)data;
+   bus_free_at = start + cycles;
+   i2c_stats.bus_cycles += cycles;
+   return bus_free_at;
+}
+
+/* A write that got its ACKs: count it, latch it, show it to the tap */
+static void i2c_written(uint16_t addr, const uint8_t *data, uint16_t len)
+{
+   i2c_stats.xfers++;
+   i2c_stats.bytes += len;
+   if (len) latch[(addr >> 1) & 0x7F] = data[len - 1];
+   if (i2c_tap) i2c_tap((uint8_t)(addr >> 1), data, len);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t addr, uint8_t *data, uint16_t len, uint32_t timeout)
+{
+   (void)timeout;
+   if (pend_h) return HAL_BUSY;
+   if (i2c_fault(hi2c)) {
+       now = i2c_bus(hi2c, addr, data, 0);   /* NACK on the address */
+       return HAL_ERROR;
+   }
+   now = i2c_bus(hi2c, addr, data, len);
+   i2c_written(addr, data, len);
+   return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t addr, uint8_t *data, uint16_t len, uint32_t timeout)
+{
+   (void)timeout;
+   if (pend_h) return HAL_BUSY;
+   uint32_t speed = hi2c->Init.ClockSpeed ? hi2c->Init.ClockSpeed : 100000UL;
+   now = i2c_bus(hi2c, addr, data, 0);
+   if (i2c_fault(hi2c)) return HAL_ERROR;
+   memset(data, latch[(addr >> 1) & 0x7F], len);
+   now += (uint64_t)len * 9U * SystemCoreClock / speed;
+   return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t addr, uint32_t trials, uint32_t timeout)
+{
+   (void)timeout;
+   if (pend_h) return HAL_BUSY;
+   for (uint32_t i = 0; i < trials; ++i) {
+       now = i2c_bus(hi2c, addr, NULL, 0);
+       if (!i2c_fault(hi2c)) return HAL_OK;
+   }
+   return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c, uint16_t addr, uint8_t *data, uint16_t len)
+{
+   if (pend_h) return HAL_BUSY;
+   pend_failed = (uint8_t)i2c_fault(hi2c);
+   i2c_bus(hi2c, addr, data, pend_failed ? 0 : len);
+   if (!pend_failed) i2c_written(addr, data, len);
+   pend_h = hi2c;   /* completes at the next __enable_irq() */
+   return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t addr, uint8_t *data, uint16_t len)
+{
+   return HAL_I2C_Master_Transmit_DMA(hi2c, addr, data, len);
+}
+
+/* Run completion callbacks. The callback usually starts the next transfer,
+   which is then delivered by the same loop rather than by recursion. */
+static void i2c_deliver(void)
+{
+   if (delivering) return;
+   delivering = 1;
+   while (pend_h && !(i2c_timed && now < bus_free_at)) {
+       I2C_HandleTypeDef *h = pend_h;
+       pend_h = NULL;
+       if (pend_failed) HAL_I2C_ErrorCallback(h);
+       else HAL_I2C_MasterTxCpltCallback(h);
+   }
+   delivering = 0;
+}
+
+void mock_run_until_idle(void)
+{
+   do {
+       if (i2c_timed && bus_free_at > now) now = bus_free_at;
+       i2c_deliver();
+   } while (pend_h);
+   if (bus_free_at > now) now = bus_free_at;
+}
+
+void mock_i2c_set_timed(uint8_t on)
+{
+   i2c_timed = on;
+}
+
+/* ---------- TIM PWM + DMA ---------- */
+static TIM_HandleTypeDef *pwm_htim = NULL;
+static GPIO_TypeDef *pwm_port = NULL;
+static uint16_t pwm_pin = 0;
+static const uint16_t *pwm_buf = NULL;
+static uint16_t pwm_len = 0;
+static uint8_t pwm_running = 0;
+
+void mock_tim_set_output(TIM_HandleTypeDef *htim, GPIO_TypeDef *port, uint16_t pin)
+{
+   pwm_htim = htim;
+   pwm_port = port;
+   pwm_pin = pin;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start_DMA(TIM_HandleTypeDef *htim, uint32_t channel, const uint32_t *data, uint16_t len)
+{
+   (void)channel;
+   if (pwm_running) return HAL_BUSY;
+   pwm_htim = htim;
+   pwm_buf = (const uint16_t *)data;   /* half-word DMA */
+   pwm_len = len;
+   pwm_running = 1;
+   return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop_DMA(TIM_HandleTypeDef *htim, uint32_t channel)
+{
+   (void)htim;
+   (void)channel;
+   pwm_running = 0;
+   return HAL_OK;
+}
+
+/* One PWM period per DMA entry: high for CCR ticks, then low until ARR
+   wraps. Timer ticks are converted to core cycles (timer clock = 2x PCLK1). */
+static void pwm_play(uint16_t from, uint16_t to)
+{
+   uint32_t tim_clk = HAL_RCC_GetPCLK1Freq() * 2U;
+   uint32_t period = (pwm_htim->Instance->ARR + 1U) * (pwm_htim->Instance->PSC + 1U);
+   for (uint16_t i = from; i < to; ++i) {
+       uint64_t start = now;
+       uint32_t high = pwm_buf[i] * (pwm_htim->Instance->PSC + 1U);
+       if (high && pwm_port) {
+           gpio_set_odr(pwm_port, pwm_port->ODR | pwm_pin);
+           now = start + (uint64_t)high * SystemCoreClock / tim_clk;
+           gpio_set_odr(pwm_port, pwm_port->ODR & ~(uint32_t)pwm_pin);
+       }
+       now = start + (uint64_t)period * SystemCoreClock / tim_clk;
+   }
+}
+
+void mock_tim_run(void)
+{
+   while (pwm_running) {
+       pwm_play(0, pwm_len / 2);
+       HAL_TIM_PWM_PulseFinishedHalfCpltCallback(pwm_htim);
+       if (!pwm_running) break;
+       pwm_play(pwm_len / 2, pwm_len);
+       HAL_TIM_PWM_PulseFinishedCallback(pwm_htim);
+   }
+}
+
+/* ---------- Weak callbacks, overridden by the drivers as with the HAL ---------- */
+__attribute__((weak)) void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+   (void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+   (void)hi2c;
+}
+
+__attribute__((weak)) void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t pos)
+{
+   (void)huart;
+   (void)pos;
+}
+
+__attribute__((weak)) void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+   (void)huart;
+}
+
+__attribute__((weak)) void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim)
+{
+   (void)htim;
+}
+
+__attribute__((weak)) void HAL_TIM_PWM_PulseFinishedHalfCpltCallback(TIM_HandleTypeDef *htim)
+{
+   (void)htim;
+}
@@ -0,0 +1,216 @@
+#ifndef MOCK_STM32F4XX_HAL_H
+#define MOCK_STM32F4XX_HAL_H
+#include <stdint.h>
+#include <stddef.h>
+/*
+* host/stm32f4xx_hal.h - just enough of the STM32F4 HAL and CMSIS to build
+* the driver layer (i2c.c, delay.c, ws2812b*.c, answer.c, qbank.c, probe.c,
+* flog.c, uart_rx.c, proto.c) on a PC, with every I2C byte, GPIO edge and
+* delay recorded.
+*
+* Time is simulated in core cycles (mock_cycles()). It moves when code
+* waits, never while it computes:
+*   - every DWT access (DWT->CYCCNT polls in delay_us() and the bit-bang
+*     LED loop) and every HAL_GetTick() call costs MOCK_DWT_POLL_CYCLES
+*   - HAL_Delay() and blocking I2C transfers advance it by their duration
+*   - DMA/IT transfers occupy the bus model (mock_i2c_busy_until()) but
+*     complete at the next interrupt-enable point, so a queue never stalls
+*     the host. mock_run_until_idle() moves the clock to the end of the
+*     queued bus traffic.
+* GPIO edges are taken from ODR changes (WritePin/TogglePin) and from BSRR
+* stores, which are applied on the next DWT access like a pin that changes
+* shortly after the store.
+*/
+#ifndef MOCK_DWT_POLL_CYCLES
+#define MOCK_DWT_POLL_CYCLES 4   /* one CYCCNT read + compare + branch */
+#endif
+
+typedef enum { HAL_OK = 0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+#define __IO volatile
+
+extern uint32_t SystemCoreClock;
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t ms);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+
+/* ---------- Core: interrupts, DWT ---------- */
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+static inline void __NOP(void) { }
+
+typedef struct { volatile uint32_t CTRL, CYCCNT; } DWT_Type;
+typedef struct { volatile uint32_t DEMCR; } CoreDebug_Type;
+DWT_Type *mock_dwt_access(void);
+extern CoreDebug_Type mock_core_debug;
+#define DWT        (mock_dwt_access())
+#define CoreDebug  (&mock_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk     (1U << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1U << 24)
+
+/* ---------- GPIO ---------- */
+typedef struct {
+   volatile uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2];
+} GPIO_TypeDef;
+extern GPIO_TypeDef mock_gpio[8];
+#define GPIOA (&mock_gpio[0])
+#define GPIOB (&mock_gpio[1])
+#define GPIOC (&mock_gpio[2])
+#define GPIOF (&mock_gpio[5])
+#define GPIO_PIN_0  0x0001U
+#define GPIO_PIN_1  0x0002U
+#define GPIO_PIN_4  0x0010U
+#define GPIO_PIN_8  0x0100U
+#define GPIO_PIN_9  0x0200U
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+typedef struct { uint32_t Pin, Mode, Pull, Speed, Alternate; } GPIO_InitTypeDef;
+#define GPIO_MODE_OUTPUT_PP   0x01U
+#define GPIO_MODE_OUTPUT_OD   0x11U
+#define GPIO_NOPULL           0x00U
+#define GPIO_SPEED_FREQ_LOW   0x00U
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *port, uint16_t pin);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin);
+
+/* ---------- I2C ---------- */
+typedef struct { uint32_t ClockSpeed, DutyCycle, OwnAddress1, AddressingMode; } I2C_InitTypeDef;
+typedef struct { volatile uint32_t CR1, SR1; } I2C_TypeDef;
+typedef struct __I2C_HandleTypeDef {
+   I2C_TypeDef *Instance;
+   I2C_InitTypeDef Init;
+   volatile uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+extern I2C_TypeDef mock_i2c1, mock_i2c2;
+#define I2C1 (&mock_i2c1)
+#define I2C2 (&mock_i2c2)
+#define I2C_DUTYCYCLE_2 0x0U
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t addr, uint32_t trials, uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t addr, uint8_t *data, uint16_t len, uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t addr, uint8_t *data, uint16_t len, uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c, uint16_t addr, uint8_t *data, uint16_t len);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t addr, uint8_t *data, uint16_t len);
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+/* ---------- TIM (PWM + DMA for the WS2812B timer backend) ---------- */
+typedef struct { volatile uint32_t CR1, EGR, CNT, PSC, ARR, CCR1, CCR2, CCR3, CCR4; } TIM_TypeDef;
+typedef struct { uint32_t Prescaler, CounterMode, Period; } TIM_Base_InitTypeDef;
+typedef struct { TIM_TypeDef *Instance; TIM_Base_InitTypeDef Init; } TIM_HandleTypeDef;
+#define TIM_CHANNEL_1 0x0U
+#define TIM_CHANNEL_2 0x4U
+#define TIM_CHANNEL_3 0x8U
+#define TIM_CHANNEL_4 0xCU
+#define TIM_EGR_UG    1U
+#define MOCK_TIM_CCR(h, ch) (&(&(h)->Instance->CCR1)[(ch) >> 2])
+#define __HAL_TIM_SET_COMPARE(h, ch, v)  (*MOCK_TIM_CCR(h, ch) = (v))
+#define __HAL_TIM_SET_AUTORELOAD(h, v)   do { (h)->Instance->ARR = (v); (h)->Init.Period = (v); } while (0)
+#define __HAL_TIM_SET_PRESCALER(h, v)    ((h)->Instance->PSC = (v))
+HAL_StatusTypeDef HAL_TIM_PWM_Start_DMA(TIM_HandleTypeDef *htim, uint32_t channel, const uint32_t *data, uint16_t len);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop_DMA(TIM_HandleTypeDef *htim, uint32_t channel);
+void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim);
+void HAL_TIM_PWM_PulseFinishedHalfCpltCallback(TIM_HandleTypeDef *htim);
+
+/* ---------- UART (receive-to-idle on circular DMA, for uart_rx.c) ---------- */
+typedef struct { uint32_t BaudRate; } UART_InitTypeDef;
+typedef struct __UART_HandleTypeDef {
+   UART_InitTypeDef Init;
+   uint8_t *rx_buf;       /* mock: the DMA ring and its write index */
+   uint16_t rx_size;
+   uint16_t rx_pos;
+} UART_HandleTypeDef;
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *buf, uint16_t size);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t pos);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+/* ---------- FLASH (sector erase + word program, for flog.c) ---------- */
+typedef struct { uint32_t TypeErase, Banks, Sector, NbSectors, VoltageRange; } FLASH_EraseInitTypeDef;
+#define FLASH_TYPEERASE_SECTORS 0x0U
+#define FLASH_VOLTAGE_RANGE_3   0x2U
+#define FLASH_TYPEPROGRAM_WORD  0x2U
+#define FLASH_SECTOR_10         10U
+#define FLASH_SECTOR_11         11U
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *init, uint32_t *sector_error);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t type, uint32_t addr, uint64_t data);
+
+/* ---------- Recording / control (host only) ---------- */
+uint64_t mock_cycles(void);
+void mock_advance(uint64_t cycles);
+/* Called with every I2C write as it goes on the bus (7-bit address) */
+typedef void (*mock_i2c_tap_fn_t)(uint8_t addr7, const uint8_t *data, uint16_t len);
+void mock_i2c_set_tap(mock_i2c_tap_fn_t tap);
+typedef struct {
+   uint32_t xfers;        /* write transactions */
+   uint32_t bytes;        /* data bytes, address bytes not included */
+   uint64_t bus_cycles;   /* time the bus was busy */
+} mock_i2c_stats_t;
+void mock_i2c_stats(mock_i2c_stats_t *out);
+void mock_i2c_reset_stats(void);
+uint64_t mock_i2c_busy_until(void);
+/* Faults: transfers on a bus clocked above max_hz (0 = any speed) NACK,
+   and the next n transfers on any bus NACK. Reads of an expander return
+   the last byte written to it, as a PCF8574 with nothing pulling its pins. */
+void mock_i2c_set_max_hz(I2C_HandleTypeDef *hi2c, uint32_t max_hz);
+void mock_i2c_fail_next(uint32_t n);
+/* HAL_I2C_Init() calls so far */
+uint32_t mock_i2c_inits(void);
+/* Deliver pending completions and move the clock past queued bus traffic */
+void mock_run_until_idle(void);
+/* 1: a transfer completes only once the clock has reached its end on the
+   bus (at the next HAL_GetTick() or __enable_irq() after that), so queues
+   fill up as on the hardware. 0 (default): at the next __enable_irq(). */
+void mock_i2c_set_timed(uint8_t on);
+
+/* GPIO edge log */
+typedef struct {
+   uint64_t at;           /* mock_cycles() */
+   uint8_t port;          /* index into mock_gpio */
+   uint16_t pin;
+   uint8_t level;
+} mock_edge_t;
+const mock_edge_t *mock_edges(uint32_t *count);
+void mock_edges_clear(void);
+/* Pin a timer's PWM output appears on, so mock_tim_run() logs its edges */
+void mock_tim_set_output(TIM_HandleTypeDef *htim, GPIO_TypeDef *port, uint16_t pin);
+/* Play a running PWM DMA (half/complete callbacks included) until it stops */
+void mock_tim_run(void);
+/* Bytes arriving on a UART at Init.BaudRate (10 bits each, the clock
+   moves with them): stored in the DMA ring with the half, full and (at
+   the end) IDLE events a circular receive-to-idle raises */
+void mock_uart_receive(UART_HandleTypeDef *huart, const uint8_t *data, uint32_t len);
+/* Flash sectors 10 and 11 (0x080C0000, 2 x 128 KB), blank at start. Erase
+   sets a sector to 0xFF and takes MOCK_FLASH_ERASE_MS, a word program can
+   only clear bits and takes MOCK_FLASH_WORD_US. Memory-mapped reads go
+   through mock_flash_ptr() (flog.c's FLOG_PTR) and are counted. */
+#ifndef MOCK_FLASH_ERASE_MS
+#define MOCK_FLASH_ERASE_MS 1000
+#endif
+#ifndef MOCK_FLASH_WORD_US
+#define MOCK_FLASH_WORD_US 16
+#endif
+const uint8_t *mock_flash_ptr(uint32_t addr);
+typedef struct {
+   uint32_t reads;        /* mock_flash_ptr() calls */
+   uint32_t erases;
+   uint32_t words;        /* words programmed */
+   uint32_t bursts;       /* HAL_FLASH_Unlock() calls */
+} mock_flash_stats_t;
+void mock_flash_stats(mock_flash_stats_t *out);
+void mock_flash_reset_stats(void);
+/* Power cut: the next n words program, the one after only half (a torn
+   record), then everything fails. MOCK_FLASH_NO_CUT powers back on. */
+#define MOCK_FLASH_NO_CUT 0xFFFFFFFFUL
+void mock_flash_cut_after(uint32_t words);
+/* Program error: the next n words program, the one after returns
+   HAL_ERROR and leaves the flash as it was, then they work again */
+void mock_flash_fail_after(uint32_t words);
+/* Longest stretch with interrupts masked, in cycles */
+uint64_t mock_irq_off_max(void);
+void mock_irq_off_reset(void);
+#endif /* MOCK_STM32F4XX_HAL_H */
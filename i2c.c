@@ -7,12 +7,48 @@
 * - Added configurable nibble shift (PCF_NIBBLE_SHIFT) to fix bit-alignment issues
 *   (if characters are missing their rightmost column try setting to 3 or 5).
 * - Robust lcd_put_cur(): supports common 16x2 and 20x4 DDRAM mappings automatically
-*   based on LCD_COLS/LCD_ROWS definitions (defaults to 16x2).
+*   based on each display's geometry.
 * - Added utility functions:
 *     - lcd_ascii_test(): writes predictable ASCII patterns to help diagnose bit mapping.
 *     - lcd_show_wrapped(): helper to display long strings across lines for common sizes.
-*     - lcd_scroll_line(): simple left-scrolling helper for long strings on one row.
+*     - lcd_scroll_line(): left-scrolling marquee for long strings on one row.
 * - Minor timing tweak and clarified comments.
+* - Microsecond timing: HD44780 waits come from the lcd_exec_us[] table and
+*   use delay_us() (DWT cycle counter) instead of HAL_Delay(1..2).
+* - Optional busy-flag polling (LCD_USE_BUSY_FLAG=1) for long commands,
+*   reading BF/AC through the PCF8574 with RW high.
+* - Non-blocking mode (LCD_ASYNC=1, default): transactions are queued and
+*   drained by DMA/IT completion callbacks; use lcd_wait_idle() to block.
+* - Batched expander writes: nibble/EN edges are queued and sent as one
+*   multi-byte I2C transaction instead of one HAL call per byte.
+* - Shadow framebuffer: draw with lcd_fb_*() and call lcd_flush(); only the
+*   cells that differ from what the LCD already shows are sent, one cursor
+*   command per run of consecutive changed cells. No 0x01 clear needed.
+* - Hardware scrolling: lcd_scroll_line() writes the text into the row's
+*   40-character DDRAM line once, then lcd_flush() moves it with the display
+*   shift instruction (0x18), one command per step, from the scheduler.
+* - CGRAM glyph cache: lcd_glyph_register() custom characters, draw them
+*   with LCD_GLYPH(id) in the framebuffer; lcd_flush() maps the glyphs on
+*   screen into the 8 CGRAM slots (LRU) and uploads only changed bitmaps.
+* - Several displays: every lcd_init() returns an lcd_t handle with its own
+*   address, geometry, framebuffer, CGRAM slots and transfer queue. Displays
+*   on the same I2C bus take turns one transaction at a time (round robin),
+*   so a big flush on one never holds the others back.
+* - Completion stamps: lcd_done_stamp() tells when a display's queue last
+*   drained (taken in the completion ISR), e.g. to time user responses from
+*   the moment a screen is really visible.
+* - Bus counters: lcd_xfers()/lcd_bytes() count the I2C transactions and
+*   bytes each display has put on the bus (printed by !stats).
+* - Fast mode with fallback: the bring-up's probe step runs the bus at
+*   400 kHz if the expander passes a write/read-back probe there, else
+*   steps down (with a bus recovery each step). At run
+*   time too many failed or stuck transactions make lcd_flush() recover the
+*   bus (9 SCL clocks + STOP, peripheral re-init, one speed step down) and
+*   re-initialize the displays on it. No transfer waits forever any more.
+* - Timed bring-up: lcd_init_start() only claims the handle; the power-up
+*   wait (counted from reset, the LCD is powered with the MCU) and the init
+*   sequence are stepped by lcd_init_poll(), which lcd_flush() calls, so
+*   the rest of the firmware sets up meanwhile. lcd_init() still blocks.
 *
 * USAGE:
 * - If text still appears clipped (rightmost column missing), try changing the
@@ -21,22 +57,29 @@
 * NOTE:
 * - This file expects i2c.h to define:
 *     P_CF_RS, P_CF_RW, P_CF_EN, P_CF_BL
-*     LCD_COLS, LCD_ROWS
-*   Keep those in i2c.h. If LCD_COLS/ROWS are missing, 16x2 is assumed.
+*     LCD_MAX_COLS, LCD_MAX_ROWS
+*   Keep those in i2c.h. If they are missing, 20x4 is the largest size.
 */
 
 #include "i2c.h"
+#include "delay.h"
+#include "probe.h"
 #include "stm32f4xx_hal.h"
 #include <stdint.h>
 #include <string.h>
 
 /* ---------- Configuration ---------- */
-/* Default LCD size if not provided in i2c.h */
-#ifndef LCD_COLS
-#define LCD_COLS 16
+/* Largest display geometry (sizes every framebuffer) if not provided in i2c.h */
+#ifndef LCD_MAX_COLS
+#define LCD_MAX_COLS 20
 #endif
-#ifndef LCD_ROWS
-#define LCD_ROWS 2
+#ifndef LCD_MAX_ROWS
+#define LCD_MAX_ROWS 4
+#endif
+
+/* Number of displays lcd_init() can hand out */
+#ifndef LCD_MAX_DEVICES
+#define LCD_MAX_DEVICES 2
 #endif
 
 /* Nibble -> PCF8574 shift.
@@ -47,149 +90,1170 @@
 #define PCF_NIBBLE_SHIFT 4
 #endif
 
+/* Busy-flag mode.
+   1: long waits (clear/home) poll the HD44780 busy flag through the PCF8574
+      (RW high, data pins released) and continue as soon as it clears.
+   0: purely timed waits from lcd_exec_us[] (default). Keep this on
+      backpacks that tie RW to GND: there the read EN pulses would latch the
+      released data pins as an instruction.
+   Ordinary commands are not polled: one read costs ~5 bus bytes, longer
+   than the 37 us it would save.
+*/
+#ifndef LCD_USE_BUSY_FLAG
+#define LCD_USE_BUSY_FLAG 0
+#endif
+
+/* Non-blocking mode.
+   1: expander transactions are queued in LCD_QUEUE_SLOTS buffers per display
+      and drained by HAL_I2C_Master_Transmit_DMA (or _IT with
+      LCD_ASYNC_USE_DMA 0) from the I2C completion interrupt, and long waits
+      are covered by padding bytes on the bus. lcd_flush() does not wait for
+      earlier traffic: while a transaction is still queued it only marks the
+      diff pending (fb_want keeps it) and sends it on a later call, and a
+      diff of up to LCD_QUEUE_SLOTS - 1 transactions (a full 16x2 screen is
+      one) is then queued without waiting. The direct calls
+      (lcd_send_string(), lcd_clear() etc.) return once queued, but when all
+      LCD_QUEUE_SLOTS are taken they wait for the completion interrupt to
+      free one (a transaction, at most PCF_BATCH_MAX bytes of bus time).
+      Needs the I2C1 event/error IRQs (and the I2C1_TX DMA stream when
+      using DMA) enabled in CubeMX.
+   0: blocking HAL_I2C_Master_Transmit as before.
+*/
+#ifndef LCD_ASYNC
+#define LCD_ASYNC 1
+#endif
+#ifndef LCD_ASYNC_USE_DMA
+#define LCD_ASYNC_USE_DMA 1
+#endif
+#ifndef LCD_QUEUE_SLOTS
+#define LCD_QUEUE_SLOTS 4
+#endif
+#if LCD_ASYNC && LCD_USE_BUSY_FLAG
+#error "LCD_USE_BUSY_FLAG needs blocking reads; set LCD_ASYNC 0"
+#endif
+
+/* Bus speed and error recovery.
+   The bus starts at the first entry of lcd_i2c_speeds[] that the expander
+   handles (LCD_I2C_FAST 1) or at the CubeMX ClockSpeed (LCD_I2C_FAST 0),
+   and only ever steps down from there. The PCF8574 is specified for
+   100 kHz, but most backpacks run fine at 400 kHz; the probe decides.
+   LCD_I2C_ERR_LIMIT failures within LCD_I2C_ERR_WINDOW_MS trigger a
+   recovery. A transaction still unfinished after LCD_I2C_STUCK_MS (SCL
+   held low, lost interrupt) counts as failed. Blocking transfers time out
+   after their own bus time plus LCD_I2C_TIMEOUT_MS.
+   Bus recovery clocks SCL by hand on LCD_I2C_SCL/SDA (I2C1 on PB8/PB9 by
+   default); a display on another I2C peripheral only gets the re-init. */
+#ifndef LCD_I2C_FAST
+#define LCD_I2C_FAST 1
+#endif
+#ifndef LCD_I2C_ERR_LIMIT
+#define LCD_I2C_ERR_LIMIT 4
+#endif
+#ifndef LCD_I2C_ERR_WINDOW_MS
+#define LCD_I2C_ERR_WINDOW_MS 1000
+#endif
+#ifndef LCD_I2C_STUCK_MS
+#define LCD_I2C_STUCK_MS 50
+#endif
+#ifndef LCD_I2C_TIMEOUT_MS
+#define LCD_I2C_TIMEOUT_MS 10
+#endif
+#ifndef LCD_I2C_RECOVER_BUS
+#define LCD_I2C_RECOVER_BUS I2C1
+#define LCD_I2C_SCL_PORT    GPIOB
+#define LCD_I2C_SCL_PIN     GPIO_PIN_8
+#define LCD_I2C_SDA_PORT    GPIOB
+#define LCD_I2C_SDA_PIN     GPIO_PIN_9
+#endif
+static const uint32_t lcd_i2c_speeds[] = { 400000, 100000, 50000 };
+#define LCD_I2C_NUM_SPEEDS ((uint8_t)(sizeof(lcd_i2c_speeds) / sizeof(lcd_i2c_speeds[0])))
+
+/* CGRAM glyph cache. The glyph table is shared by all displays; which glyph
+   sits in which CGRAM slot is tracked per display. fb_want holds glyph
+   references (LCD_GLYPH(id)), fb_shown holds what DDRAM really has (slot
+   codes 0..7), so the diff in lcd_flush() compares after mapping. Bitmaps
+   are referenced, not copied: changing one in place is picked up (and
+   re-uploaded) by the next flush. */
+#ifndef LCD_GLYPH_MAX
+#define LCD_GLYPH_MAX 32
+#endif
+#define LCD_CGRAM_SLOTS 8
+#define LCD_NO_SLOT 0xFF
+static const uint8_t *glyph_bits[LCD_GLYPH_MAX];
+static char glyph_fallback[LCD_GLYPH_MAX];   /* shown if no slot is left */
+static uint8_t glyph_count = 0;
+static uint32_t glyph_clock = 0;
+static uint32_t glyph_uploads = 0;
+
+/* ---------- HD44780 timing ---------- */
+/* Execution times from the HD44780 datasheet (fosc = 270 kHz) with ~10%
+   margin for slow clones. Indexed by lcd_op_t. */
+typedef enum {
+   LCD_OP_CMD = 0,     /* ordinary instruction: 37 us */
+   LCD_OP_DATA,        /* DDRAM/CGRAM write: 37 us + tADD 4 us */
+   LCD_OP_CLEAR,       /* 0x01 clear / 0x02 return home: 1.52 ms */
+   LCD_OP_POWERUP,     /* Vcc rise to first command: > 40 ms */
+   LCD_OP_INIT1,       /* after first 0x03 nibble: > 4.1 ms */
+   LCD_OP_INIT2,       /* after second 0x03 nibble: > 100 us */
+   LCD_OP_COUNT
+} lcd_op_t;
+
+static const uint16_t lcd_exec_us[LCD_OP_COUNT] = {
+   [LCD_OP_CMD]     = 41,
+   [LCD_OP_DATA]    = 46,
+   [LCD_OP_CLEAR]   = 1680,
+   [LCD_OP_POWERUP] = 45000,
+   [LCD_OP_INIT1]   = 4500,
+   [LCD_OP_INIT2]   = 150,
+};
+
+/* Longest wait (in expander bytes) we cover by padding the I2C stream
+   instead of flushing and busy-waiting */
+#ifndef PCF_PAD_MAX
+#define PCF_PAD_MAX 4
+#endif
+
+/* Expander writes are not sent one HAL call at a time. They are queued into
+   the display's batch and pushed out as a single I2C transaction by
+   pcf_flush(); the PCF8574 latches every byte of the stream in turn, so one
+   START + address covers a whole string or framebuffer flush.
+
+   Within a batch the bus itself provides the HD44780 timing: one byte takes
+   9 SCL periods (byte_us, 90 us at 100 kHz). The next instruction only
+   latches two bytes later (EN high, EN low), so lcd_wait() has nothing to
+   do at 100 kHz for ordinary commands and data. On a faster bus it pads the
+   stream with repeats of the last byte (harmless re-latches), and for long
+   waits (clear/home, init) it flushes and calls delay_us(). A transaction
+   for another display slotting in between only makes a wait longer.
+*/
+#ifndef PCF_BATCH_MAX
+#define PCF_BATCH_MAX 160   /* bytes; a full 16x2 flush fits in one transaction */
+#endif
+
+#if LCD_ASYNC
+/* Transfer slots. The caller fills q[wr]; pcf_flush() publishes it and the
+   completion interrupt drains q[rd .. wr-1], one transaction per slot. A
+   slot is never touched by the producer while it is queued or in flight,
+   so DMA reads stable memory. */
+typedef struct {
+   uint8_t data[PCF_BATCH_MAX];
+   uint16_t len;
+} pcf_slot_t;
+#endif
+
+/* Shadow framebuffer.
+   fb_want  = what the application wants on screen (written by lcd_fb_*)
+   fb_shown = what we believe DDRAM currently holds (updated on every data write)
+   cur_row/cur_col track the DDRAM cursor so lcd_flush() can skip redundant
+   cursor commands. LCD_CUR_UNKNOWN means we lost track (e.g. wrote past the
+   end of a row), in which case fb_valid is cleared and the next flush
+   rewrites every cell.
+*/
+#define LCD_CUR_UNKNOWN 0xFF
+
+/* Hardware scroll (display shift). The HD44780 shifts every line at once,
+   so while a scroll runs lcd_flush() only steps it and leaves the
+   framebuffer alone until lcd_scroll_stop(). */
+#define LCD_DDRAM_LINE 40          /* DDRAM bytes per line in 2-line mode */
+
+/* Bring-up states (lcd_init_poll) */
+#define LCD_ST_POWERUP 0           /* waiting for LCD_OP_POWERUP after reset */
+#define LCD_ST_SEQ     1           /* bus probed, init sequence running */
+#define LCD_ST_READY   2
+
 /* ---------- Local state ---------- */
-static I2C_HandleTypeDef *hi2c_lcd = NULL;
-static uint8_t lcd_addr = 0x27; /* default; overridden by lcd_init */
-static uint8_t backlight = P_CF_BL;
+/* One per I2C peripheral, shared by the displays on it */
+typedef struct {
+   I2C_HandleTypeDef *hi2c;
+   uint8_t speed;                 /* index into lcd_i2c_speeds */
+   uint32_t window_at;            /* HAL_GetTick() at the start of the error window */
+   uint32_t window_errs;          /* bus_errors() then */
+   uint32_t recoveries;
+   uint8_t fast_pending;          /* LCD_I2C_FAST: not yet switched to speed 0 */
+   volatile uint32_t kick_at;     /* HAL_GetTick() when the current transfer started */
+} lcd_bus_t;
+
+struct lcd_s {
+   I2C_HandleTypeDef *hi2c;
+   lcd_bus_t *bus;
+   uint8_t addr;                  /* 7-bit */
+   uint8_t backlight;
+   uint8_t cols, rows;
+
+   char fb_want[LCD_MAX_ROWS][LCD_MAX_COLS];
+   char fb_shown[LCD_MAX_ROWS][LCD_MAX_COLS];
+   uint8_t fb_valid;
+   uint8_t cur_row, cur_col;
+
+   uint8_t scroll_on;
+   uint16_t scroll_step_ms;
+   uint32_t scroll_next;
+
+   uint8_t glyph_slot[LCD_GLYPH_MAX];    /* CGRAM slot or LCD_NO_SLOT */
+   uint8_t slot_glyph[LCD_CGRAM_SLOTS];  /* glyph id or LCD_NO_SLOT */
+   uint8_t slot_bits[LCD_CGRAM_SLOTS][8];/* CGRAM contents (0xFF = unknown) */
+   uint32_t slot_used[LCD_CGRAM_SLOTS];  /* LRU stamp */
+
+   uint8_t pcf_last;              /* last byte queued, to skip redundant setup bytes */
+   uint16_t byte_us;              /* one byte on the bus; from ClockSpeed */
+   uint8_t ready_for_poll;        /* 4-bit mode reached: busy flag readable */
+   uint8_t init_state;            /* LCD_ST_* */
+   uint8_t init_step;             /* next entry of the init sequence */
+   uint32_t init_due;             /* delay_cycles_now() when it may be sent */
+   volatile uint32_t done_at;     /* lcd_now() when the queue last drained */
+   volatile uint32_t xfers;       /* transactions started */
+   volatile uint32_t bytes;       /* bytes in those transactions */
+   volatile uint8_t lost;         /* a transfer failed; DDRAM no longer matches fb_shown */
+   uint8_t flush_pending;         /* lcd_flush() found the queue busy and left the diff */
+   volatile uint32_t errors;
+#if LCD_ASYNC
+   pcf_slot_t q[LCD_QUEUE_SLOTS];
+   volatile uint8_t rd, wr;
+   volatile uint8_t busy;         /* this display's transaction is on the bus */
+#else
+   uint8_t batch[PCF_BATCH_MAX];
+   uint16_t len;
+#endif
+};
+
+static lcd_t lcd_pool[LCD_MAX_DEVICES];
+static uint8_t lcd_count = 0;
+static lcd_bus_t lcd_buses[LCD_MAX_DEVICES];
+static uint8_t bus_count = 0;
+static lcd_clock_fn_t lcd_clock = NULL;
+
+static uint32_t lcd_now(void)
+{
+   return lcd_clock ? lcd_clock() : HAL_GetTick();
+}
 
 /* ---------- Low level I2C write ---------- */
-static HAL_StatusTypeDef pcf_write(uint8_t data)
+#if LCD_ASYNC
+static uint8_t bus_rr = 0;   /* display that had the bus last */
+static void bus_watchdog(lcd_bus_t *b);
+
+/* Start the next queued slot on this bus if it is free. Displays take turns
+   starting after the one served last, so each gets one transaction in
+   between the others' and a long flush cannot starve a short one.
+   Called from the completion/error ISR or with interrupts masked. */
+static void bus_kick(I2C_HandleTypeDef *hi2c)
+{
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       if (lcd_pool[i].hi2c == hi2c && lcd_pool[i].busy) return;
+   }
+   for (uint8_t k = 1; k <= lcd_count; ++k) {
+       uint8_t i = (uint8_t)((bus_rr + k) % lcd_count);
+       lcd_t *d = &lcd_pool[i];
+       if (d->hi2c != hi2c) continue;
+       while (d->rd != d->wr) {
+           pcf_slot_t *q = &d->q[d->rd];
+           HAL_StatusTypeDef st;
+           d->busy = 1;
+#if LCD_ASYNC_USE_DMA
+           st = HAL_I2C_Master_Transmit_DMA(hi2c, (uint16_t)(d->addr << 1), q->data, q->len);
+#else
+           st = HAL_I2C_Master_Transmit_IT(hi2c, (uint16_t)(d->addr << 1), q->data, q->len);
+#endif
+           if (st == HAL_OK) {
+               d->xfers++;
+               d->bytes += q->len;
+               d->bus->kick_at = HAL_GetTick();
+               bus_rr = i;
+               return;
+           }
+           /* could not start: drop the slot and resync on the next flush */
+           d->busy = 0;
+           d->errors++;
+           d->lost = 1;
+           d->rd = (uint8_t)((d->rd + 1) % LCD_QUEUE_SLOTS);
+       }
+   }
+}
+
+static HAL_StatusTypeDef pcf_flush(lcd_t *d)
+{
+   if (d->q[d->wr].len == 0) return HAL_OK;
+
+   PROBE_BEGIN(PROBE_PCF_FLUSH);
+   uint8_t next = (uint8_t)((d->wr + 1) % LCD_QUEUE_SLOTS);
+   /* all slots queued: wait for the ISR to free one. lcd_flush() starts on
+      an empty queue, so only a diff of more than LCD_QUEUE_SLOTS - 1
+      transactions gets here; direct calls can. */
+   while (next == d->rd) bus_watchdog(d->bus);
+   d->q[next].len = 0;
+
+   uint32_t primask = __get_PRIMASK();
+   __disable_irq();
+   d->wr = next;
+   bus_kick(d->hi2c);
+   if (!primask) __enable_irq();
+   PROBE_END(PROBE_PCF_FLUSH);
+   return HAL_OK;
+}
+
+static void pcf_queue(lcd_t *d, uint8_t data)
+{
+   if (d->q[d->wr].len >= PCF_BATCH_MAX) pcf_flush(d);
+   pcf_slot_t *q = &d->q[d->wr];
+   q->data[q->len++] = data;
+   d->pcf_last = data;
+}
+
+static void pcf_xfer_done(I2C_HandleTypeDef *hi2c, uint8_t failed)
+{
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       lcd_t *d = &lcd_pool[i];
+       if (d->hi2c != hi2c || !d->busy) continue;
+       if (failed) {
+           d->errors++;
+           d->lost = 1;
+       }
+       d->rd = (uint8_t)((d->rd + 1) % LCD_QUEUE_SLOTS);
+       d->busy = 0;
+       if (d->rd == d->wr) d->done_at = lcd_now();
+       bus_kick(hi2c);
+       return;
+   }
+}
+
+/* HAL weak callbacks. If other I2C devices share the project, call
+   pcf_xfer_done()'s logic from your own callbacks instead. */
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+   pcf_xfer_done(hi2c, 0);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+   pcf_xfer_done(hi2c, 1);
+}
+
+/* Fail a transfer that has been on the bus for too long, so queues drain
+   and the next lcd_flush() can recover the bus. Thread context. */
+static void bus_watchdog(lcd_bus_t *b)
+{
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       if (lcd_pool[i].bus != b || !lcd_pool[i].busy) continue;
+       if (HAL_GetTick() - b->kick_at < LCD_I2C_STUCK_MS) return;
+       uint32_t primask = __get_PRIMASK();
+       __disable_irq();
+       if (lcd_pool[i].busy) pcf_xfer_done(b->hi2c, 1);
+       if (!primask) __enable_irq();
+       return;
+   }
+}
+#else
+static HAL_StatusTypeDef pcf_flush(lcd_t *d)
+{
+   HAL_StatusTypeDef st = HAL_OK;
+   if (d->len) {
+       PROBE_BEGIN(PROBE_PCF_FLUSH);
+       uint32_t timeout = (uint32_t)d->len * d->byte_us / 1000U + LCD_I2C_TIMEOUT_MS;
+       st = HAL_I2C_Master_Transmit(d->hi2c, (uint16_t)(d->addr << 1), d->batch, d->len, timeout);
+       if (st == HAL_OK) {
+           d->xfers++;
+           d->bytes += d->len;
+       } else {
+           d->errors++;
+           d->lost = 1;
+       }
+       d->len = 0;
+       d->done_at = lcd_now();
+       PROBE_END(PROBE_PCF_FLUSH);
+   }
+   return st;
+}
+
+static void pcf_queue(lcd_t *d, uint8_t data)
+{
+   if (d->len >= PCF_BATCH_MAX) pcf_flush(d);
+   d->batch[d->len++] = data;
+   d->pcf_last = data;
+}
+
+#endif
+
+#if LCD_USE_BUSY_FLAG
+/* Read busy flag (bit 7) and address counter (bits 6..0).
+   PCF8574 pins are quasi-bidirectional: writing 1 releases them to a weak
+   pull-up so the HD44780 can drive D4..D7 while RW is high. */
+static uint8_t lcd_read_status(lcd_t *d)
+{
+   const uint8_t dmask = (uint8_t)(0x0F << PCF_NIBBLE_SHIFT);
+   uint8_t out = (uint8_t)(dmask | P_CF_RW | d->backlight);
+   uint8_t hi = 0, lo = 0;
+
+   pcf_queue(d, out);           /* RW high, EN low: tAS before EN */
+   pcf_queue(d, out | P_CF_EN);
+   pcf_flush(d);
+   HAL_I2C_Master_Receive(d->hi2c, (uint16_t)(d->addr << 1), &hi, 1, LCD_I2C_TIMEOUT_MS);
+
+   pcf_queue(d, out);           /* second EN pulse clocks out the low nibble */
+   pcf_queue(d, out | P_CF_EN);
+   pcf_flush(d);
+   HAL_I2C_Master_Receive(d->hi2c, (uint16_t)(d->addr << 1), &lo, 1, LCD_I2C_TIMEOUT_MS);
+
+   pcf_queue(d, out);
+   pcf_flush(d);
+
+   return (uint8_t)((((hi & dmask) >> PCF_NIBBLE_SHIFT) << 4) |
+                    ((lo & dmask) >> PCF_NIBBLE_SHIFT));
+}
+
+/* Poll until the controller is ready. Gives up after timeout_us (module
+   without RW wired, or a stuck read) and treats the wait as done, which is
+   no worse than the timed mode. */
+static void lcd_wait_ready(lcd_t *d, uint32_t timeout_us)
 {
-   return HAL_I2C_Master_Transmit(hi2c_lcd, (uint16_t)(lcd_addr << 1), &data, 1, HAL_MAX_DELAY);
+   uint32_t start = delay_cycles_now();
+   uint32_t limit = delay_us_to_cycles(timeout_us);
+   while (lcd_read_status(d) & 0x80) {
+       if ((delay_cycles_now() - start) >= limit) break;
+   }
+}
+#endif
+
+/* Make sure at least us microseconds pass before the next instruction latches */
+static void lcd_wait(lcd_t *d, uint16_t us)
+{
+   uint32_t covered = 2u * d->byte_us;
+   if (us <= covered) return;
+
+   uint32_t pad = (us - covered + d->byte_us - 1) / d->byte_us;
+#if LCD_ASYNC
+   /* never block: the whole wait becomes idle bytes on the bus */
+   while (pad--) pcf_queue(d, d->pcf_last);
+#else
+   if (pad <= PCF_PAD_MAX) {
+       while (pad--) pcf_queue(d, d->pcf_last);
+       return;
+   }
+
+   pcf_flush(d);
+#if LCD_USE_BUSY_FLAG
+   if (d->ready_for_poll) {
+       lcd_wait_ready(d, 2u * us);
+       return;
+   }
+#endif
+   delay_us(us);
+#endif
 }
 
-/* Pulse EN to latch nibble */
-static void lcd_pulse_enable(uint8_t data)
+/* Single immediate write (backlight changes etc.) */
+static HAL_StatusTypeDef pcf_write(lcd_t *d, uint8_t data)
 {
-   pcf_write(data | P_CF_EN);
-   /* short enable pulse - HD44780 timing: >450ns. HAL_Delay(1) is safe and simple. */
-   HAL_Delay(1);
-   pcf_write(data & ~P_CF_EN);
-   HAL_Delay(1);
+   pcf_queue(d, data);
+   return pcf_flush(d);
 }
 
 /* Write 4-bit nibble (lower nibble of nibble param)
    Uses PCF_NIBBLE_SHIFT so you can adapt to different PCF8574 wiring.
+   Emits EN high then EN low; the HD44780 latches on the falling edge.
+   A separate setup byte (EN low) is only queued when RS/RW/BL change, so
+   RS is stable before EN rises (tAS).
 */
-static void lcd_write_nibble(uint8_t nibble, uint8_t ctrl)
+static void lcd_write_nibble(lcd_t *d, uint8_t nibble, uint8_t ctrl)
 {
    /* Mask nibble then shift into position for P4..P7 (or adjusted shift) */
    uint8_t out = (uint8_t)(((nibble & 0x0F) << PCF_NIBBLE_SHIFT) & 0xFF);
 
    /* Or in control bits (RS/RW) and backlight */
-   out |= (ctrl & (P_CF_RS | P_CF_RW)) | backlight;
+   out |= (ctrl & (P_CF_RS | P_CF_RW)) | d->backlight;
 
-   pcf_write(out);
-   lcd_pulse_enable(out);
+   const uint8_t ctl_mask = (uint8_t)(P_CF_RS | P_CF_RW | P_CF_BL);
+   if ((d->pcf_last & ctl_mask) != (out & ctl_mask) || (d->pcf_last & P_CF_EN)) {
+       pcf_queue(d, out);
+   }
+   pcf_queue(d, out | P_CF_EN);
+   pcf_queue(d, out & ~P_CF_EN);
 }
 
-/* Send full 8-bit command */
-static void lcd_send_cmd(uint8_t cmd)
+/* Send full 8-bit command (queued; caller flushes).
+   Clear (0x01) and home (0x02/0x03) get the long wait, everything else the
+   ordinary one. */
+static void lcd_send_cmd(lcd_t *d, uint8_t cmd)
 {
    uint8_t ctrl = 0;
-   lcd_write_nibble((cmd >> 4) & 0x0F, ctrl);
-   lcd_write_nibble((cmd >> 0) & 0x0F, ctrl);
-   HAL_Delay(2);
+   lcd_write_nibble(d, (cmd >> 4) & 0x0F, ctrl);
+   lcd_write_nibble(d, (cmd >> 0) & 0x0F, ctrl);
+   lcd_wait(d, lcd_exec_us[(cmd <= 0x03) ? LCD_OP_CLEAR : LCD_OP_CMD]);
 }
 
-/* Send full 8-bit data (character) */
-static void lcd_send_data(uint8_t data)
+/* Write one byte to DDRAM at the address counter, without tracking */
+static void lcd_send_raw(lcd_t *d, uint8_t data)
 {
    uint8_t ctrl = P_CF_RS;
-   lcd_write_nibble((data >> 4) & 0x0F, ctrl);
-   lcd_write_nibble((data >> 0) & 0x0F, ctrl);
-   HAL_Delay(1);
+   lcd_write_nibble(d, (data >> 4) & 0x0F, ctrl);
+   lcd_write_nibble(d, (data >> 0) & 0x0F, ctrl);
+   lcd_wait(d, lcd_exec_us[LCD_OP_DATA]);
+}
+
+/* Send full 8-bit data (character) */
+static void lcd_send_data(lcd_t *d, uint8_t data)
+{
+   lcd_send_raw(d, data);
+
+   /* Keep the shadow copy in sync with DDRAM (entry mode is increment) */
+   if (d->cur_row < d->rows && d->cur_col < d->cols) {
+       d->fb_shown[d->cur_row][d->cur_col++] = (char)data;
+   } else {
+       /* Cursor is off the visible area or unknown: DDRAM changed somewhere
+          we do not track, so force a full rewrite on the next flush. */
+       d->cur_row = LCD_CUR_UNKNOWN;
+       d->fb_valid = 0;
+   }
+}
+
+/* ---------- Bus speed and recovery ---------- */
+
+/* 1 START/ACK + 8 data bits + ACK per byte; round up */
+static void lcd_set_timing(lcd_t *d)
+{
+   uint32_t speed = d->hi2c->Init.ClockSpeed ? d->hi2c->Init.ClockSpeed : 100000;
+   d->byte_us = (uint16_t)((9UL * 1000000UL + speed - 1) / speed);
+}
+
+static uint32_t bus_errors(const lcd_bus_t *b)
+{
+   uint32_t n = 0;
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       if (lcd_pool[i].bus == b) n += lcd_pool[i].errors;
+   }
+   return n;
+}
+
+/* Free a bus a slave holds by SDA low (it was cut off mid-byte): clock SCL
+   nine times so it can finish the byte and see a NACK, then send a STOP.
+   The pins are driven as open-drain GPIO while the peripheral is off. */
+static void bus_clock_out(void)
+{
+   GPIO_InitTypeDef g = {0};
+   g.Mode = GPIO_MODE_OUTPUT_OD;
+   g.Pull = GPIO_NOPULL;
+   g.Speed = GPIO_SPEED_FREQ_LOW;
+   HAL_GPIO_WritePin(LCD_I2C_SCL_PORT, LCD_I2C_SCL_PIN, GPIO_PIN_SET);
+   HAL_GPIO_WritePin(LCD_I2C_SDA_PORT, LCD_I2C_SDA_PIN, GPIO_PIN_SET);
+   g.Pin = LCD_I2C_SCL_PIN;
+   HAL_GPIO_Init(LCD_I2C_SCL_PORT, &g);
+   g.Pin = LCD_I2C_SDA_PIN;
+   HAL_GPIO_Init(LCD_I2C_SDA_PORT, &g);
+
+   for (uint8_t i = 0; i < 9; ++i) {   /* ~50 kHz, slow enough for any slave */
+       HAL_GPIO_WritePin(LCD_I2C_SCL_PORT, LCD_I2C_SCL_PIN, GPIO_PIN_RESET);
+       delay_us(10);
+       HAL_GPIO_WritePin(LCD_I2C_SCL_PORT, LCD_I2C_SCL_PIN, GPIO_PIN_SET);
+       delay_us(10);
+   }
+   /* STOP: SDA rises while SCL is high */
+   HAL_GPIO_WritePin(LCD_I2C_SDA_PORT, LCD_I2C_SDA_PIN, GPIO_PIN_RESET);
+   delay_us(10);
+   HAL_GPIO_WritePin(LCD_I2C_SDA_PORT, LCD_I2C_SDA_PIN, GPIO_PIN_SET);
+   delay_us(10);
+}
+
+/* Take the bus down, free it (unstick: clock SCL out by hand, after a
+   failure) and bring it back at lcd_i2c_speeds[speed]. Anything still
+   queued for its displays is dropped and marked lost. Only called between
+   public calls, when no display is filling a batch. */
+static void bus_reset(lcd_bus_t *b, uint8_t speed, uint8_t unstick)
+{
+   I2C_HandleTypeDef *hi2c = b->hi2c;
+#if LCD_ASYNC
+   uint32_t primask = __get_PRIMASK();
+   __disable_irq();
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       lcd_t *d = &lcd_pool[i];
+       if (d->bus != b) continue;
+       if (d->busy || d->rd != d->wr) d->lost = 1;
+       d->busy = 0;
+       d->rd = d->wr;
+   }
+   if (!primask) __enable_irq();
+#endif
+   HAL_I2C_DeInit(hi2c);
+   if (unstick && hi2c->Instance == LCD_I2C_RECOVER_BUS) bus_clock_out();
+   b->speed = speed;
+   hi2c->Init.ClockSpeed = lcd_i2c_speeds[speed];
+   HAL_I2C_Init(hi2c);
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       if (lcd_pool[i].bus == b) lcd_set_timing(&lcd_pool[i]);
+   }
+}
+
+static lcd_bus_t *bus_get(I2C_HandleTypeDef *hi2c)
+{
+   for (uint8_t i = 0; i < bus_count; ++i) {
+       if (lcd_buses[i].hi2c == hi2c) return &lcd_buses[i];
+   }
+   lcd_bus_t *b = &lcd_buses[bus_count++];
+   memset(b, 0, sizeof(*b));
+   b->hi2c = hi2c;
+   b->speed = LCD_I2C_NUM_SPEEDS - 1;
+   for (uint8_t s = 0; s < LCD_I2C_NUM_SPEEDS; ++s) {
+       if (lcd_i2c_speeds[s] <= hi2c->Init.ClockSpeed) {
+           b->speed = s;
+           break;
+       }
+   }
+#if LCD_I2C_FAST
+   b->fast_pending = (b->speed != 0);   /* switched by the first bus_probe() */
+#endif
+   return b;
+}
+
+/* Does the expander at addr work at the current speed? It must ACK, and
+   two data patterns written with EN and RW low (ignored by the HD44780,
+   which keeps D4..D7 as inputs) must read back unchanged. */
+static int bus_probe_addr(lcd_bus_t *b, uint8_t addr)
+{
+   const uint8_t dmask = (uint8_t)(0x0F << PCF_NIBBLE_SHIFT);
+   const uint8_t pattern[2] = { (uint8_t)((0x05 << PCF_NIBBLE_SHIFT) | P_CF_BL),
+                                (uint8_t)((0x0A << PCF_NIBBLE_SHIFT) | P_CF_BL) };
+   uint16_t a = (uint16_t)(addr << 1);
+
+   if (HAL_I2C_IsDeviceReady(b->hi2c, a, 3, LCD_I2C_TIMEOUT_MS) != HAL_OK) return -1;
+   for (uint8_t i = 0; i < 2; ++i) {
+       uint8_t out = pattern[i], back = 0;
+       if (HAL_I2C_Master_Transmit(b->hi2c, a, &out, 1, LCD_I2C_TIMEOUT_MS) != HAL_OK) return -1;
+       if (HAL_I2C_Master_Receive(b->hi2c, a, &back, 1, LCD_I2C_TIMEOUT_MS) != HAL_OK) return -1;
+       if ((back & dmask) != (out & dmask)) return -1;
+   }
+   return 0;
+}
+
+/* Queue state without the bring-up (see lcd_is_idle) */
+static int lcd_queue_idle(const lcd_t *d)
+{
+#if LCD_ASYNC
+   return d->q[d->wr].len == 0 && !d->busy && d->rd == d->wr;
+#else
+   (void)d;
+   return 1;
+#endif
+}
+
+/* Send what is batched and wait until the queue has drained */
+static void lcd_drain(lcd_t *d)
+{
+#if LCD_ASYNC
+   pcf_flush(d);
+   while (!lcd_queue_idle(d)) bus_watchdog(d->bus);
+#else
+   (void)d;
+#endif
+}
+
+/* Step the bus down until the expander passes the probe (or the slowest
+   speed is reached, where lcd_errors() will tell). Drains the other
+   displays' queues first: the probe uses blocking transfers. The first
+   probe on a bus switches it up to lcd_i2c_speeds[0] (LCD_I2C_FAST); that
+   is a plain re-init, the 9-clock recovery only follows a failed probe. */
+static void bus_probe(lcd_bus_t *b, uint8_t addr)
+{
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       if (lcd_pool[i].bus == b) lcd_drain(&lcd_pool[i]);
+   }
+   if (b->fast_pending) {
+       b->fast_pending = 0;
+       bus_reset(b, 0, 0);
+   }
+   while (bus_probe_addr(b, addr) != 0 && b->speed + 1 < LCD_I2C_NUM_SPEEDS) {
+       bus_reset(b, (uint8_t)(b->speed + 1), 1);
+   }
+}
+
+/* HD44780 4-bit init sequence: three 0x03 nibbles and 0x02 reach 4-bit
+   mode from any state (8-bit, or 4-bit between two nibbles), then function
+   set, display on, clear and entry mode. lcd_init_op() queues one step and
+   returns the wait that must follow it. */
+#define LCD_INIT_STEPS 8
+static uint8_t lcd_init_op(lcd_t *d, uint8_t step)
+{
+   static const uint8_t seq[LCD_INIT_STEPS] = { 0x03, 0x03, 0x03, 0x02, 0x20, 0x0C, 0x01, 0x06 };
+   static const uint8_t op[LCD_INIT_STEPS] = {
+       LCD_OP_INIT1, LCD_OP_INIT2, LCD_OP_CMD, LCD_OP_CMD,
+       LCD_OP_CMD, LCD_OP_CMD, LCD_OP_CLEAR, LCD_OP_CMD
+   };
+   uint8_t v = seq[step];
+
+   if (step < 4) {
+       lcd_write_nibble(d, v, 0);
+       return op[step];
+   }
+   d->ready_for_poll = 1; /* 4-bit mode: busy flag reads are valid from here */
+   /* function set: 0x20 = 4-bit, 5x8 dots, | 0x08 for 2 (or 4) lines */
+   if (step == 4 && d->rows > 1) v |= 0x08;
+   lcd_write_nibble(d, (v >> 4) & 0x0F, 0);
+   lcd_write_nibble(d, v & 0x0F, 0);
+   return op[step];
+}
+
+/* DDRAM is all spaces, the shift is undone; CGRAM content is undefined */
+static void lcd_shadow_reset(lcd_t *d)
+{
+   memset(d->fb_shown, ' ', sizeof(d->fb_shown));
+   d->fb_valid = 1;
+   d->cur_row = 0;
+   d->cur_col = 0;
+   d->scroll_on = 0;
+   memset(d->slot_glyph, LCD_NO_SLOT, sizeof(d->slot_glyph));
+   memset(d->slot_bits, 0xFF, sizeof(d->slot_bits));
+   memset(d->glyph_slot, LCD_NO_SLOT, sizeof(d->glyph_slot));
+}
+
+/* The whole init sequence in one go, e.g. after a bus recovery, when a
+   transfer may have been cut between two nibbles and only the full
+   sequence resynchronizes. */
+static void lcd_controller_init(lcd_t *d)
+{
+   for (uint8_t s = 0; s < LCD_INIT_STEPS; ++s) {
+       lcd_wait(d, lcd_exec_us[lcd_init_op(d, s)]);
+   }
+   pcf_flush(d);
+   lcd_shadow_reset(d);
+}
+
+/* Would lcd_wait(d, us) block? Only in blocking mode, for waits too long
+   to pad with bus bytes; lcd_init_poll() returns instead. */
+static int lcd_wait_blocks(const lcd_t *d, uint16_t us)
+{
+#if LCD_ASYNC
+   (void)d;
+   (void)us;
+   return 0;
+#else
+   uint32_t covered = 2u * d->byte_us;
+   return us > covered && (us - covered + d->byte_us - 1) / d->byte_us > PCF_PAD_MAX;
+#endif
+}
+
+/* Direct-path calls need a live controller: finish the bring-up first */
+static void lcd_init_finish(lcd_t *d)
+{
+   while (!lcd_init_poll(d)) { }
+}
+
+/* Called before each flush: recover the bus once too many transfers have
+   failed in the current window, one speed step slower each time. The
+   displays are re-initialized and the flush redraws what fb_want holds
+   (a running scroll is cancelled). */
+static void bus_health(lcd_bus_t *b)
+{
+#if LCD_ASYNC
+   bus_watchdog(b);
+#endif
+   uint32_t now = HAL_GetTick();
+   uint32_t errs = bus_errors(b);
+   if (now - b->window_at >= LCD_I2C_ERR_WINDOW_MS) {
+       b->window_at = now;
+       b->window_errs = errs;
+   }
+   if (errs - b->window_errs < LCD_I2C_ERR_LIMIT) return;
+
+   uint8_t speed = b->speed;
+   if (speed + 1 < LCD_I2C_NUM_SPEEDS) speed++;
+   bus_reset(b, speed, 1);
+   b->recoveries++;
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       lcd_t *d = &lcd_pool[i];
+       if (d->bus != b || d->init_state != LCD_ST_READY) continue;
+       lcd_controller_init(d);
+       d->lost = 0;
+   }
+   b->window_at = HAL_GetTick();
+   b->window_errs = bus_errors(b);
 }
 
 /* ---------- PUBLIC API ---------- */
 
-void lcd_init(I2C_HandleTypeDef *hi2c, uint8_t addr7bit)
+/* Claim a handle for the display at addr7bit without touching the bus.
+   Returns NULL if LCD_MAX_DEVICES displays are already in use or the
+   geometry is larger than LCD_MAX_COLS x LCD_MAX_ROWS. The display comes
+   up while lcd_init_poll() (or lcd_flush()) is called; the framebuffer
+   can be drawn into right away. */
+lcd_t *lcd_init_start(I2C_HandleTypeDef *hi2c, uint8_t addr7bit, uint8_t cols, uint8_t rows)
+{
+   if (lcd_count >= LCD_MAX_DEVICES || cols == 0 || cols > LCD_MAX_COLS ||
+       rows == 0 || rows > LCD_MAX_ROWS) {
+       return NULL;
+   }
+   delay_init();
+   lcd_t *d = &lcd_pool[lcd_count];
+   memset(d, 0, sizeof(*d));
+   d->hi2c = hi2c;
+   d->bus = bus_get(hi2c);
+   d->addr = addr7bit & 0x7F;
+   d->backlight = P_CF_BL;
+   d->cols = cols;
+   d->rows = rows;
+   d->cur_row = LCD_CUR_UNKNOWN;
+   d->init_state = LCD_ST_POWERUP;
+   lcd_set_timing(d);
+   memset(d->fb_want, ' ', sizeof(d->fb_want));
+   lcd_count++;   /* the arbiter sees it from here; its queue is empty */
+   return d;
+}
+
+/* Advance the bring-up; never blocks for longer than one step. Returns 1
+   once the init sequence has been sent (LCD_ASYNC: queued).
+   The power-up wait counts from reset (HAL tick 0), as the LCD is powered
+   together with the MCU, so late callers do not wait again. Then the bus
+   speed is probed and the sequence sent; in blocking mode its long waits
+   (4.1 ms after the first nibble, the clear) return here instead of
+   spinning. */
+int lcd_init_poll(lcd_t *d)
 {
-   hi2c_lcd = hi2c;
-   lcd_addr = addr7bit & 0x7F;
-   backlight = P_CF_BL;
-   HAL_Delay(50); /* wait for LCD power-up */
+   if (d->init_state == LCD_ST_READY) return 1;
+   if (d->init_state == LCD_ST_POWERUP) {
+       if (HAL_GetTick() < (lcd_exec_us[LCD_OP_POWERUP] + 999u) / 1000u) return 0;
+       bus_probe(d->bus, d->addr);
+       lcd_set_timing(d);
+       d->init_state = LCD_ST_SEQ;
+       d->init_step = 0;
+       d->init_due = delay_cycles_now();
+   }
+   while (d->init_step < LCD_INIT_STEPS) {
+       if ((int32_t)(delay_cycles_now() - d->init_due) < 0) return 0;
+       uint16_t us = lcd_exec_us[lcd_init_op(d, d->init_step++)];
+       if (lcd_wait_blocks(d, us)) {
+           pcf_flush(d);
+           d->init_due = delay_cycles_now() + delay_us_to_cycles(us);
+       } else {
+           lcd_wait(d, us);
+       }
+   }
+   pcf_flush(d);
+   lcd_shadow_reset(d);
+   d->init_state = LCD_ST_READY;
+   return 1;
+}
 
-   /* Init sequence — send 0x03 3x then 0x02 to go to 4-bit mode */
-   lcd_write_nibble(0x03, 0); HAL_Delay(5);
-   lcd_write_nibble(0x03, 0); HAL_Delay(5);
-   lcd_write_nibble(0x03, 0); HAL_Delay(2);
-   lcd_write_nibble(0x02, 0); HAL_Delay(2);
+/* Bring up the display at addr7bit and return its handle, blocking until
+   the init sequence is out (see lcd_init_start) */
+lcd_t *lcd_init(I2C_HandleTypeDef *hi2c, uint8_t addr7bit, uint8_t cols, uint8_t rows)
+{
+   lcd_t *d = lcd_init_start(hi2c, addr7bit, cols, rows);
+   if (d) lcd_init_finish(d);
+   return d;
+}
 
-   /* Function set: 4-bit, N lines, 5x8 dots */
-   /* 0x20 = basic 4-bit, 0x08 = 2 lines flag, combine -> 0x28 for 2-line */
-   uint8_t func = 0x20;
-   if (LCD_ROWS > 1) func |= 0x08;
-   lcd_send_cmd(func | 0x00); /* final is typically 0x28 for 2-line */
+uint8_t lcd_cols(const lcd_t *d)
+{
+   return d->cols;
+}
 
-   /* Display on, cursor off, blink off */
-   lcd_send_cmd(0x0C);
-   /* Clear display */
-   lcd_send_cmd(0x01); HAL_Delay(2);
-   /* Entry mode: increment, no shift */
-   lcd_send_cmd(0x06);
+uint8_t lcd_rows(const lcd_t *d)
+{
+   return d->rows;
 }
 
 /* Clear */
-void lcd_clear(void)
+void lcd_clear(lcd_t *d)
 {
-   lcd_send_cmd(0x01);
-   HAL_Delay(2);
+   lcd_init_finish(d);
+   lcd_send_cmd(d, 0x01);
+   pcf_flush(d);
+
+   /* DDRAM is now all spaces and the cursor is home */
+   memset(d->fb_shown, ' ', sizeof(d->fb_shown));
+   d->fb_valid = 1;
+   d->cur_row = 0;
+   d->cur_col = 0;
 }
 
 /* Position cursor.
-   Supports common 16x2 and 20x4 DDRAM maps:
+   Lines 0 and 1 start at DDRAM 0x00 and 0x40; on 4-line modules rows 2 and
+   3 continue lines 0 and 1 right after the visible columns:
      16x2: line0->0x00, line1->0x40
      20x4: line0->0x00, line1->0x40, line2->0x14, line3->0x54
-   For other sizes it falls back to linear mapping row0/row1.
 */
-void lcd_put_cur(uint8_t row, uint8_t col)
+static void lcd_queue_cur(lcd_t *d, uint8_t row, uint8_t col)
+{
+   if (row >= d->rows) row = d->rows - 1;
+   if (col >= d->cols) col = d->cols - 1;
+
+   uint8_t addr = (uint8_t)(((row & 1) ? 0x40 : 0x00) + ((row & 2) ? d->cols : 0) + col);
+
+   lcd_send_cmd(d, 0x80 | addr);
+   d->cur_row = row;
+   d->cur_col = col;
+}
+
+void lcd_put_cur(lcd_t *d, uint8_t row, uint8_t col)
+{
+   lcd_init_finish(d);
+   lcd_queue_cur(d, row, col);
+   pcf_flush(d);
+}
+
+/* Send C-string to current cursor position */
+void lcd_send_string(lcd_t *d, const char *str)
+{
+   lcd_init_finish(d);
+   PROBE_BEGIN(PROBE_LCD_STRING);
+   while (*str) {
+       lcd_send_data(d, (uint8_t)(*str++));
+   }
+   pcf_flush(d);
+   PROBE_END(PROBE_LCD_STRING);
+}
+
+/* Backlight control */
+void lcd_backlight_on(lcd_t *d)
+{
+   lcd_init_finish(d);
+   d->backlight = P_CF_BL;
+   pcf_write(d, d->backlight);
+}
+void lcd_backlight_off(lcd_t *d)
+{
+   lcd_init_finish(d);
+   d->backlight = 0;
+   pcf_write(d, d->backlight);
+}
+
+/* ---------- Shadow framebuffer ---------- */
+
+/* Blank the wanted screen (nothing is sent until lcd_flush) */
+void lcd_fb_clear(lcd_t *d)
 {
-   if (row >= LCD_ROWS) row = LCD_ROWS - 1;
-   if (col >= LCD_COLS) col = LCD_COLS - 1;
+   memset(d->fb_want, ' ', sizeof(d->fb_want));
+}
+
+/* Write a string into the wanted screen at row/col, clipped to the row */
+void lcd_fb_write(lcd_t *d, uint8_t row, uint8_t col, const char *str)
+{
+   if (row >= d->rows) return;
+   while (col < d->cols && *str) {
+       d->fb_want[row][col++] = *str++;
+   }
+}
+
+/* Copy one full row (cols bytes, e.g. a pre-wrapped row from flash) */
+void lcd_fb_write_row(lcd_t *d, uint8_t row, const char *src)
+{
+   if (row >= d->rows) return;
+   memcpy(d->fb_want[row], src, d->cols);
+}
+
+/* Blank the wanted screen and lay a long string across all rows
+   (same fixed cols split as lcd_show_wrapped). */
+void lcd_fb_show_wrapped(lcd_t *d, const char *s)
+{
+   lcd_fb_clear(d);
+   for (int r = 0; r < d->rows; ++r) {
+       for (int c = 0; c < d->cols; ++c) {
+           if (*s == '\0') return;
+           d->fb_want[r][c] = *s++;
+       }
+   }
+}
+
+/* ---------- CGRAM glyph cache ---------- */
+
+/* Register a 5x8 custom character (8 rows, low 5 bits used) for all
+   displays. The bitmap is referenced, so keep it alive (normally a const
+   table). Returns the id for LCD_GLYPH(id), or -1 if LCD_GLYPH_MAX glyphs
+   are registered. */
+int lcd_glyph_register(const uint8_t bits[8], char fallback)
+{
+   if (glyph_count >= LCD_GLYPH_MAX) return -1;
+   glyph_bits[glyph_count] = bits;
+   glyph_fallback[glyph_count] = fallback;
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       lcd_pool[i].glyph_slot[glyph_count] = LCD_NO_SLOT;
+   }
+   return glyph_count++;
+}
 
-   uint8_t addr = 0x00;
+/* CGRAM uploads so far, all displays (one per slot refill) */
+uint32_t lcd_glyph_uploads(void)
+{
+   return glyph_uploads;
+}
+
+/* DDRAM byte for a framebuffer cell */
+static char fb_phys(const lcd_t *d, char ch)
+{
+   uint8_t id = (uint8_t)((uint8_t)ch - LCD_GLYPH_BASE);
+   if ((uint8_t)ch < LCD_GLYPH_BASE || id >= glyph_count) return ch;
+   return d->glyph_slot[id] != LCD_NO_SLOT ? (char)d->glyph_slot[id] : glyph_fallback[id];
+}
 
-   if (LCD_ROWS == 2 && LCD_COLS == 16) {
-       addr = (row == 0) ? 0x00 : 0x40;
-       addr += col;
+/* Make every glyph on the wanted screen resident. Slots holding a glyph on
+   this screen are pinned; the others are refilled least recently used
+   first. Screens with more than 8 distinct glyphs show the fallback
+   characters for the rest. */
+static void glyph_prepare(lcd_t *d)
+{
+   uint32_t want[(LCD_GLYPH_MAX + 31) / 32] = { 0 };
+   uint8_t any = 0;
+   for (uint8_t r = 0; r < d->rows; ++r) {
+       for (uint8_t c = 0; c < d->cols; ++c) {
+           uint8_t id = (uint8_t)((uint8_t)d->fb_want[r][c] - LCD_GLYPH_BASE);
+           if ((uint8_t)d->fb_want[r][c] < LCD_GLYPH_BASE || id >= glyph_count) continue;
+           want[id >> 5] |= 1UL << (id & 31);
+           any = 1;
+       }
    }
-   else if (LCD_ROWS == 4 && LCD_COLS == 20) {
-       switch (row) {
-           case 0: addr = 0x00 + col; break;
-           case 1: addr = 0x40 + col; break;
-           case 2: addr = 0x14 + col; break;
-           case 3: addr = 0x54 + col; break;
-           default: addr = 0x00 + col; break;
+   if (!any) return;
+
+   uint8_t pinned = 0;
+   ++glyph_clock;
+   for (uint8_t id = 0; id < glyph_count; ++id) {
+       if ((want[id >> 5] & (1UL << (id & 31))) && d->glyph_slot[id] != LCD_NO_SLOT) {
+           d->slot_used[d->glyph_slot[id]] = glyph_clock;
+           pinned |= (uint8_t)(1U << d->glyph_slot[id]);
        }
    }
-   else {
-       /* Generic fallback: row 0 -> 0x00, row 1 -> 0x40 */
-       addr = (row == 0) ? 0x00 : 0x40;
-       addr += col;
+   for (uint8_t id = 0; id < glyph_count; ++id) {
+       if (!(want[id >> 5] & (1UL << (id & 31))) || d->glyph_slot[id] != LCD_NO_SLOT) continue;
+       uint8_t victim = LCD_NO_SLOT;
+       for (uint8_t s = 0; s < LCD_CGRAM_SLOTS; ++s) {
+           if (pinned & (1U << s)) continue;
+           if (d->slot_glyph[s] == LCD_NO_SLOT) { victim = s; break; }
+           if (victim == LCD_NO_SLOT || d->slot_used[s] < d->slot_used[victim]) victim = s;
+       }
+       if (victim == LCD_NO_SLOT) break;      /* all 8 pinned: fallback */
+       if (d->slot_glyph[victim] != LCD_NO_SLOT) d->glyph_slot[d->slot_glyph[victim]] = LCD_NO_SLOT;
+       d->slot_glyph[victim] = id;
+       d->glyph_slot[id] = victim;
+       d->slot_used[victim] = glyph_clock;
+       pinned |= (uint8_t)(1U << victim);
    }
 
-   lcd_send_cmd(0x80 | addr);
+   /* upload only slots whose CGRAM bitmap differs from the glyph */
+   for (uint8_t s = 0; s < LCD_CGRAM_SLOTS; ++s) {
+       if (!(pinned & (1U << s))) continue;
+       const uint8_t *bits = glyph_bits[d->slot_glyph[s]];
+       uint8_t same = 1;
+       for (uint8_t i = 0; i < 8; ++i) same &= (uint8_t)(d->slot_bits[s][i] == (bits[i] & 0x1F));
+       if (same) continue;
+       lcd_send_cmd(d, (uint8_t)(0x40 | (s << 3)));   /* set CGRAM address */
+       for (uint8_t i = 0; i < 8; ++i) {
+           d->slot_bits[s][i] = bits[i] & 0x1F;
+           lcd_send_raw(d, d->slot_bits[s][i]);
+       }
+       d->cur_row = LCD_CUR_UNKNOWN;                  /* AC points into CGRAM now */
+       glyph_uploads++;
+   }
 }
 
-/* Send C-string to current cursor position */
-void lcd_send_string(const char *str)
+/* Send only the cells that differ between fb_want and fb_shown.
+   Each run of consecutive dirty cells costs one cursor command (skipped if
+   the cursor already sits at the start of the run) plus one data write per
+   cell. With LCD_ASYNC the diff is only queued behind an empty queue, so
+   it does not wait for a slot; otherwise it stays pending for the next call.
+*/
+void lcd_flush(lcd_t *d)
 {
-   while (*str) {
-       lcd_send_data((uint8_t)(*str++));
+   if (!lcd_init_poll(d)) return;   /* drawn once the display is up */
+   bus_health(d->bus);
+   d->flush_pending = !lcd_queue_idle(d);
+   if (d->flush_pending) return;
+   if (d->scroll_on) {
+       /* one shift command per step; drawing waits for lcd_scroll_stop() */
+       if ((int32_t)(HAL_GetTick() - d->scroll_next) >= 0) {
+           lcd_send_cmd(d, 0x18);  /* cursor/display shift: S/C=1, R/L=0 */
+           pcf_flush(d);
+           d->scroll_next += d->scroll_step_ms;
+       }
+       return;
+   }
+
+   PROBE_BEGIN(PROBE_LCD_FLUSH);
+   uint8_t full = !d->fb_valid || d->lost;
+   /* a lost transfer may have carried a CGRAM upload as well */
+   if (d->lost) memset(d->slot_bits, 0xFF, sizeof(d->slot_bits));
+   d->lost = 0;
+   glyph_prepare(d);
+
+   for (uint8_t r = 0; r < d->rows; ++r) {
+       uint8_t c = 0;
+       while (c < d->cols) {
+           if (!full && fb_phys(d, d->fb_want[r][c]) == d->fb_shown[r][c]) { ++c; continue; }
+
+           /* start of a dirty run */
+           if (d->cur_row != r || d->cur_col != c) lcd_queue_cur(d, r, c);
+           while (c < d->cols && (full || fb_phys(d, d->fb_want[r][c]) != d->fb_shown[r][c])) {
+               lcd_send_data(d, (uint8_t)fb_phys(d, d->fb_want[r][c]));
+               ++c;
+           }
+       }
    }
+   d->fb_valid = 1;
+   pcf_flush(d); /* the whole diff goes out as one transaction */
+   PROBE_END(PROBE_LCD_FLUSH);
 }
 
-/* Backlight control */
-void lcd_backlight_on(void)
+/* Flush every display. Each diff is queued at once; displays sharing a bus
+   then get their transactions interleaved by the arbiter. */
+void lcd_flush_all(void)
+{
+   for (uint8_t i = 0; i < lcd_count; ++i) {
+       lcd_flush(&lcd_pool[i]);
+   }
+}
+
+/* Queue state (LCD_ASYNC). In blocking mode everything has already been
+   sent by the time a call returns, so only the bring-up can be pending.
+   A display still coming up is not idle; lcd_wait_idle() finishes it. */
+int lcd_is_idle(const lcd_t *d)
+{
+   return d->init_state == LCD_ST_READY && !d->flush_pending && lcd_queue_idle(d);
+}
+
+void lcd_wait_idle(lcd_t *d)
+{
+   lcd_init_finish(d);
+   lcd_drain(d);
+   if (d->flush_pending) {
+       lcd_flush(d);
+       lcd_drain(d);
+   }
+}
+
+/* Clock for the completion stamps (HAL_GetTick() if none), called from the
+   I2C completion ISR */
+void lcd_set_clock(lcd_clock_fn_t now)
+{
+   lcd_clock = now;
+}
+
+/* When the display's last queued transaction finished. Once lcd_is_idle()
+   is true after a flush, this is the moment that flush became visible. */
+uint32_t lcd_done_stamp(const lcd_t *d)
+{
+   return d->done_at;
+}
+
+/* Bus traffic since lcd_init(): transactions and bytes sent to this display */
+uint32_t lcd_xfers(const lcd_t *d)
+{
+   return d->xfers;
+}
+
+uint32_t lcd_bytes(const lcd_t *d)
+{
+   return d->bytes;
+}
+
+/* Transactions that failed, timed out or could not be started */
+uint32_t lcd_errors(const lcd_t *d)
+{
+   return d->errors;
+}
+
+/* Current clock of the display's bus and how often it has been recovered */
+uint32_t lcd_bus_hz(const lcd_t *d)
 {
-   backlight = P_CF_BL;
-   pcf_write(backlight);
+   return d->hi2c->Init.ClockSpeed;
 }
-void lcd_backlight_off(void)
+
+uint32_t lcd_bus_recoveries(const lcd_t *d)
 {
-   backlight = 0;
-   pcf_write(backlight);
+   return d->bus->recoveries;
 }
 
 /* ---------- Utility helpers for diagnostics and usability ---------- */
@@ -198,56 +1262,91 @@ void lcd_backlight_off(void)
    - For a 16x2 device this writes 16 chars per line (4 lines if the module has them).
    - Use this after init to see if bits/nibbles are aligned correctly.
 */
-void lcd_ascii_test(void) {
+void lcd_ascii_test(lcd_t *d) {
     char buf[32];
-    int total_chars = LCD_ROWS * LCD_COLS;
     int start = 32; /* printable ASCII from space onwards */
 
-    for (int r = 0; r < LCD_ROWS; ++r) {
-        int base = start + r * LCD_COLS;
-        int len = LCD_COLS;
+    for (int r = 0; r < d->rows; ++r) {
+        int base = start + r * d->cols;
+        int len = d->cols;
         if (len > (int)sizeof(buf)-1) len = sizeof(buf)-1;
         for (int i = 0; i < len; ++i) buf[i] = (char)(base + i);
         buf[len] = '\0';
-        lcd_put_cur(r, 0);
-        lcd_send_string(buf);
+        lcd_put_cur(d, r, 0);
+        lcd_send_string(d, buf);
     }
 }
 
 /* Show long string wrapped across multiple lines (simple helper)
    truncates to available display area. */
-void lcd_show_wrapped(const char *s) {
-    char tmp[LCD_COLS + 1];
-    for (int r = 0; r < LCD_ROWS; ++r) {
-        int offset = r * LCD_COLS;
+void lcd_show_wrapped(lcd_t *d, const char *s) {
+    char tmp[LCD_MAX_COLS + 1];
+    for (int r = 0; r < d->rows; ++r) {
+        int offset = r * d->cols;
         int i;
-        for (i = 0; i < LCD_COLS && s[offset + i] != '\0'; ++i) tmp[i] = s[offset + i];
+        for (i = 0; i < d->cols && s[offset + i] != '\0'; ++i) tmp[i] = s[offset + i];
         tmp[i] = '\0';
-        lcd_put_cur(r, 0);
-        lcd_send_string(tmp);
+        lcd_put_cur(d, r, 0);
+        lcd_send_string(d, tmp);
         if (s[offset + i] == '\0') break;
     }
 }
 
-/* Very simple blocking scroll left for one row.
-   Use sparingly (blocking) and tune delay_ms to taste.
-*/
-void lcd_scroll_line(uint8_t row, const char *text, uint16_t delay_ms) {
-    int len = (int)strlen(text);
-    if (len <= LCD_COLS) {
-        lcd_put_cur(row, 0);
-        lcd_send_string(text);
+/* Scroll text left across one row using the display shift (non-blocking).
+   The whole text (up to 40 characters, the DDRAM line length) is written
+   once; after that each step is a single 0x18 command sent by lcd_flush()
+   every step_ms, and the text wraps around through the line indefinitely.
+   Every row moves with the shift, so the other rows are written with their
+   framebuffer content and blank padding and scroll along. Stop with
+   lcd_scroll_stop(). Text that fits the row is just drawn. */
+void lcd_scroll_line(lcd_t *d, uint8_t row, const char *text, uint16_t step_ms) {
+    size_t len = strlen(text);
+    if (row >= d->rows) return;
+    if (d->scroll_on) lcd_scroll_stop(d);
+    /* 4-line modules map rows 2/3 into the tails of lines 0/1, and a shift
+       would drag them across the screen: no hardware scroll there */
+    if (len <= d->cols || d->rows > 2) {
+        lcd_fb_write(d, row, 0, text);
         return;
     }
+    lcd_init_finish(d);
+    if (len > LCD_DDRAM_LINE) len = LCD_DDRAM_LINE;
+    /* glyphs get slots for what the row starts with (past the visible
+       columns only already resident ones show, the rest use their fallback) */
+    memcpy(d->fb_want[row], text, d->cols);
+    glyph_prepare(d);
 
-    char buf[LCD_COLS + 1];
-    for (int start = 0; start <= len - LCD_COLS; ++start) {
-        for (int i = 0; i < LCD_COLS; ++i) buf[i] = text[start + i];
-        buf[LCD_COLS] = '\0';
-        lcd_put_cur(row, 0);
-        lcd_send_string(buf);
-        HAL_Delay(delay_ms);
+    for (uint8_t r = 0; r < d->rows; ++r) {
+        lcd_send_cmd(d, (uint8_t)(0x80 | (r ? 0x40 : 0x00)));
+        for (uint8_t c = 0; c < LCD_DDRAM_LINE; ++c) {
+            char ch = ' ';
+            if (r == row) ch = (c < len) ? fb_phys(d, text[c]) : ' ';
+            else if (c < d->cols) ch = fb_phys(d, d->fb_want[r][c]);
+            lcd_send_raw(d, (uint8_t)ch);
+            if (c < d->cols) d->fb_shown[r][c] = ch;
+        }
     }
+    d->cur_row = LCD_CUR_UNKNOWN;  /* address counter wrapped past the line */
+    d->fb_valid = !d->lost;
+    pcf_flush(d);
+
+    d->scroll_on = 1;
+    d->scroll_step_ms = step_ms ? step_ms : 1;
+    d->scroll_next = HAL_GetTick() + d->scroll_step_ms;
+}
+
+/* Undo the shift (return home) and hand the display back to lcd_flush() */
+void lcd_scroll_stop(lcd_t *d) {
+    if (!d->scroll_on) return;
+    d->scroll_on = 0;
+    lcd_send_cmd(d, 0x02);         /* return home: shift 0, cursor at 0,0 */
+    pcf_flush(d);
+    d->cur_row = 0;
+    d->cur_col = 0;
+}
+
+int lcd_scrolling(const lcd_t *d) {
+    return d->scroll_on;
 }
 
 /* ---------- End of file ---------- */
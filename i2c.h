@@ -3,22 +3,73 @@
 #define I2C_LCD_H
 #include "stm32f4xx_hal.h"
 #include <stdint.h>
-/* LCD geometry (change if you have 20x4 etc) */
+/* Question LCD geometry (change if you have 20x4 etc) */
 #define LCD_COLS 16
 #define LCD_ROWS 2
+/* Largest geometry of any attached display (sizes each framebuffer) */
+#define LCD_MAX_COLS 20
+#define LCD_MAX_ROWS 4
 /* PCF8574 bit mapping (adjust if your module is different) */
 #define P_CF_RS    (1<<0)   /* P0 */
 #define P_CF_RW    (1<<1)   /* P1 */
 #define P_CF_EN    (1<<2)   /* P2 */
 #define P_CF_BL    (1<<3)   /* P3 backlight */
 #define P_CF_DATA  (0xF0)   /* P4..P7 used for D4..D7 */
+/* One display (PCF8574 backpack). lcd_init() hands out handles from a
+   static pool of LCD_MAX_DEVICES; displays on one bus share it in turns. */
+typedef struct lcd_s lcd_t;
 /* Public API */
-void lcd_init(I2C_HandleTypeDef *hi2c, uint8_t addr7bit);
-void lcd_clear(void);
-void lcd_put_cur(uint8_t row, uint8_t col);
-void lcd_send_string(const char *str);
-void lcd_backlight_on(void);
-void lcd_backlight_off(void);
+lcd_t *lcd_init(I2C_HandleTypeDef *hi2c, uint8_t addr7bit, uint8_t cols, uint8_t rows);
+/* Non-blocking bring-up: lcd_init_start() claims the handle, lcd_init_poll()
+   (also run by lcd_flush) steps the power-up wait and init sequence and
+   returns 1 when done. The direct calls below finish it first. */
+lcd_t *lcd_init_start(I2C_HandleTypeDef *hi2c, uint8_t addr7bit, uint8_t cols, uint8_t rows);
+int lcd_init_poll(lcd_t *d);
+uint8_t lcd_cols(const lcd_t *d);
+uint8_t lcd_rows(const lcd_t *d);
+void lcd_clear(lcd_t *d);
+void lcd_put_cur(lcd_t *d, uint8_t row, uint8_t col);
+void lcd_send_string(lcd_t *d, const char *str);
+void lcd_backlight_on(lcd_t *d);
+void lcd_backlight_off(lcd_t *d);
+/* Shadow framebuffer: draw with lcd_fb_*, then lcd_flush() sends only changed cells */
+void lcd_fb_clear(lcd_t *d);
+void lcd_fb_write(lcd_t *d, uint8_t row, uint8_t col, const char *str);
+void lcd_fb_show_wrapped(lcd_t *d, const char *s);
+/* Copy exactly lcd_cols() bytes (no NUL needed) into a framebuffer row */
+void lcd_fb_write_row(lcd_t *d, uint8_t row, const char *src);
+/* Custom characters: register a 5x8 bitmap once, then put LCD_GLYPH(id) in
+   framebuffer strings. lcd_flush() keeps the glyphs on screen in the 8 CGRAM
+   slots (least recently used evicted) and uploads only changed bitmaps.
+   Glyph ids are shared by all displays. */
+#define LCD_GLYPH_BASE 0x80
+#define LCD_GLYPH(id) ((char)(LCD_GLYPH_BASE + (id)))
+int lcd_glyph_register(const uint8_t bits[8], char fallback);
+uint32_t lcd_glyph_uploads(void);
+void lcd_flush(lcd_t *d);
+void lcd_flush_all(void);
+/* Non-blocking queue (LCD_ASYNC): calls above return once queued */
+int lcd_is_idle(const lcd_t *d);
+void lcd_wait_idle(lcd_t *d);
+uint32_t lcd_errors(const lcd_t *d);
+/* I2C transactions and bytes sent to this display so far */
+uint32_t lcd_xfers(const lcd_t *d);
+uint32_t lcd_bytes(const lcd_t *d);
+/* Bus clock picked by the start-up probe / error fallback, and the number
+   of bus recoveries so far */
+uint32_t lcd_bus_hz(const lcd_t *d);
+uint32_t lcd_bus_recoveries(const lcd_t *d);
+/* Completion stamps: lcd_done_stamp() = clock value when the display's queue
+   last drained (ISR time, so it is not delayed by the main loop) */
+typedef uint32_t (*lcd_clock_fn_t)(void);
+void lcd_set_clock(lcd_clock_fn_t now);
+uint32_t lcd_done_stamp(const lcd_t *d);
+/* Diagnostics / helpers (direct, bypass the framebuffer diff) */
+void lcd_ascii_test(lcd_t *d);
+void lcd_show_wrapped(lcd_t *d, const char *s);
+/* Hardware scroll (display shift), stepped by lcd_flush() every step_ms */
+void lcd_scroll_line(lcd_t *d, uint8_t row, const char *text, uint16_t step_ms);
+void lcd_scroll_stop(lcd_t *d);
+int lcd_scrolling(const lcd_t *d);
 #endif /* I2C_LCD_H */
 
-
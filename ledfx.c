@@ -0,0 +1,203 @@
+/*
+* ledfx.c - WS2812B strip effects (see ledfx.h)
+*
+* Everything runs in thread context from ledfx_task(); the only thing
+* shared with the driver's interrupts is the buffer on the wire, which is
+* never drawn into until ws2812b_send_async() has accepted the next one.
+*/
+
+#include "ledfx.h"
+#include "ws2812b.h"
+#include "probe.h"
+#include "stm32f4xx_hal.h"
+#include <string.h>
+
+#define SWEEP_TAIL 8               /* LEDs behind the sweep head */
+#define PULSES     2               /* wrong-answer pulses per effect */
+
+/* (i / 255)^2.6 * 255, rounded */
+static const uint8_t gamma8[256] = {
+     0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+     0,   0,   0,   0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,
+     1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,   2,   3,   3,   3,   3,
+     3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   5,   6,   6,   6,   6,   7,
+     7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  10,  11,  11,  11,  12,  12,
+    13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,  20,
+    20,  21,  21,  22,  22,  23,  24,  24,  25,  25,  26,  27,  27,  28,  29,  29,
+    30,  31,  31,  32,  33,  34,  34,  35,  36,  37,  38,  38,  39,  40,  41,  42,
+    42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,  56,  57,
+    58,  59,  60,  61,  62,  63,  64,  65,  66,  68,  69,  70,  71,  72,  73,  75,
+    76,  77,  78,  80,  81,  82,  84,  85,  86,  88,  89,  90,  92,  93,  94,  96,
+    97,  99, 100, 102, 103, 105, 106, 108, 109, 111, 112, 114, 115, 117, 119, 120,
+   122, 124, 125, 127, 129, 130, 132, 134, 136, 137, 139, 141, 143, 145, 146, 148,
+   150, 152, 154, 156, 158, 160, 162, 164, 166, 168, 170, 172, 174, 176, 178, 180,
+   182, 184, 186, 188, 191, 193, 195, 197, 199, 202, 204, 206, 209, 211, 213, 215,
+   218, 220, 223, 225, 227, 230, 232, 235, 237, 240, 242, 245, 247, 250, 252, 255,
+};
+
+static uint8_t lut[256];           /* gamma8 scaled by the brightness */
+static uint8_t buf[2][LEDFX_COUNT * 3];
+static uint8_t draw = 0;           /* buffer being rendered */
+static uint8_t front = 1;          /* buffer last handed to the driver */
+static uint8_t ready = 0;          /* buf[draw] holds a frame not yet sent */
+static uint8_t repaint = 0;        /* idle, but the strip is not dark yet */
+
+static ledfx_effect_t fx = LEDFX_OFF;
+static uint32_t fx_start;
+static uint32_t fx_ms;
+
+static uint32_t frames = 0;
+static uint32_t late = 0;
+
+/* x / 255 for x <= 255 * 255, exact */
+static inline uint32_t div255(uint32_t x)
+{
+   return (x + 1 + (x >> 8)) >> 8;
+}
+
+void ledfx_hsv(uint16_t h, uint8_t s, uint8_t v, uint8_t rgb[3])
+{
+   uint32_t f = h & 0xFFU;
+   uint8_t p = (uint8_t)div255(v * (255U - s));
+   uint8_t q = (uint8_t)div255(v * (255U - div255(s * f)));
+   uint8_t t = (uint8_t)div255(v * (255U - div255(s * (255U - f))));
+   switch ((h >> 8) % 6U) {
+   case 0:  rgb[0] = v; rgb[1] = t; rgb[2] = p; break;
+   case 1:  rgb[0] = q; rgb[1] = v; rgb[2] = p; break;
+   case 2:  rgb[0] = p; rgb[1] = v; rgb[2] = t; break;
+   case 3:  rgb[0] = p; rgb[1] = q; rgb[2] = v; break;
+   case 4:  rgb[0] = t; rgb[1] = p; rgb[2] = v; break;
+   default: rgb[0] = v; rgb[1] = p; rgb[2] = q; break;
+   }
+}
+
+static void put(uint8_t *frame, uint16_t i, const uint8_t rgb[3])
+{
+   uint8_t *px = &frame[i * 3U];
+   px[0] = lut[rgb[1]];
+   px[1] = lut[rgb[0]];
+   px[2] = lut[rgb[2]];
+}
+
+/* Green head running off the far end, with a linearly fading tail */
+static void render_sweep(uint8_t *frame, uint32_t t)
+{
+   /* head position in 1/256 LED, from 0 until the tail has left the strip */
+   uint32_t head = t * ((LEDFX_COUNT + SWEEP_TAIL) * 256U) / fx_ms;
+   uint8_t rgb[3];
+   for (uint16_t i = 0; i < LEDFX_COUNT; ++i) {
+       uint32_t at = (uint32_t)i * 256U;
+       uint32_t d = head - at;
+       if (head < at || d >= SWEEP_TAIL * 256U) continue;
+       uint8_t v = (uint8_t)(255U - d / SWEEP_TAIL);
+       ledfx_hsv(LEDFX_HUE_GREEN, 255, v, rgb);
+       put(frame, i, rgb);
+   }
+}
+
+/* Whole strip red, triangle brightness, PULSES times */
+static void render_pulse(uint8_t *frame, uint32_t t)
+{
+   uint32_t period = fx_ms / PULSES;
+   if (period == 0) return;
+   uint32_t phase = (t % period) * 510U / period;
+   uint8_t v = (uint8_t)(phase <= 255U ? phase : 510U - phase);
+   uint8_t rgb[3];
+   ledfx_hsv(LEDFX_HUE_RED, 255, v, rgb);
+   put(frame, 0, rgb);
+   for (uint16_t i = 1; i < LEDFX_COUNT; ++i) memcpy(&frame[i * 3U], frame, 3);
+}
+
+/* Bar of the time left, its last LED partly lit, hue green -> red */
+static void render_countdown(uint8_t *frame, uint32_t t)
+{
+   uint32_t left = fx_ms - t;
+   uint32_t lit = left * (LEDFX_COUNT * 256U) / fx_ms;   /* 1/256 LED */
+   uint16_t hue = (uint16_t)(left * LEDFX_HUE_GREEN / fx_ms);
+   uint8_t rgb[3];
+   ledfx_hsv(hue, 255, 255, rgb);
+   uint16_t full = (uint16_t)(lit >> 8);
+   for (uint16_t i = 0; i < full; ++i) put(frame, i, rgb);
+   if (full < LEDFX_COUNT && (lit & 0xFFU)) {
+       ledfx_hsv(hue, 255, (uint8_t)(lit & 0xFFU), rgb);
+       put(frame, full, rgb);
+   }
+}
+
+static void render(uint8_t *frame)
+{
+   memset(frame, 0, LEDFX_COUNT * 3);
+   if (fx == LEDFX_OFF) return;
+   uint32_t t = HAL_GetTick() - fx_start;
+   if (t >= fx_ms) {
+       fx = LEDFX_OFF;            /* this frame is the dark one */
+       return;
+   }
+   switch (fx) {
+   case LEDFX_SWEEP:     render_sweep(frame, t); break;
+   case LEDFX_PULSE:     render_pulse(frame, t); break;
+   case LEDFX_COUNTDOWN: render_countdown(frame, t); break;
+   default: break;
+   }
+}
+
+void ledfx_init(void)
+{
+   memset(buf, 0, sizeof(buf));
+   ledfx_set_brightness(LEDFX_BRIGHTNESS);
+}
+
+void ledfx_set_brightness(uint8_t b)
+{
+   for (uint16_t i = 0; i < 256; ++i) lut[i] = (uint8_t)((gamma8[i] * b + 127U) / 255U);
+   repaint = 1;
+}
+
+void ledfx_play(ledfx_effect_t effect, uint32_t ms)
+{
+   fx = ms ? effect : LEDFX_OFF;
+   fx_start = HAL_GetTick();
+   fx_ms = ms;
+   repaint = 1;
+}
+
+void ledfx_stop(void)
+{
+   ledfx_play(LEDFX_OFF, 0);
+}
+
+void ledfx_task(void)
+{
+   if (!ready && (fx != LEDFX_OFF || repaint)) {
+       PROBE_BEGIN(PROBE_LEDFX_RENDER);
+       repaint = 0;
+       render(buf[draw]);
+       PROBE_END(PROBE_LEDFX_RENDER);
+       ready = 1;
+   }
+   if (!ready) return;
+   /* the driver encodes straight from buf[draw] while buf[front] is free */
+   if (ws2812b_send_async(buf[draw], LEDFX_COUNT, NULL) != 0) {
+       late++;
+       return;
+   }
+   front = draw;
+   draw ^= 1U;
+   ready = 0;
+   frames++;
+}
+
+const uint8_t *ledfx_front(void)
+{
+   return buf[front];
+}
+
+uint32_t ledfx_frames(void)
+{
+   return frames;
+}
+
+uint32_t ledfx_late(void)
+{
+   return late;
+}
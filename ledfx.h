@@ -0,0 +1,58 @@
+#ifndef LEDFX_H
+#define LEDFX_H
+#include <stdint.h>
+/*
+* ledfx.h - WS2812B strip effects on top of ws2812b.h.
+*
+* ledfx_task() renders the running effect into one of two GRB frame
+* buffers and hands that buffer itself to ws2812b_send_async(): the DMA
+* backend encodes straight from it, nothing is copied. The next frame is
+* rendered into the other buffer while the first is on the wire, so a run
+* never waits for the strip; if the previous frame is still going out, the
+* new one is sent on the next run instead.
+*
+* Animations are timed from HAL_GetTick(), not counted in frames, so a late
+* frame never slows an effect down. Colours are fixed-point HSV (hue
+* 0..LEDFX_HUE_MAX-1, six 256-step sectors from red) and every channel
+* goes through a 256-entry gamma table scaled by the global brightness.
+*/
+#ifndef LEDFX_COUNT
+#define LEDFX_COUNT 60             /* LEDs on the strip */
+#endif
+#ifndef LEDFX_FRAME_MS
+#define LEDFX_FRAME_MS 20          /* ledfx_task() period: 50 frames/s */
+#endif
+#ifndef LEDFX_BRIGHTNESS
+#define LEDFX_BRIGHTNESS 96        /* 0..255, applied after gamma */
+#endif
+
+#define LEDFX_HUE_MAX   1536
+#define LEDFX_HUE_RED   0
+#define LEDFX_HUE_GREEN 512
+#define LEDFX_HUE_BLUE  1024
+
+typedef enum {
+   LEDFX_OFF,
+   LEDFX_SWEEP,       /* correct answer: green comet end to end */
+   LEDFX_PULSE,       /* wrong answer: whole strip pulses red twice */
+   LEDFX_COUNTDOWN    /* bar shrinking from green to red over the time */
+} ledfx_effect_t;
+
+/* Build the gamma table; the ws2812b backend must be initialized already */
+void ledfx_init(void);
+/* Rescale the gamma table (0 = dark, 255 = full) */
+void ledfx_set_brightness(uint8_t b);
+/* Start an effect lasting ms (it replaces the running one); the strip goes
+   dark when it ends */
+void ledfx_play(ledfx_effect_t fx, uint32_t ms);
+void ledfx_stop(void);
+/* Scheduler task, every LEDFX_FRAME_MS */
+void ledfx_task(void);
+
+/* Fixed-point HSV to 8-bit RGB (no gamma): h < LEDFX_HUE_MAX */
+void ledfx_hsv(uint16_t h, uint8_t s, uint8_t v, uint8_t rgb[3]);
+/* The buffer last handed to the driver (GRB, LEDFX_COUNT LEDs) */
+const uint8_t *ledfx_front(void);
+uint32_t ledfx_frames(void);       /* frames sent */
+uint32_t ledfx_late(void);         /* runs that found the strip still busy */
+#endif /* LEDFX_H */
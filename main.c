@@ -7,91 +7,190 @@
  - Displays the final score ONLY at the end of the quiz (after NUM_QUESTIONS),
    as a "Round complete" screen, then resets score and continues.
  - Optional ASCII diagnostic (RUN_ASCII_TEST).
+ - Optional scoreboard LCD (SCOREBOARD_LCD) on the same I2C bus at another
+   PCF8574 address, showing the running score and question number.
+ - Times every answer from the moment the question has actually reached the
+   LCD to the answer's line terminator; min/mean/p95 are shown after the
+   round score. Optional speed-weighted scoring (SPEED_SCORING).
+ - Optional buzz-in mode (BUZZ_IN) for several contestants on their own
+   UART terminals and/or buzzer buttons; the fastest correct answer by
+   hardware timestamp wins (buzzin.h). USART1 stays the quizmaster terminal.
+ - Optional WS2812B strip (LED_STRIP): a countdown bar while a question
+   waits, a green sweep for a correct answer and a red pulse for a wrong one.
+ - Runs as a state machine (SHOW_QUESTION -> AWAIT_ANSWER -> FEEDBACK ->
+   ROUND_SUMMARY) inside cooperative scheduler tasks; nothing blocks, so
+   input is picked up within one scheduler tick.
 */
 #include "main.h"
 #include "i2c.h"
+#include "buzzer.h"
+#include "audio.h"
+#include "uart_rx.h"
+#include "sched.h"
+#include "power.h"
+#include "console.h"
+#include "qstore.h"
+#include "answer.h"
+#include "buzzin.h"
+#include "resp.h"
+#include "probe.h"
+#include "flog.h"
+#include "proto.h"
+#include "ws2812b.h"
+#include "ledfx.h"
 #include <string.h>
-#include <strings.h> /* for strcasecmp */
-#include <ctype.h>   /* for isspace, tolower */
 #include <stdio.h>   /* for snprintf */
+#if QSTORE_BACKEND == QSTORE_BACKEND_FATFS
+#include "fatfs.h"
+#endif
 UART_HandleTypeDef huart1;
 I2C_HandleTypeDef hi2c1;
+TIM_HandleTypeDef htim1;
+TIM_HandleTypeDef htim7;
+#define BUZZ_IN        0    /* 1: several contestants, fastest correct answer wins */
+#define LED_STRIP      1    /* 1: WS2812B strip effects (ledfx.h) on PB1 */
+#if LED_STRIP && WS2812B_BACKEND == WS2812B_BACKEND_TIMER
+TIM_HandleTypeDef htim3;   /* WS2812B strip: PWM on CH4 (PB1) */
+#endif
+#if BUZZ_IN
+UART_HandleTypeDef huart2; /* contestant terminals */
+UART_HandleTypeDef huart6;
+TIM_HandleTypeDef htim2;   /* 1 MHz free-running timestamp clock */
+#endif
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+SPI_HandleTypeDef hspi2;   /* question bank SPI NOR */
+#elif QSTORE_BACKEND == QSTORE_BACKEND_FATFS
+SD_HandleTypeDef hsd;      /* question bank SD card (used by FatFs' sd_diskio) */
+#endif
 /* --- CONFIG --- */
 #define RUN_ASCII_TEST 0   /* set to 1 to run ascii mapping test at startup (temporary) */
+#define QUIZ_UART_BAUD 9600 /* RX is DMA-driven, so much higher rates work too;
+                               rigs switch up with a PROTO_T_BAUD frame */
+#define FEEDBACK_MS    400  /* LED + "Correct!/Wrong!" before moving on */
+#define SUMMARY_MS     3000 /* "Round complete" screen, then the same for the times */
+#define SETTLE_MS      200  /* pause before the next question */
+#define PAGE_MS       2500  /* per page of a question longer than the LCD */
+#define LCD_FLUSH_MS   10   /* framebuffer -> LCD diff period */
+#define POWER_IDLE     1    /* 1: SLEEP (WFI) whenever no task is due */
+#define SPEED_SCORING  0    /* 1: faster correct answers score more */
+#define SPEED_POINTS   10   /* SPEED_SCORING: points for a correct answer ... */
+#define SPEED_BONUS    10   /* ... plus up to this for an instant one, */
+#define SPEED_WINDOW_MS 10000 /* falling linearly to 0 at this response time */
+#define LCD_ADDR       0x27 /* question LCD backpack (7-bit) */
+#define SCOREBOARD_LCD 1    /* 1: drive a second 16x2 LCD as scoreboard if it answers */
+#define SCOREBOARD_ADDR 0x26 /* scoreboard backpack: A0 jumper bridged */
 /* --- PERIPHERAL / UI PINS --- */
-#define BUZZER_PIN   GPIO_PIN_0
+#define BUZZER_PIN   GPIO_PIN_0   /* TIM1_CH2N (AF1) */
 #define BUZZER_PORT  GPIOB
+#define BUZZER_TIM_CHANNEL TIM_CHANNEL_2
 #define LED_PORT     GPIOF
 #define LED_R_PIN    GPIO_PIN_12
 #define LED_B_PIN    GPIO_PIN_11
 #define LED_G_PIN    GPIO_PIN_10
+#define BUZZ_BTN_PORT GPIOC       /* buzzer buttons to GND, EXTI falling edge */
+#define BUZZ_BTN1_PIN GPIO_PIN_0
+#define BUZZ_BTN2_PIN GPIO_PIN_1
+#if BUZZ_IN
+#define NUM_PLAYERS  BUZZIN_MAX_PLAYERS
+#if UART_RX_PORTS < 3
+#error "BUZZ_IN needs UART_RX_PORTS 3 (USART1 + two contestant terminals)"
+#endif
+#else
+#define NUM_PLAYERS  1
+#endif
+/* Clock shared by the uart_rx line stamps and the LCD completion stamps */
+#if BUZZ_IN
+#define STAMP_NOW()   buzzin_now_us()
+#define STAMPS_PER_MS 1000U
+#else
+#define STAMP_NOW()   HAL_GetTick()
+#define STAMPS_PER_MS 1U
+#endif
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART1_UART_Init(void);
 static void MX_I2C1_Init(void);
-void play_tone(uint32_t freq, uint32_t duration_ms);
+static void MX_TIM1_Init(void);
+static void MX_TIM7_Init(void);
+#if LED_STRIP && WS2812B_BACKEND == WS2812B_BACKEND_TIMER
+static void MX_TIM3_Init(void);
+#endif
+#if BUZZ_IN
+static void MX_TIM2_Init(void);
+static void MX_USART2_UART_Init(void);
+static void MX_USART6_UART_Init(void);
+#endif
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+static void MX_SPI2_Init(void);
+#elif QSTORE_BACKEND == QSTORE_BACKEND_FATFS
+static void MX_SDIO_SD_Init(void);
+#endif
 void correct_sound(void);
 void wrong_sound(void);
-/* --- Quiz data and helpers (file scope) --- */
-#define NUM_QUESTIONS 3
-/* --- Add your Questions here --- */
-
-const char *questions[NUM_QUESTIONS] = {
-   "How many bones  do humans have?",
-   "Currency of the Philippines is?",
-   "  What is the   capital of Japan?"
-};
-/* --- Add your Answers here --- */
-/* Acceptable answer variants (lowercase) */
-const char *answers_variants[NUM_QUESTIONS][3] = {
-   { "206", "206 bones", NULL },
-   { "philippine peso", "peso", "php" },
-   { "tokyo", NULL, NULL }
-};
-uint8_t rx_buffer[32];
-int q_index = 0;
-/* Score tracking */
-int score = 0;
-/* trim leading/trailing whitespace */
-static void str_trim(char *s)
-{
-   char *p = s;
-   while (*p && isspace((unsigned char)*p)) p++;
-   if (p != s) memmove(s, p, strlen(p) + 1);
-   size_t len = strlen(s);
-   while (len > 0 && isspace((unsigned char)s[len - 1])) {
-       s[len - 1] = '\0';
-       len--;
-   }
-}
-/* lowercase in-place */
-static void str_tolower_inplace(char *s)
+void round_complete_sound(void);
+/* --- Quiz data (file scope) --- */
+/* Questions and accepted answers live in questions.txt; run
+   tools/qbank_pack.py to regenerate the packed bank. qstore walks through
+   it (internal flash, SPI NOR or SD card, see qstore.h) and prefetches the
+   next question while the current one is being answered. */
+#define NUM_QUESTIONS qstore_count()
+char rx_buffer[UART_LINE_MAX];
+/* Score tracking, one entry per player (just [0] without BUZZ_IN) */
+int score[NUM_PLAYERS];
+/* Quiz state machine, advanced by quiz_task() */
+typedef enum {
+   QUIZ_SHOW_QUESTION,
+   QUIZ_AWAIT_ANSWER,
+   QUIZ_FEEDBACK,
+   QUIZ_ROUND_SUMMARY
+} quiz_state_t;
+static quiz_state_t quiz_state = QUIZ_SHOW_QUESTION;
+static uint32_t state_until = 0;   /* HAL tick when a timed state ends */
+static uint8_t q_page = 0;         /* page of the question on screen */
+static uint8_t q_pages = 1;
+static uint32_t page_until = 0;
+static uint8_t resp_armed = 0;     /* question drawn, waiting for its flush to land */
+static uint8_t resp_running = 0;   /* question visible, response timer running */
+static uint32_t resp_shown = 0;    /* STAMP_NOW() when the question was queued */
+static uint32_t resp_start = 0;    /* stamp when it was on the LCD */
+static uint8_t summary_times = 0;  /* round summary: times page still to show */
+/* Feedback icons (5x8 CGRAM glyphs, see lcd_glyph_register) */
+static const uint8_t glyph_check_bits[8] = { 0x00, 0x01, 0x03, 0x16, 0x1C, 0x08, 0x00, 0x00 };
+static const uint8_t glyph_cross_bits[8] = { 0x00, 0x1B, 0x0E, 0x04, 0x0E, 0x1B, 0x00, 0x00 };
+static int glyph_check = 0;
+static int glyph_cross = 0;
+static lcd_t *lcd_q = NULL;        /* question display */
+static lcd_t *lcd_sb = NULL;       /* scoreboard, NULL if not fitted */
+#if BUZZ_IN
+static int buzz_floor = -1;        /* player answering aloud (button), -1 = none */
+#endif
+static uint16_t led_on_pin = 0;    /* feedback LED currently lit (0 = none) */
+static uint32_t led_off_at = 0;
+/* LCD pages a question takes (the packer lays out whole pages) */
+static uint8_t question_pages(const qstore_item_t *it)
 {
-   for (; *s; ++s) *s = (char)tolower((unsigned char)*s);
+   if (!it->num_lines || qstore_cols() != LCD_COLS) return 1;
+   return (uint8_t)((it->num_lines + LCD_ROWS - 1) / LCD_ROWS);
 }
-/* check answer variants */
-static int is_answer_correct(const char *user_in, int idx)
+/* Draw one page of a question: a straight copy of its pre-wrapped rows when
+   the bank was packed for this display, otherwise split the raw text. */
+static void show_question_page(const qstore_item_t *it, uint8_t page)
 {
-   char tmp[64];
-   strncpy(tmp, user_in, sizeof(tmp) - 1);
-   tmp[sizeof(tmp) - 1] = '\0';
-   str_trim(tmp);
-   str_tolower_inplace(tmp);
-   for (int i = 0; i < 3; ++i) {
-       const char *cand = answers_variants[idx][i];
-       if (cand == NULL) break;
-       if (strcasecmp(tmp, cand) == 0) return 1;
+   if (it->num_lines && qstore_cols() == LCD_COLS) {
+       uint16_t first = (uint16_t)page * LCD_ROWS;
+       lcd_fb_clear(lcd_q);
+       for (uint8_t r = 0; r < LCD_ROWS && first + r < it->num_lines; ++r) {
+           lcd_fb_write_row(lcd_q, r, it->rows + (size_t)(first + r) * LCD_COLS);
+       }
+   } else {
+       lcd_fb_show_wrapped(lcd_q, it->text);
    }
-   return 0;
+   /* lcd_task sends only the diff */
 }
-/* show final round score centered on second line (row 1) */
-static void show_final_score_and_reset(void)
+/* Two lines, each centered if it fits */
+static void show_centered(const char *line1, const char *line2)
 {
-   char line1[LCD_COLS + 1];
-   char line2[LCD_COLS + 1];
-   snprintf(line1, sizeof(line1), "Round complete");
-   snprintf(line2, sizeof(line2), "Score: %d/%d", score, NUM_QUESTIONS);
-   /* center both lines if they fit */
    char buf1[LCD_COLS + 1], buf2[LCD_COLS + 1];
    memset(buf1, ' ', LCD_COLS); buf1[LCD_COLS] = '\0';
    memset(buf2, ' ', LCD_COLS); buf2[LCD_COLS] = '\0';
@@ -103,105 +202,783 @@ static void show_final_score_and_reset(void)
    if (n2 > (size_t)LCD_COLS) n2 = LCD_COLS;
    memcpy(buf1 + pad1, line1, n1);
    memcpy(buf2 + pad2, line2, n2);
-   lcd_clear();
-   lcd_put_cur(0, 0);
-   lcd_send_string(buf1);
-   lcd_put_cur(1, 0);
-   lcd_send_string(buf2);
-   HAL_Delay(3000); /* show final score for 3 seconds */
-   /* reset for next round */
-   score = 0;
+   lcd_fb_clear(lcd_q);
+   lcd_fb_write(lcd_q, 0, 0, buf1);
+   lcd_fb_write(lcd_q, 1, 0, buf2);
+}
+/* show final round score centered on second line (row 1) */
+static void show_final_score_and_reset(void)
+{
+   char line1[LCD_COLS + 1];
+   char line2[LCD_COLS + 1];
+   resp_summary_t rs;
+   snprintf(line1, sizeof(line1), "Round complete");
+#if BUZZ_IN
+   /* "1:3 2:0 3:5 4:1" */
+   size_t at = 0;
+   line2[0] = '\0';
+   for (uint8_t p = 0; p < buzzin_players() && at < sizeof(line2); ++p) {
+       at += (size_t)snprintf(line2 + at, sizeof(line2) - at, p ? " %u:%d" : "%u:%d",
+                              (unsigned)(p + 1), score[p]);
+   }
+#elif SPEED_SCORING
+   snprintf(line2, sizeof(line2), "Score: %d pts", score[0]);
+#else
+   snprintf(line2, sizeof(line2), "Score: %d/%d", score[0], NUM_QUESTIONS);
+#endif
+   show_centered(line1, line2);
+   round_complete_sound();
+   /* keep the round in the flash log (this is where a sector switch, if one
+      is due, stalls for its erase), then the score can be reset */
+#if BUZZ_IN
+   flog_round_end(score, buzzin_players(), (uint16_t)NUM_QUESTIONS);
+#else
+   flog_round_end(score, 1, (uint16_t)NUM_QUESTIONS);
+#endif
+   memset(score, 0, sizeof(score));
+
+   /* response times: console now, LCD page after the score */
+   summary_times = (uint8_t)resp_summary(&rs);
+   if (summary_times) {
+       console_printf("round: %u answers, min %lu ms, mean %lu ms, p95 %lu ms\r\n",
+                      (unsigned)rs.count, (unsigned long)rs.min_ms,
+                      (unsigned long)rs.mean_ms, (unsigned long)rs.p95_ms);
+   }
+}
+/* Second summary page: "min 1.2 avg 2.5" / "p95 4.8s (n=10)" */
+static void show_round_times(void)
+{
+   char line1[LCD_COLS + 1];
+   char line2[LCD_COLS + 1];
+   resp_summary_t rs;
+   resp_summary(&rs);
+   snprintf(line1, sizeof(line1), "min %lu.%lu avg %lu.%lu",
+            (unsigned long)(rs.min_ms / 1000U), (unsigned long)(rs.min_ms % 1000U / 100U),
+            (unsigned long)(rs.mean_ms / 1000U), (unsigned long)(rs.mean_ms % 1000U / 100U));
+   snprintf(line2, sizeof(line2), "p95 %lu.%lus (n=%u)",
+            (unsigned long)(rs.p95_ms / 1000U), (unsigned long)(rs.p95_ms % 1000U / 100U),
+            (unsigned)rs.count);
+   show_centered(line1, line2);
+   resp_reset();
+}
+/* Scoreboard: running score and question number (drawn by lcd_task) */
+static void scoreboard_show(uint16_t q)
+{
+   char line[LCD_MAX_COLS + 1];
+   if (!lcd_sb) return;
+   lcd_fb_clear(lcd_sb);
+#if BUZZ_IN
+   size_t at = 0;
+   line[0] = '\0';
+   for (uint8_t p = 0; p < buzzin_players() && at < sizeof(line); ++p) {
+       at += (size_t)snprintf(line + at, sizeof(line) - at, p ? " %u:%d" : "%u:%d",
+                              (unsigned)(p + 1), score[p]);
+   }
+#else
+   snprintf(line, sizeof(line), "Score %d", score[0]);
+#endif
+   lcd_fb_write(lcd_sb, 0, 0, line);
+   snprintf(line, sizeof(line), "Question %u/%u", (unsigned)(q + 1), (unsigned)NUM_QUESTIONS);
+   lcd_fb_write(lcd_sb, 1, 0, line);
+}
+/* --- tasks (run by the cooperative scheduler, must never block) --- */
+static int tick_reached(uint32_t t)
+{
+   return (int32_t)(HAL_GetTick() - t) >= 0;
+}
+/* Light one feedback LED for ms (common-anode: RESET = ON) */
+static void led_flash(uint16_t pin, uint32_t ms)
+{
+   HAL_GPIO_WritePin(LED_PORT, LED_R_PIN | LED_B_PIN | LED_G_PIN, GPIO_PIN_SET);
+   HAL_GPIO_WritePin(LED_PORT, pin, GPIO_PIN_RESET);
+   led_on_pin = pin;
+   led_off_at = HAL_GetTick() + ms;
+}
+static void led_task(void)
+{
+   if (led_on_pin && tick_reached(led_off_at)) {
+       HAL_GPIO_WritePin(LED_PORT, led_on_pin, GPIO_PIN_SET);
+       led_on_pin = 0;
+   }
+}
+/* Response timer. The question is flushed straight after drawing; the
+   timer starts at the stamp the I2C completion ISR took when that flush
+   finished, i.e. when the question became readable. */
+static void resp_arm(void)
+{
+   lcd_flush(lcd_q);
+   resp_shown = STAMP_NOW();
+   resp_armed = 1;
+   resp_running = 0;
+}
+static void resp_poll(void)
+{
+   if (!resp_armed || !lcd_is_idle(lcd_q)) return;
+   resp_start = lcd_done_stamp(lcd_q);
+   /* nothing was sent (screen already matched): visible since it was queued */
+   if ((int32_t)(resp_start - resp_shown) < 0) resp_start = resp_shown;
+   resp_armed = 0;
+   resp_running = 1;
+   PROBE_MARK(PROBE_MARK_FIRST_QUESTION);
+}
+/* Stop at an answer's stamp and record the sample. Returns the response
+   time in ms, or -1 if the question had not even reached the LCD. */
+static int32_t resp_stop(uint32_t stamp)
+{
+   resp_poll();
+   if (!resp_running) return -1;
+   resp_running = 0;
+   int32_t d = (int32_t)(stamp - resp_start);
+   uint32_t ms = d > 0 ? (uint32_t)d / STAMPS_PER_MS : 0;
+   resp_add(ms);
+   return (int32_t)ms;
+}
+/* Points for a correct answer after ms (-1 = not timed) */
+static int answer_points(int32_t ms)
+{
+#if SPEED_SCORING
+   if (ms < 0 || ms >= SPEED_WINDOW_MS) return SPEED_POINTS;
+   return SPEED_POINTS + (int)((int32_t)SPEED_BONUS * (SPEED_WINDOW_MS - ms) / SPEED_WINDOW_MS);
+#else
+   (void)ms;
+   return 1;
+#endif
+}
+/* Start a strip effect (nothing without LED_STRIP) */
+static void strip_play(ledfx_effect_t fx, uint32_t ms)
+{
+#if LED_STRIP
+   ledfx_play(fx, ms);
+#else
+   (void)fx;
+   (void)ms;
+#endif
+}
+static void lcd_task(void)
+{
+   lcd_flush_all(); /* only changed cells are queued; returns at once */
+}
+/* "Correct!"/"Wrong!" screen, LED and sound, then on to FEEDBACK */
+static void show_feedback(int correct, const char *text)
+{
+   char icon[2] = { ' ', '\0' };
+   lcd_fb_clear(lcd_q);
+   lcd_fb_write(lcd_q, 0, 0, text);
+   if (correct) {
+       icon[0] = LCD_GLYPH(glyph_check);
+       led_flash(LED_B_PIN, FEEDBACK_MS);
+       strip_play(LEDFX_SWEEP, FEEDBACK_MS);
+       correct_sound();
+   } else {
+       icon[0] = LCD_GLYPH(glyph_cross);
+       led_flash(LED_R_PIN, FEEDBACK_MS);
+       strip_play(LEDFX_PULSE, FEEDBACK_MS);
+       wrong_sound();
+   }
+   lcd_fb_write(lcd_q, 0, LCD_COLS - 1, icon);
+   scoreboard_show(qstore_current()->q);
+   quiz_state = QUIZ_FEEDBACK;
+   state_until = HAL_GetTick() + FEEDBACK_MS;
+}
+static void answer_received(const char *line, uint32_t stamp)
+{
+   int32_t ms = resp_stop(stamp);
+   int correct = answer_check(line, qstore_current());
+   if (correct) score[0] += answer_points(ms);
+   flog_answer(qstore_current()->q, 0, (uint8_t)correct, ms < 0 ? FLOG_NO_TIME : (uint32_t)ms);
+   show_feedback(correct, correct ? "Correct!" : "Wrong!");
+}
+#if BUZZ_IN
+/* Hand the contestants' answer lines (stamped by uart_rx) to the arbiter,
+   then act on its verdict. Only runs while an answer is expected. */
+static void buzz_poll(void)
+{
+   const qstore_item_t *it = qstore_current();
+   char line[UART_LINE_MAX];
+   char text[LCD_COLS + 1];
+   uint32_t stamp;
+   uint8_t p;
+   for (p = 0; p < buzzin_players(); ++p) {
+       int port = buzzin_rx_port(p);
+       if (port < 0) continue;
+       while (uart_rx_get_line_port((uint8_t)port, line, sizeof(line), &stamp) >= 0) {
+           buzzin_answer(p, stamp, answer_check(line, it));
+       }
+   }
+   switch (buzzin_task(&p)) {
+   case BUZZIN_WAITING:
+       if (buzz_floor >= 0) {
+           /* the player with the floor was wrong: back to the question */
+           buzz_floor = -1;
+           show_question_page(it, q_page);
+       }
+       break;
+   case BUZZIN_FLOOR:
+       if (buzz_floor != p) {
+           buzz_floor = p;
+           snprintf(text, sizeof(text), "Player %u?", (unsigned)(p + 1));
+           lcd_fb_clear(lcd_q);
+           lcd_fb_write(lcd_q, 0, 0, text);
+       }
+       break;
+   case BUZZIN_WON: {
+       buzz_floor = -1;
+       int32_t ms = resp_stop(buzzin_stamp(p));
+       score[p] += answer_points(ms);
+       flog_answer(it->q, p, 1, ms < 0 ? FLOG_NO_TIME : (uint32_t)ms);
+       snprintf(text, sizeof(text), "Player %u!", (unsigned)(p + 1));
+       show_feedback(1, text);
+       break;
+   }
+   case BUZZIN_ALL_OUT:
+       buzz_floor = -1;
+       flog_answer(it->q, FLOG_NO_PLAYER, 0, FLOG_NO_TIME);
+       resp_armed = 0;
+       resp_running = 0;
+       show_feedback(0, "Nobody got it");
+       break;
+   }
+}
+#endif
+/* Baud rate a PROTO_T_BAUD request asked for, applied once its reply is out */
+static uint32_t baud_pending = 0;
+static void baud_switch(void)
+{
+   if (!baud_pending || console_tx_free() != CONSOLE_TX_SIZE - 1) return;
+   HAL_UART_DeInit(&huart1);
+   huart1.Init.BaudRate = baud_pending;
+   baud_pending = 0;
+   if (HAL_UART_Init(&huart1) != HAL_OK) { Error_Handler(); }
+   uart_rx_start(&huart1); /* same port, hook kept */
+}
+/* '!' commands are handled in any state. Answers are only taken while one
+   is expected; anything typed ahead stays queued in uart_rx. */
+static void uart_task(void)
+{
+   uint32_t stamp;
+   baud_switch();
+   /* answers sent as frames (proto.h) count as typed */
+   if (quiz_state == QUIZ_AWAIT_ANSWER && proto_get_answer(rx_buffer, sizeof(rx_buffer)) >= 0) {
+#if BUZZ_IN
+       buzzin_rule(answer_check(rx_buffer, qstore_current()));
+#else
+       answer_received(rx_buffer, STAMP_NOW());
+#endif
+       return;
+   }
+   int first = uart_rx_peek_first();
+   if (first < 0) return;
+   if (first != '!' && quiz_state != QUIZ_AWAIT_ANSWER) return;
+   if (uart_rx_get_line_port(0, rx_buffer, sizeof(rx_buffer), &stamp) < 0) return;
+   if (console_handle_line(rx_buffer)) return;
+#if BUZZ_IN
+   /* quizmaster's verdict line for a button player: what they said aloud */
+   buzzin_rule(answer_check(rx_buffer, qstore_current()));
+#else
+   answer_received(rx_buffer, stamp);
+#endif
+}
+/* !power - time spent in SLEEP vs. uptime */
+static void cmd_power(const char *args)
+{
+   (void)args;
+   uint32_t up = power_uptime_ms();
+   uint32_t slept = power_sleep_ms();
+   uint32_t pct = up ? (uint32_t)((uint64_t)slept * 100U / up) : 0;
+   console_printf("up %lu ms, asleep %lu ms (%lu%%)\r\n",
+                  (unsigned long)up, (unsigned long)slept, (unsigned long)pct);
+}
+/* !stats - hot-path cycle counts and LCD bus traffic; "!stats reset" clears */
+static void stats_lcd(const char *name, const lcd_t *d)
+{
+   if (!d) return;
+   console_printf("%s: %lu kHz, %lu xfers, %lu bytes, %lu errors, %lu recoveries\r\n", name,
+                  (unsigned long)(lcd_bus_hz(d) / 1000), (unsigned long)lcd_xfers(d),
+                  (unsigned long)lcd_bytes(d), (unsigned long)lcd_errors(d),
+                  (unsigned long)lcd_bus_recoveries(d));
+}
+static void cmd_stats(const char *args)
+{
+   if (args && strncmp(args, "reset", 5) == 0) {
+       probe_reset();
+       console_printf("probes cleared\r\n");
+       return;
+   }
+#if PROBE_ENABLE
+   console_printf("probe            count      min     mean      max  (cycles @ %lu MHz)\r\n",
+                  (unsigned long)(SystemCoreClock / 1000000UL));
+   for (probe_id_t id = 0; id < PROBE_COUNT; ++id) {
+       probe_stat_t p;
+       probe_get(id, &p);
+       uint32_t mean = p.count ? (uint32_t)(p.total / p.count) : 0;
+       console_printf("%-15s %7lu %8lu %8lu %8lu\r\n", probe_name(id),
+                      (unsigned long)p.count, (unsigned long)p.min,
+                      (unsigned long)mean, (unsigned long)p.max);
+   }
+#else
+   console_printf("probes disabled (PROBE_ENABLE 0)\r\n");
+#endif
+   console_printf("boot: setup done %lu us, first question %lu us\r\n",
+                  (unsigned long)probe_mark_us(PROBE_MARK_SETUP_DONE),
+                  (unsigned long)probe_mark_us(PROBE_MARK_FIRST_QUESTION));
+   stats_lcd("lcd", lcd_q);
+   stats_lcd("scoreboard", lcd_sb);
+}
+/* !log - flash log summary; "!log dump" exports every record as CSV,
+   "!log stats" per-question accuracy and mean response time. Both are
+   printed by log_task a line at a time while the console ring has room,
+   so neither blocks the quiz. */
+typedef enum { LOG_IDLE, LOG_DUMP, LOG_STATS } log_out_t;
+static log_out_t log_out = LOG_IDLE;
+static flog_cursor_t log_cur;
+static uint16_t log_q;
+static void cmd_log(const char *args)
+{
+   if (log_out != LOG_IDLE) {
+       console_printf("log: busy\r\n");
+       return;
+   }
+   if (args && strncmp(args, "dump", 4) == 0) {
+       flog_flush();
+       flog_read_start(&log_cur);
+       log_out = LOG_DUMP;
+       console_printf("type,round,q|player,player|score,correct|questions,ms\r\n");
+       return;
+   }
+   if (args && strncmp(args, "stats", 5) == 0) {
+       flog_flush();
+       flog_totals_build();
+       log_q = 0;
+       log_out = LOG_STATS;
+       return;
+   }
+   console_printf("log: round %lu, %lu/%lu records, sector pass %lu, %lu errors\r\n",
+                  (unsigned long)flog_round_no(), (unsigned long)flog_records(),
+                  (unsigned long)flog_capacity(), (unsigned long)flog_seq(),
+                  (unsigned long)flog_errors());
+}
+static void log_task(void)
+{
+   flog_rec_t r;
+   flog_total_t t;
+   while (log_out != LOG_IDLE && console_tx_free() >= 96) {
+       if (log_out == LOG_DUMP) {
+           if (!flog_read(&log_cur, &r)) {
+               console_printf("end\r\n");
+               log_out = LOG_IDLE;
+           } else if (r.type == FLOG_T_ANSWER) {
+               char ms[12] = "-";
+               if (r.b != FLOG_NO_TIME) snprintf(ms, sizeof(ms), "%lu", (unsigned long)r.b);
+               console_printf("A,%lu,%u,%u,%u,%s\r\n", (unsigned long)r.a, (unsigned)r.q,
+                              (unsigned)(r.c >> 8), (unsigned)(r.c & 1), ms);
+           } else if (r.type == FLOG_T_ROUND) {
+               console_printf("R,%lu,%u,%ld,%u\r\n", (unsigned long)r.a, (unsigned)r.q,
+                              (long)(int32_t)r.b, (unsigned)r.c);
+           } else if (r.type == FLOG_T_TOTAL) {
+               console_printf("T,%u,%lu,%lu,%u,%lu\r\n", (unsigned)r.q,
+                              (unsigned long)(r.a & 0xFFFF), (unsigned long)(r.a >> 16),
+                              (unsigned)r.c, (unsigned long)r.b);
+           }
+       } else {
+           if (log_q >= FLOG_MAX_Q) {
+               console_printf("end\r\n");
+               log_out = LOG_IDLE;
+               break;
+           }
+           uint16_t q = log_q++;
+           flog_total(q, &t);
+           if (!t.asked) continue;
+           console_printf("q%u: %lu/%lu correct (%lu%%), mean %lu ms\r\n", (unsigned)q,
+                          (unsigned long)t.correct, (unsigned long)t.asked,
+                          (unsigned long)(t.correct * 100U / t.asked),
+                          (unsigned long)(t.timed ? t.ms_sum / t.timed : 0));
+       }
+   }
+}
+/* --- binary protocol requests (proto.h); answers and ping are built in --- */
+static void req_baud(const uint8_t *p, uint16_t len)
+{
+   uint32_t baud = len >= 4 ? proto_u32(p) : 0;
+   if (baud < 1200 || baud > HAL_RCC_GetPCLK2Freq() / 16U) {
+       proto_reply(PROTO_T_BAUD, PROTO_E_LEN, NULL, 0);
+       return;
+   }
+   proto_reply(PROTO_T_BAUD, PROTO_OK, NULL, 0);
+   baud_pending = baud;
+}
+/* Verdicts for any question of the linked bank; the streamed backends
+   only have the current question loaded */
+static void req_check(const uint8_t *p, uint16_t len)
+{
+   uint8_t out[PROTO_MAX_PAYLOAD - 1];
+   char text[UART_LINE_MAX];
+   uint16_t at = 0, n = 0;
+   uint8_t status = PROTO_OK;
+   const qstore_item_t *it = qstore_current();
+   while (at < len && 2U + n < sizeof(out)) {
+       if (at + 3U > len || at + 3U + p[at + 2] > len) {
+           status = PROTO_E_LEN;
+           break;
+       }
+       uint16_t q = proto_u16(&p[at]);
+       uint8_t tl = p[at + 2];
+       uint8_t keep = tl < sizeof(text) - 1 ? tl : (uint8_t)(sizeof(text) - 1);
+       memcpy(text, &p[at + 3], keep);
+       text[keep] = '\0';
+#if QSTORE_BACKEND == QSTORE_BACKEND_INTERNAL
+       (void)it;
+       out[2 + n] = q >= qstore_count() ? PROTO_UNCHECKED
+                                        : (answer_is_correct(text, q) ? PROTO_RIGHT : PROTO_WRONG);
+#else
+       out[2 + n] = (it && it->q == q) ? (answer_check(text, it) ? PROTO_RIGHT : PROTO_WRONG)
+                                       : PROTO_UNCHECKED;
+#endif
+       n++;
+       at = (uint16_t)(at + 3 + tl);
+   }
+   out[0] = (uint8_t)n;
+   out[1] = (uint8_t)(n >> 8);
+   proto_reply(PROTO_T_CHECK, status, out, (uint16_t)(2 + n));
+}
+/* Bank upload: the quiz waits on the question screen until the new bank is
+   in, then starts over at question 0 */
+static void req_bank_begin(const uint8_t *p, uint16_t len)
+{
+#if QSTORE_BACKEND == QSTORE_BACKEND_INTERNAL
+   (void)p;
+   (void)len;
+   proto_reply(PROTO_T_BANK_BEGIN, PROTO_E_UNSUPPORTED, NULL, 0); /* linked into the image */
+#else
+   if (len < 4) {
+       proto_reply(PROTO_T_BANK_BEGIN, PROTO_E_LEN, NULL, 0);
+       return;
+   }
+   quiz_state = QUIZ_SHOW_QUESTION;
+   state_until = HAL_GetTick();
+   resp_armed = 0;
+   resp_running = 0;
+   memset(score, 0, sizeof(score));
+   show_centered("Loading bank", "");
+   int rc = qstore_upload_begin(proto_u32(p));
+   proto_reply(PROTO_T_BANK_BEGIN, rc == 0 ? PROTO_OK : PROTO_E_FAIL, NULL, 0);
+#endif
+}
+static void req_bank_data(const uint8_t *p, uint16_t len)
+{
+   if (len < 4) {
+       proto_reply(PROTO_T_BANK_DATA, PROTO_E_LEN, NULL, 0);
+       return;
+   }
+   int rc = qstore_upload_write(proto_u32(p), p + 4, (uint16_t)(len - 4));
+   proto_reply(PROTO_T_BANK_DATA, rc == 0 ? PROTO_OK : PROTO_E_FAIL, NULL, 0);
+}
+static void req_bank_end(const uint8_t *p, uint16_t len)
+{
+   (void)p;
+   (void)len;
+   int rc = qstore_upload_end();
+   if (rc != 0) show_centered("Bad quiz bank", "");
+   proto_reply(PROTO_T_BANK_END, rc == 0 ? PROTO_OK : PROTO_E_FAIL, NULL, 0);
+}
+/* Counters, all u32: uptime ms, round, log records, log errors, UART lines
+   dropped, frames, frame CRC errors, frames dropped, prefetch misses, LCD
+   errors, LCD bus Hz, current question, then one score per player */
+static void req_stats(const uint8_t *p, uint16_t len)
+{
+   (void)p;
+   (void)len;
+   uint8_t out[12 * 4 + NUM_PLAYERS * 4];
+   uint8_t *o = out;
+   const qstore_item_t *it = qstore_current();
+   o = proto_put32(o, HAL_GetTick());
+   o = proto_put32(o, flog_round_no());
+   o = proto_put32(o, flog_records());
+   o = proto_put32(o, flog_errors());
+   o = proto_put32(o, uart_rx_dropped());
+   o = proto_put32(o, proto_frames());
+   o = proto_put32(o, proto_crc_errors());
+   o = proto_put32(o, proto_dropped());
+   o = proto_put32(o, qstore_misses());
+   o = proto_put32(o, lcd_errors(lcd_q));
+   o = proto_put32(o, lcd_bus_hz(lcd_q));
+   o = proto_put32(o, it ? it->q : 0xFFFFFFFFUL);
+   for (uint8_t i = 0; i < NUM_PLAYERS; ++i) o = proto_put32(o, (uint32_t)score[i]);
+   proto_reply(PROTO_T_STATS, PROTO_OK, out, (uint16_t)(o - out));
+}
+/* Per-question history from the flash log, as many as fit in one frame */
+static void req_totals(const uint8_t *p, uint16_t len)
+{
+   uint8_t out[PROTO_MAX_PAYLOAD - 1];
+   if (len < 3) {
+       proto_reply(PROTO_T_TOTALS, PROTO_E_LEN, NULL, 0);
+       return;
+   }
+   uint16_t first = proto_u16(p);
+   uint8_t n = p[2];
+   if (n > (sizeof(out) - 3) / 16) n = (uint8_t)((sizeof(out) - 3) / 16);
+   flog_flush();
+   flog_totals_build();
+   out[0] = (uint8_t)first;
+   out[1] = (uint8_t)(first >> 8);
+   out[2] = n;
+   uint8_t *o = &out[3];
+   for (uint8_t i = 0; i < n; ++i) {
+       flog_total_t t;
+       flog_total((uint16_t)(first + i), &t);
+       o = proto_put32(o, t.asked);
+       o = proto_put32(o, t.correct);
+       o = proto_put32(o, t.timed);
+       o = proto_put32(o, t.ms_sum);
+   }
+   proto_reply(PROTO_T_TOTALS, PROTO_OK, out, (uint16_t)(o - out));
+}
+/* Remote LCD and LED: drawn into the framebuffer like the quiz's own text,
+   so the next quiz screen replaces it */
+static void req_lcd_text(const uint8_t *p, uint16_t len)
+{
+   char text[LCD_COLS + 1];
+   if (len < 2 || p[0] >= LCD_ROWS || p[1] >= LCD_COLS) {
+       proto_reply(PROTO_T_LCD_TEXT, PROTO_E_LEN, NULL, 0);
+       return;
+   }
+   uint16_t n = (uint16_t)(len - 2);
+   if (n > LCD_COLS) n = LCD_COLS;
+   memcpy(text, p + 2, n);
+   text[n] = '\0';
+   lcd_fb_write(lcd_q, p[0], p[1], text);
+   proto_reply(PROTO_T_LCD_TEXT, PROTO_OK, NULL, 0);
+}
+static void req_lcd_clear(const uint8_t *p, uint16_t len)
+{
+   (void)p;
+   (void)len;
+   lcd_fb_clear(lcd_q);
+   proto_reply(PROTO_T_LCD_CLEAR, PROTO_OK, NULL, 0);
+}
+static void req_led(const uint8_t *p, uint16_t len)
+{
+   if (len < 3) {
+       proto_reply(PROTO_T_LED, PROTO_E_LEN, NULL, 0);
+       return;
+   }
+   uint16_t pins = (uint16_t)(((p[0] & 1U) ? LED_R_PIN : 0) | ((p[0] & 2U) ? LED_G_PIN : 0) |
+                              ((p[0] & 4U) ? LED_B_PIN : 0));
+   led_flash(pins, proto_u16(&p[1]));
+   proto_reply(PROTO_T_LED, PROTO_OK, NULL, 0);
+}
+static void quiz_task(void)
+{
+   switch (quiz_state) {
+   case QUIZ_SHOW_QUESTION: {
+       if (!tick_reached(state_until)) break;
+       if (!lcd_init_poll(lcd_q)) break; /* still coming up after reset */
+       const qstore_item_t *it = qstore_current();
+       if (!it) break; /* still being read from storage */
+       q_page = 0;
+       q_pages = question_pages(it);
+       page_until = HAL_GetTick() + PAGE_MS;
+       show_question_page(it, 0);
+       resp_arm();
+       strip_play(LEDFX_COUNTDOWN, SPEED_WINDOW_MS); /* the speed bonus window */
+       scoreboard_show(it->q);
+#if BUZZ_IN
+       buzzin_open();
+#endif
+       quiz_state = QUIZ_AWAIT_ANSWER;
+       break;
+   }
+   case QUIZ_AWAIT_ANSWER:
+       resp_poll();
+#if BUZZ_IN
+       buzz_poll();
+       if (quiz_state != QUIZ_AWAIT_ANSWER || buzz_floor >= 0) break;
+#endif
+       /* uart_task moves us on; long questions flip through their pages */
+       if (q_pages > 1 && tick_reached(page_until)) {
+           q_page = (uint8_t)((q_page + 1) % q_pages);
+           page_until += PAGE_MS;
+           show_question_page(qstore_current(), q_page);
+       }
+       break;
+   case QUIZ_FEEDBACK:
+       if (!tick_reached(state_until)) break;
+       if (qstore_next()) {
+           /* completed a round (wrapped back to 0): show final score */
+           show_final_score_and_reset();
+           quiz_state = QUIZ_ROUND_SUMMARY;
+           state_until = HAL_GetTick() + SUMMARY_MS;
+       } else {
+           quiz_state = QUIZ_SHOW_QUESTION;
+           state_until = HAL_GetTick() + SETTLE_MS;
+       }
+       break;
+   case QUIZ_ROUND_SUMMARY:
+       if (!tick_reached(state_until)) break;
+       if (summary_times) {
+           summary_times = 0;
+           show_round_times();
+           state_until = HAL_GetTick() + SUMMARY_MS;
+           break;
+       }
+       quiz_state = QUIZ_SHOW_QUESTION;
+       state_until = HAL_GetTick() + SETTLE_MS;
+       break;
+   }
 }
 /* --- main --- */
 int main(void)
 {
    HAL_Init();
    SystemClock_Config();
+   delay_init();
+   PROBE_MARK(PROBE_MARK_START);
    MX_GPIO_Init();
-   MX_USART1_UART_Init();
+   /* Ensure LEDs are OFF at startup (common-anode -> HIGH = off) */
+   HAL_GPIO_WritePin(LED_PORT, LED_R_PIN | LED_B_PIN | LED_G_PIN, GPIO_PIN_SET);
+   MX_DMA_Init();
    MX_I2C1_Init();
-   /* LCD init (I2C character) */
-   lcd_init(&hi2c1, 0x27);
-   lcd_backlight_on();
-   lcd_clear();
+   /* LCD: only claimed here. lcd_init_poll() (quiz_task, lcd_task) brings it
+      up once its power-up time since reset has passed, so the wait runs
+      alongside the set-up below instead of before it. */
+   lcd_q = lcd_init_start(&hi2c1, LCD_ADDR, LCD_COLS, LCD_ROWS);
+   MX_USART1_UART_Init();
+   uart_rx_start(&huart1); /* answers are buffered from here on, even while we draw/beep */
+   console_init(&huart1);
+   proto_init(console_write); /* binary frames share the TX ring with the console */
+   uart_rx_set_hook(0, proto_rx_byte);
+   proto_register(PROTO_T_BAUD, req_baud);
+   proto_register(PROTO_T_CHECK, req_check);
+   proto_register(PROTO_T_BANK_BEGIN, req_bank_begin);
+   proto_register(PROTO_T_BANK_DATA, req_bank_data);
+   proto_register(PROTO_T_BANK_END, req_bank_end);
+   proto_register(PROTO_T_STATS, req_stats);
+   proto_register(PROTO_T_TOTALS, req_totals);
+   proto_register(PROTO_T_LCD_TEXT, req_lcd_text);
+   proto_register(PROTO_T_LCD_CLEAR, req_lcd_clear);
+   proto_register(PROTO_T_LED, req_led);
+   console_register("power", cmd_power);
+   console_register("stats", cmd_stats);
+   console_register("log", cmd_log);
+   MX_TIM1_Init();
+   buzzer_init(&htim1, BUZZER_TIM_CHANNEL, 1);
+   MX_TIM7_Init();
+   HAL_TIM_Base_Start_IT(&htim7); /* 1 ms audio sequencer tick */
+#if LED_STRIP
+#if WS2812B_BACKEND == WS2812B_BACKEND_TIMER
+   MX_TIM3_Init();
+   ws2812b_init(&htim3, TIM_CHANNEL_4);
+#elif WS2812B_BACKEND == WS2812B_BACKEND_BITBANG
+   ws2812b_init(); /* blocks for each frame with interrupts off */
+#else
+#error "LED_STRIP: configure the SPI and call ws2812b_init() here"
+#endif
+   ledfx_init();
+#endif
+#if BUZZ_IN
+   MX_TIM2_Init();
+   buzzin_init(&htim2);
+   uart_rx_set_clock(buzzin_now_us); /* answer lines stamped in the UART ISRs */
+   lcd_set_clock(buzzin_now_us);     /* ... and LCD flush completions, same clock */
+   MX_USART2_UART_Init();
+   MX_USART6_UART_Init();
+   buzzin_add_uart((uint8_t)uart_rx_start(&huart2));
+   buzzin_add_uart((uint8_t)uart_rx_start(&huart6));
+   buzzin_add_button(BUZZ_BTN1_PIN);
+   buzzin_add_button(BUZZ_BTN2_PIN);
+#endif
+   glyph_check = lcd_glyph_register(glyph_check_bits, 'v');
+   glyph_cross = lcd_glyph_register(glyph_cross_bits, 'x');
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+   MX_SPI2_Init();
+   if (qstore_init(&hspi2) != 0) {
+#else
+#if QSTORE_BACKEND == QSTORE_BACKEND_FATFS
+   MX_SDIO_SD_Init();
+   MX_FATFS_Init();
+#endif
+   if (qstore_init() != 0) {
+#endif
+       lcd_send_string(lcd_q, "Bad quiz bank");
+       lcd_wait_idle(lcd_q); /* Error_Handler masks the I2C interrupts */
+       Error_Handler();
+   }
+   /* score log: a blank chip is formatted here (one sector erase) */
+   if (flog_init() != 0) {
+       console_printf("flash log unavailable\r\n");
+   }
+#if SCOREBOARD_LCD
+   /* optional: only take it on if the backpack ACKs its address. The probe
+      is a blocking transfer, so the main LCD must be up and drained first;
+      this is the last set-up step, so most of its power-up has passed. */
+   lcd_wait_idle(lcd_q);
+   if (HAL_I2C_IsDeviceReady(&hi2c1, (uint16_t)(SCOREBOARD_ADDR << 1), 2, 10) == HAL_OK) {
+       lcd_sb = lcd_init_start(&hi2c1, SCOREBOARD_ADDR, 16, 2);
+   }
+#endif
+   /* the init sequence leaves both displays cleared with the backlight on */
 #if RUN_ASCII_TEST
    /* Temporary diagnostic: writes ASCII blocks so you can inspect bit mapping */
-   lcd_ascii_test();
+   lcd_ascii_test(lcd_q);
    HAL_Delay(3000);
-   lcd_clear();
+   lcd_clear(lcd_q);
 #endif
-   /* Ensure LEDs are OFF at startup (common-anode -> HIGH = off) */
-   HAL_GPIO_WritePin(LED_PORT, LED_R_PIN | LED_B_PIN | LED_G_PIN, GPIO_PIN_SET);
+   /* Everything from here on is driven by non-blocking tasks */
+   sched_add(uart_task, 1);
+   sched_add(quiz_task, 1);
+   sched_add(qstore_task, 1);
+   sched_add(led_task, 5);
+   sched_add(lcd_task, LCD_FLUSH_MS);
+   sched_add(log_task, 5);
+   sched_add(proto_task, 1);
+#if LED_STRIP
+   sched_add(ledfx_task, LEDFX_FRAME_MS); /* the eighth and last slot */
+#endif
+   quiz_state = QUIZ_SHOW_QUESTION;
+   state_until = HAL_GetTick();
+   PROBE_MARK(PROBE_MARK_SETUP_DONE);
    while (1)
    {
-       /* 1) Show the question. Use wrapped display so long text fits the module. */
-       lcd_clear();
-       lcd_show_wrapped((char*)questions[q_index]);
-       /* 2) Read user input from UART (blocking until CR/LF) */
-       memset(rx_buffer, 0, sizeof(rx_buffer));
-       int idx = 0;
-       uint8_t ch;
-       while (idx < (int)sizeof(rx_buffer) - 1) {
-           HAL_UART_Receive(&huart1, &ch, 1, HAL_MAX_DELAY);
-           if (ch == '\r' || ch == '\n') break;
-           rx_buffer[idx++] = ch;
-       }
-       rx_buffer[idx] = '\0';
-       /* 3) Check answer */
-       int correct = is_answer_correct((char*)rx_buffer, q_index);
-       /* 4) Feedback on LCD + LED + sound */
-       lcd_clear();
-       lcd_put_cur(0, 0);
-       if (correct) {
-           lcd_send_string("Correct!");
-           /* Turn RED and GREEN OFF, turn BLUE ON (common-anode: RESET = ON) */
-           HAL_GPIO_WritePin(LED_PORT, LED_R_PIN | LED_G_PIN, GPIO_PIN_SET);
-           HAL_GPIO_WritePin(LED_PORT, LED_B_PIN, GPIO_PIN_RESET);
-           correct_sound();
-           HAL_Delay(400);
-           HAL_GPIO_WritePin(LED_PORT, LED_B_PIN, GPIO_PIN_SET);
-           /* update score */
-           score++;
-       } else {
-           lcd_send_string("Wrong!");
-           HAL_GPIO_WritePin(LED_PORT, LED_G_PIN | LED_B_PIN, GPIO_PIN_SET);
-           HAL_GPIO_WritePin(LED_PORT, LED_R_PIN, GPIO_PIN_RESET);
-           wrong_sound();
-           HAL_Delay(400);
-           HAL_GPIO_WritePin(LED_PORT, LED_R_PIN, GPIO_PIN_SET);
-       }
-       /* Advance question index */
-       q_index = (q_index + 1) % NUM_QUESTIONS;
-       /* If we've completed a round (wrapped back to 0), show final score and reset */
-       if (q_index == 0) {
-           show_final_score_and_reset();
-       }
-       HAL_Delay(200);
+       sched_run();
+#if POWER_IDLE
+       /* nothing due: sleep until the next interrupt (SysTick at the latest) */
+       if (sched_next_due_ms() > 0) power_idle();
+#endif
    }
    /* unreachable */
 }
 /* ---- sounds ---- */
+/* Played by the audio sequencer from the TIM7 tick: these return at once,
+   so the next question is drawn and input accepted while they play. */
+static const audio_note_t correct_notes[] = {
+   { 2000, 450, 200 },   // first beep, gap
+   { 1000, 450, 0 }      // second beep
+};
+static const audio_note_t wrong_notes[] = {
+   { 900, 4000, 0 }
+};
+static const audio_note_t round_notes[] = {
+   { 523, 120, 30 }, { 659, 120, 30 }, { 784, 120, 30 }, { 1047, 300, 0 }
+};
+static const audio_melody_t correct_melody = { correct_notes, 2 };
+static const audio_melody_t wrong_melody = { wrong_notes, 1 };
+static const audio_melody_t round_melody = { round_notes, 4 };
+
 void correct_sound(void) {
-   play_tone(2000, 450);  // first beep
-   HAL_Delay(200);        // gap between beeps
-   play_tone(1000, 450);  // second beep
+   audio_cancel();   /* a new answer replaces any feedback still playing */
+   audio_play(&correct_melody, AUDIO_PRIO_HIGH);
 }
 void wrong_sound(void) {
-   play_tone(900, 4000);
+   audio_cancel();
+   audio_play(&wrong_melody, AUDIO_PRIO_HIGH);
 }
-/* ---- buzzer ---- */
-void play_tone(uint32_t freq, uint32_t duration_ms) {
-   if (freq == 0) {
-       HAL_Delay(duration_ms);
-       return;
-   }
-   uint32_t cycles = (freq * duration_ms) / 1000;
-   uint32_t t;
-   for (uint32_t i = 0; i < cycles; i++) {
-       HAL_GPIO_WritePin(BUZZER_PORT, BUZZER_PIN, GPIO_PIN_SET);
-       for (t = 0; t < 250; ++t) __NOP();
-       HAL_GPIO_WritePin(BUZZER_PORT, BUZZER_PIN, GPIO_PIN_RESET);
-       for (t = 0; t < 250; ++t) __NOP();
+void round_complete_sound(void) {
+   /* queued behind the feedback of the last answer */
+   audio_play(&round_melody, AUDIO_PRIO_NORMAL);
+}
+/* 1 ms tick for the audio sequencer */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
+   if (htim->Instance == TIM7) {
+       audio_tick_1ms();
    }
 }
 /* --- Peripheral stubs (kept unchanged) --- */
@@ -232,7 +1009,7 @@ void SystemClock_Config(void)
 static void MX_USART1_UART_Init(void)
 {
    huart1.Instance = USART1;
-   huart1.Init.BaudRate = 9600;
+   huart1.Init.BaudRate = QUIZ_UART_BAUD;
    huart1.Init.WordLength = UART_WORDLENGTH_8B;
    huart1.Init.StopBits = UART_STOPBITS_1;
    huart1.Init.Parity = UART_PARITY_NONE;
@@ -241,10 +1018,48 @@ static void MX_USART1_UART_Init(void)
    huart1.Init.OverSampling = UART_OVERSAMPLING_16;
    if (HAL_UART_Init(&huart1) != HAL_OK) { Error_Handler(); }
 }
+#if BUZZ_IN
+static void MX_USART2_UART_Init(void)
+{
+   huart2.Instance = USART2;
+   huart2.Init.BaudRate = QUIZ_UART_BAUD;
+   huart2.Init.WordLength = UART_WORDLENGTH_8B;
+   huart2.Init.StopBits = UART_STOPBITS_1;
+   huart2.Init.Parity = UART_PARITY_NONE;
+   huart2.Init.Mode = UART_MODE_RX;
+   huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+   huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+   if (HAL_UART_Init(&huart2) != HAL_OK) { Error_Handler(); }
+}
+static void MX_USART6_UART_Init(void)
+{
+   huart6.Instance = USART6;
+   huart6.Init.BaudRate = QUIZ_UART_BAUD;
+   huart6.Init.WordLength = UART_WORDLENGTH_8B;
+   huart6.Init.StopBits = UART_STOPBITS_1;
+   huart6.Init.Parity = UART_PARITY_NONE;
+   huart6.Init.Mode = UART_MODE_RX;
+   huart6.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+   huart6.Init.OverSampling = UART_OVERSAMPLING_16;
+   if (HAL_UART_Init(&huart6) != HAL_OK) { Error_Handler(); }
+}
+static void MX_TIM2_Init(void)
+{
+   /* 84 MHz timer clock / 84 -> 1 MHz, free running over the full 32 bits */
+   __HAL_RCC_TIM2_CLK_ENABLE();
+   htim2.Instance = TIM2;
+   htim2.Init.Prescaler = 84 - 1;
+   htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+   htim2.Init.Period = 0xFFFFFFFFU;
+   htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+   htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+   if (HAL_TIM_Base_Init(&htim2) != HAL_OK) { Error_Handler(); }
+}
+#endif
 static void MX_I2C1_Init(void)
 {
    hi2c1.Instance = I2C1;
-   hi2c1.Init.ClockSpeed = 100000;
+   hi2c1.Init.ClockSpeed = 100000;   /* safe start; lcd_init() tries 400 kHz and falls back */
    hi2c1.Init.DutyCycle = I2C_DUTYCYCLE_2;
    hi2c1.Init.OwnAddress1 = 0;
    hi2c1.Init.AddressingMode = I2C_ADDRESSINGMODE_7BIT;
@@ -254,21 +1069,163 @@ static void MX_I2C1_Init(void)
    hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
    if (HAL_I2C_Init(&hi2c1) != HAL_OK) { Error_Handler(); }
 }
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+static void MX_SPI2_Init(void)
+{
+   /* 42 MHz APB1 / 2 = 21 MHz, inside the 0x03 READ limit of 25-series NOR */
+   hspi2.Instance = SPI2;
+   hspi2.Init.Mode = SPI_MODE_MASTER;
+   hspi2.Init.Direction = SPI_DIRECTION_2LINES;
+   hspi2.Init.DataSize = SPI_DATASIZE_8BIT;
+   hspi2.Init.CLKPolarity = SPI_POLARITY_LOW;
+   hspi2.Init.CLKPhase = SPI_PHASE_1EDGE;
+   hspi2.Init.NSS = SPI_NSS_SOFT;
+   hspi2.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
+   hspi2.Init.FirstBit = SPI_FIRSTBIT_MSB;
+   hspi2.Init.TIMode = SPI_TIMODE_DISABLE;
+   hspi2.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
+   hspi2.Init.CRCPolynomial = 10;
+   if (HAL_SPI_Init(&hspi2) != HAL_OK) { Error_Handler(); }
+}
+#elif QSTORE_BACKEND == QSTORE_BACKEND_FATFS
+static void MX_SDIO_SD_Init(void)
+{
+   /* 48 MHz PLLQ; the card is opened (and the bus widened) by FatFs */
+   hsd.Instance = SDIO;
+   hsd.Init.ClockEdge = SDIO_CLOCK_EDGE_RISING;
+   hsd.Init.ClockBypass = SDIO_CLOCK_BYPASS_DISABLE;
+   hsd.Init.ClockPowerSave = SDIO_CLOCK_POWER_SAVE_DISABLE;
+   hsd.Init.BusWide = SDIO_BUS_WIDE_1B;
+   hsd.Init.HardwareFlowControl = SDIO_HARDWARE_FLOW_CONTROL_DISABLE;
+   hsd.Init.ClockDiv = 0;
+}
+#endif
+static void MX_TIM1_Init(void)
+{
+   /* PWM on CH2N; prescaler/period are set per tone by tone_start() */
+   TIM_OC_InitTypeDef sConfigOC = {0};
+   __HAL_RCC_TIM1_CLK_ENABLE();
+   htim1.Instance = TIM1;
+   htim1.Init.Prescaler = 0;
+   htim1.Init.CounterMode = TIM_COUNTERMODE_UP;
+   htim1.Init.Period = 0xFFFF;
+   htim1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+   htim1.Init.RepetitionCounter = 0;
+   htim1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+   if (HAL_TIM_PWM_Init(&htim1) != HAL_OK) { Error_Handler(); }
+   sConfigOC.OCMode = TIM_OCMODE_PWM1;
+   sConfigOC.Pulse = 0;
+   sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+   sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+   sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+   sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
+   sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+   if (HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC, BUZZER_TIM_CHANNEL) != HAL_OK) { Error_Handler(); }
+}
+#if LED_STRIP && WS2812B_BACKEND == WS2812B_BACKEND_TIMER
+static void MX_TIM3_Init(void)
+{
+   /* PWM on CH4 (PB1, AF2); ws2812b_init() sets the 800 kHz period */
+   TIM_OC_InitTypeDef sConfigOC = {0};
+   GPIO_InitTypeDef GPIO_InitStruct = {0};
+   __HAL_RCC_TIM3_CLK_ENABLE();
+   GPIO_InitStruct.Pin = WS2812B_PIN;
+   GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+   GPIO_InitStruct.Pull = GPIO_NOPULL;
+   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+   GPIO_InitStruct.Alternate = GPIO_AF2_TIM3;
+   HAL_GPIO_Init(WS2812B_PORT, &GPIO_InitStruct);
+   htim3.Instance = TIM3;
+   htim3.Init.Prescaler = 0;
+   htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+   htim3.Init.Period = 0xFFFF;
+   htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+   htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+   if (HAL_TIM_PWM_Init(&htim3) != HAL_OK) { Error_Handler(); }
+   sConfigOC.OCMode = TIM_OCMODE_PWM1;
+   sConfigOC.Pulse = 0;
+   sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+   sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+   if (HAL_TIM_PWM_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_4) != HAL_OK) { Error_Handler(); }
+}
+#endif
+static void MX_TIM7_Init(void)
+{
+   /* 84 MHz timer clock / 84 / 1000 -> 1 kHz update interrupt */
+   __HAL_RCC_TIM7_CLK_ENABLE();
+   htim7.Instance = TIM7;
+   htim7.Init.Prescaler = 84 - 1;
+   htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+   htim7.Init.Period = 1000 - 1;
+   htim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+   if (HAL_TIM_Base_Init(&htim7) != HAL_OK) { Error_Handler(); }
+   HAL_NVIC_SetPriority(TIM7_IRQn, 6, 0);
+   HAL_NVIC_EnableIRQ(TIM7_IRQn);
+}
+static void MX_DMA_Init(void)
+{
+   /* I2C1_TX -> DMA1 Stream6 Channel1 (non-blocking LCD queue) */
+   __HAL_RCC_DMA1_CLK_ENABLE();
+   HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 5, 0);
+   HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+#if LED_STRIP && WS2812B_BACKEND == WS2812B_BACKEND_TIMER
+   /* TIM3_CH4 -> DMA1 Stream2 Channel5, circular half-words (LED strip);
+      its half/complete interrupts encode the next LEDs */
+   HAL_NVIC_SetPriority(DMA1_Stream2_IRQn, 5, 0);
+   HAL_NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+#endif
+   /* USART1_RX -> DMA2 Stream2 Channel4, circular (answer line queue) */
+   __HAL_RCC_DMA2_CLK_ENABLE();
+   HAL_NVIC_SetPriority(DMA2_Stream2_IRQn, 4, 0);
+   HAL_NVIC_EnableIRQ(DMA2_Stream2_IRQn);
+   /* USART1_TX -> DMA2 Stream7 Channel4 (console output) */
+   HAL_NVIC_SetPriority(DMA2_Stream7_IRQn, 7, 0);
+   HAL_NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+#if BUZZ_IN
+   /* USART2_RX -> DMA1 Stream5 Channel4, USART6_RX -> DMA2 Stream1
+      Channel5, both circular; same priority as USART1_RX so no terminal is
+      stamped late because another one's ISR ran first */
+   HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 4, 0);
+   HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+   HAL_NVIC_SetPriority(DMA2_Stream1_IRQn, 4, 0);
+   HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
+#endif
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+   /* SPI2_RX -> DMA1 Stream3, SPI2_TX -> DMA1 Stream4 (Channel0): the HAL
+      clocks a DMA receive out through the TX stream */
+   HAL_NVIC_SetPriority(DMA1_Stream3_IRQn, 6, 0);
+   HAL_NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+   HAL_NVIC_SetPriority(DMA1_Stream4_IRQn, 6, 0);
+   HAL_NVIC_EnableIRQ(DMA1_Stream4_IRQn);
+#endif
+}
 static void MX_GPIO_Init(void)
 {
    __HAL_RCC_GPIOB_CLK_ENABLE();
    __HAL_RCC_GPIOF_CLK_ENABLE();
    GPIO_InitTypeDef GPIO_InitStruct = {0};
    GPIO_InitStruct.Pin = BUZZER_PIN;
-   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+   GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
    GPIO_InitStruct.Pull = GPIO_NOPULL;
    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+   GPIO_InitStruct.Alternate = GPIO_AF1_TIM1;
    HAL_GPIO_Init(BUZZER_PORT, &GPIO_InitStruct);
    GPIO_InitStruct.Pin = LED_R_PIN | LED_B_PIN | LED_G_PIN;
    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
    GPIO_InitStruct.Pull = GPIO_PULLUP;
    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
    HAL_GPIO_Init(LED_PORT, &GPIO_InitStruct);
+#if BUZZ_IN
+   __HAL_RCC_GPIOC_CLK_ENABLE();
+   GPIO_InitStruct.Pin = BUZZ_BTN1_PIN | BUZZ_BTN2_PIN;
+   GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+   GPIO_InitStruct.Pull = GPIO_PULLUP;
+   HAL_GPIO_Init(BUZZ_BTN_PORT, &GPIO_InitStruct);
+   HAL_NVIC_SetPriority(EXTI0_IRQn, 4, 0);
+   HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+   HAL_NVIC_SetPriority(EXTI1_IRQn, 4, 0);
+   HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+#endif
 }
 void Error_Handler(void)
 {
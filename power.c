@@ -0,0 +1,45 @@
+/*
+* power.c - SLEEP-mode idle and sleep-time accounting (see power.h)
+*
+* STOP mode is not used: on the F4 the USART cannot wake the core from STOP,
+* and an EXTI wake-up on the RX pin would lose the first byte (and the RX
+* DMA) while the PLL restarts. SLEEP keeps every peripheral clocked and
+* still gates the core for most of each 1 ms SysTick period.
+*/
+
+#include "power.h"
+#include "stm32f4xx_hal.h"
+
+static uint64_t sleep_us_total = 0;
+
+/* Microseconds since boot from the HAL tick plus the SysTick down-counter */
+static uint64_t now_us(void)
+{
+   uint32_t ms, val, load;
+   do {
+       ms = HAL_GetTick();
+       val = SysTick->VAL;
+       load = SysTick->LOAD;
+   } while (ms != HAL_GetTick());
+   return (uint64_t)ms * 1000U + ((uint64_t)(load - val) * 1000U) / (load + 1U);
+}
+
+void power_idle(void)
+{
+   uint64_t t0 = now_us();
+   HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+   uint64_t t1 = now_us();
+   /* the waking ISR runs before we get here; its time counts as sleep,
+      which is at most a few microseconds per wake-up */
+   if (t1 > t0) sleep_us_total += t1 - t0;
+}
+
+uint32_t power_sleep_ms(void)
+{
+   return (uint32_t)(sleep_us_total / 1000U);
+}
+
+uint32_t power_uptime_ms(void)
+{
+   return HAL_GetTick();
+}
@@ -0,0 +1,17 @@
+#ifndef POWER_H
+#define POWER_H
+#include <stdint.h>
+/*
+* power.h - low-power idle for the cooperative main loop.
+*
+* power_idle() puts the core in SLEEP (WFI) until the next interrupt.
+* Peripherals, DMA and their interrupts keep running, so USART1 RX DMA, the
+* I2C LCD queue, TIM7 audio and SysTick all wake the core as usual.
+* The time between entering WFI and waking is added to a sleep counter
+* measured on SysTick (DWT->CYCCNT stops while the core clock is gated).
+*/
+void power_idle(void);
+/* Cumulative time asleep and total uptime since boot, in milliseconds */
+uint32_t power_sleep_ms(void);
+uint32_t power_uptime_ms(void);
+#endif /* POWER_H */
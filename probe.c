@@ -0,0 +1,91 @@
+/*
+* probe.c - cycle-count probe table (see probe.h)
+*/
+
+#include "probe.h"
+#include <string.h>
+
+static const char *const probe_names[PROBE_COUNT] = {
+   "lcd_flush",
+   "lcd_send_string",
+   "pcf_flush",
+   "ws2812b_send",
+   "tone_start",
+   "answer_check",
+   "ledfx_render",
+};
+
+static const char *const mark_names[PROBE_MARK_COUNT] = {
+   "start",
+   "setup_done",
+   "first_question",
+};
+
+#if PROBE_ENABLE
+static probe_stat_t probes[PROBE_COUNT];
+static uint32_t marks[PROBE_MARK_COUNT];
+static uint8_t marked[PROBE_MARK_COUNT];
+
+void probe_add(probe_id_t id, uint32_t cycles)
+{
+   probe_stat_t *p = &probes[id];
+   if (p->count == 0 || cycles < p->min) p->min = cycles;
+   if (cycles > p->max) p->max = cycles;
+   p->total += cycles;
+   p->count++;
+}
+
+/* Only the first time counts: a milestone is not moved by a later pass */
+void probe_mark_at(probe_mark_t m, uint32_t cycles)
+{
+   if (m >= PROBE_MARK_COUNT || marked[m]) return;
+   marks[m] = cycles;
+   marked[m] = 1;
+}
+#endif
+
+const char *probe_name(probe_id_t id)
+{
+   return id < PROBE_COUNT ? probe_names[id] : "?";
+}
+
+/* Snapshot of one probe. Taken with interrupts masked so a probe updated
+   from an ISR is never seen half-written. */
+void probe_get(probe_id_t id, probe_stat_t *out)
+{
+#if PROBE_ENABLE
+   uint32_t primask = __get_PRIMASK();
+   __disable_irq();
+   *out = probes[id];
+   if (!primask) __enable_irq();
+#else
+   (void)id;
+   memset(out, 0, sizeof(*out));
+#endif
+}
+
+void probe_reset(void)
+{
+#if PROBE_ENABLE
+   uint32_t primask = __get_PRIMASK();
+   __disable_irq();
+   memset(probes, 0, sizeof(probes));
+   if (!primask) __enable_irq();
+#endif
+}
+
+const char *probe_mark_name(probe_mark_t m)
+{
+   return m < PROBE_MARK_COUNT ? mark_names[m] : "?";
+}
+
+uint32_t probe_mark_us(probe_mark_t m)
+{
+#if PROBE_ENABLE
+   if (m >= PROBE_MARK_COUNT || !marked[m] || !marked[PROBE_MARK_START]) return 0;
+   return (marks[m] - marks[PROBE_MARK_START]) / (SystemCoreClock / 1000000UL);
+#else
+   (void)m;
+   return 0;
+#endif
+}
@@ -0,0 +1,68 @@
+#ifndef PROBE_H
+#define PROBE_H
+#include "delay.h"
+#include <stdint.h>
+/*
+* probe.h - cycle-count probes on the hot paths.
+*
+* PROBE_BEGIN(id) ... PROBE_END(id) around a block adds one sample, in DWT
+* core cycles, to that probe's count/total/min/max. Both must sit in the
+* same scope and END must be reached (no return in between). The table is
+* printed by the !stats console command.
+*
+* A probe is updated without locking, so each one must only be used from
+* one context (thread or a single ISR). With PROBE_ENABLE 0 the macros
+* compile to nothing and probe_get() reports empty probes.
+*
+* Boot marks: PROBE_MARK(m) stamps the first time a start-up milestone is
+* reached; probe_mark_us() gives it in microseconds after PROBE_MARK_START,
+* which main() takes right after delay_init(). CYCCNT wraps after 51 s at
+* 84 MHz, far beyond any boot.
+*/
+#ifndef PROBE_ENABLE
+#define PROBE_ENABLE 1
+#endif
+
+typedef enum {
+   PROBE_LCD_FLUSH,       /* lcd_flush(): framebuffer diff + queueing */
+   PROBE_LCD_STRING,      /* lcd_send_string() */
+   PROBE_PCF_FLUSH,       /* one expander transaction (queued or blocking) */
+   PROBE_WS2812B_SEND,    /* ws2812b_send(): whole strip */
+   PROBE_TONE_START,      /* tone_start(): timer reprogramming (TIM7 ISR) */
+   PROBE_ANSWER_CHECK,    /* answer_check(): normalize + lookup */
+   PROBE_LEDFX_RENDER,    /* ledfx_task(): one effect frame into the back buffer */
+   PROBE_COUNT
+} probe_id_t;
+
+typedef enum {
+   PROBE_MARK_START,          /* top of main(), clock configured */
+   PROBE_MARK_SETUP_DONE,     /* main() enters the scheduler loop */
+   PROBE_MARK_FIRST_QUESTION, /* first question's flush has completed */
+   PROBE_MARK_COUNT
+} probe_mark_t;
+
+typedef struct {
+   uint32_t count;
+   uint64_t total;        /* cycles */
+   uint32_t min, max;     /* cycles, valid when count > 0 */
+} probe_stat_t;
+
+#if PROBE_ENABLE
+void probe_add(probe_id_t id, uint32_t cycles);
+#define PROBE_BEGIN(id) uint32_t probe_t0_##id = delay_cycles_now()
+#define PROBE_END(id)   probe_add((id), delay_cycles_now() - probe_t0_##id)
+void probe_mark_at(probe_mark_t m, uint32_t cycles);
+#define PROBE_MARK(m)   probe_mark_at((m), delay_cycles_now())
+#else
+#define PROBE_BEGIN(id) do { } while (0)
+#define PROBE_END(id)   do { } while (0)
+#define PROBE_MARK(m)   do { } while (0)
+#endif
+
+const char *probe_name(probe_id_t id);
+void probe_get(probe_id_t id, probe_stat_t *out);
+void probe_reset(void);
+const char *probe_mark_name(probe_mark_t m);
+/* Microseconds from PROBE_MARK_START to m; 0 if m was not reached yet */
+uint32_t probe_mark_us(probe_mark_t m);
+#endif /* PROBE_H */
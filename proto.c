@@ -0,0 +1,270 @@
+/*
+* proto.c - framed binary control protocol (see proto.h)
+*
+* The receive side runs in the UART ISR one byte at a time, keeping the
+* CRC as it goes, and queues complete frames for proto_task(). A frame
+* with an impossible length cannot be resynchronised on, so the rest of it
+* is swallowed until the line has been quiet for PROTO_RX_TIMEOUT_MS;
+* otherwise its bytes would reach the line assembler as a typed answer.
+*/
+
+#include "proto.h"
+#include <string.h>
+
+typedef enum {
+   RX_IDLE,
+   RX_LEN0,
+   RX_LEN1,
+   RX_TYPE,
+   RX_DATA,
+   RX_CRC0,
+   RX_CRC1,
+   RX_SKIP          /* bad frame: drop everything until the line goes quiet */
+} rx_state_t;
+
+typedef struct {
+   uint8_t type;
+   uint16_t len;
+   uint8_t data[PROTO_MAX_PAYLOAD];
+} proto_frame_t;
+
+typedef struct {
+   uint8_t type;
+   proto_handler_fn_t fn;
+} proto_handler_t;
+
+static proto_tx_fn_t tx_fn = NULL;
+static proto_handler_t handlers[PROTO_MAX_HANDLERS];
+static uint8_t handler_count = 0;
+
+/* ISR side: the frame being received, then the queue (ISR writes at
+   frame_wr, thread reads at frame_rd; one entry always stays free) */
+static proto_frame_t cur;
+static volatile rx_state_t rx_state = RX_IDLE;
+static uint16_t rx_pos;
+static uint16_t rx_crc;
+static uint16_t rx_got_crc;
+static volatile uint32_t rx_last;           /* HAL tick of the last frame byte */
+static proto_frame_t frames[PROTO_RX_FRAMES + 1];
+static volatile uint8_t frame_rd = 0;
+static volatile uint8_t frame_wr = 0;
+
+static uint32_t frames_done = 0;
+static volatile uint32_t crc_errors = 0;
+static volatile uint32_t dropped = 0;
+
+/* Answers queued by PROTO_T_ANSWERS: length byte + text, back to back */
+static uint8_t ans_buf[PROTO_ANSWER_BUF];
+static uint16_t ans_head = 0;
+static uint16_t ans_tail = 0;
+
+static uint16_t crc16_byte(uint16_t crc, uint8_t b)
+{
+   crc ^= (uint16_t)(b << 8);
+   for (int i = 0; i < 8; ++i) {
+       crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+   }
+   return crc;
+}
+
+static uint16_t crc16(uint16_t crc, const uint8_t *p, uint16_t n)
+{
+   while (n--) crc = crc16_byte(crc, *p++);
+   return crc;
+}
+
+uint8_t proto_rx_byte(uint8_t ch, uint8_t line_start)
+{
+   if (rx_state == RX_IDLE) {
+       if (!line_start || ch != PROTO_SYNC) return 0;
+       rx_state = RX_LEN0;
+       rx_crc = 0xFFFF;
+       rx_last = HAL_GetTick();
+       return 1;
+   }
+   rx_last = HAL_GetTick();
+   if (rx_state < RX_CRC0) rx_crc = crc16_byte(rx_crc, ch);
+   switch (rx_state) {
+   case RX_LEN0:
+       cur.len = ch;
+       rx_state = RX_LEN1;
+       break;
+   case RX_LEN1:
+       cur.len |= (uint16_t)(ch << 8);
+       if (cur.len > PROTO_MAX_PAYLOAD) {
+           crc_errors++;
+           rx_state = RX_SKIP;
+       } else {
+           rx_state = RX_TYPE;
+       }
+       break;
+   case RX_TYPE:
+       cur.type = ch;
+       rx_pos = 0;
+       rx_state = cur.len ? RX_DATA : RX_CRC0;
+       break;
+   case RX_DATA:
+       cur.data[rx_pos++] = ch;
+       if (rx_pos == cur.len) rx_state = RX_CRC0;
+       break;
+   case RX_CRC0:
+       rx_got_crc = ch;
+       rx_state = RX_CRC1;
+       break;
+   case RX_CRC1: {
+       rx_got_crc |= (uint16_t)(ch << 8);
+       rx_state = RX_IDLE;
+       uint8_t next = (uint8_t)((frame_wr + 1) % (PROTO_RX_FRAMES + 1));
+       if (rx_got_crc != rx_crc) {
+           crc_errors++;
+       } else if (next == frame_rd) {
+           dropped++;
+       } else {
+           proto_frame_t *f = &frames[frame_wr];
+           f->type = cur.type;
+           f->len = cur.len;
+           memcpy(f->data, cur.data, cur.len);
+           frame_wr = next;
+       }
+       break;
+   }
+   default:   /* RX_SKIP */
+       break;
+   }
+   return 1;
+}
+
+static void send_bytes(const uint8_t *p, uint16_t n)
+{
+   if (tx_fn && n) tx_fn((const char *)p, n);
+}
+
+void proto_reply(uint8_t type, uint8_t status, const void *data, uint16_t len)
+{
+   if (len > PROTO_MAX_PAYLOAD - 1) len = PROTO_MAX_PAYLOAD - 1;
+   uint16_t total = (uint16_t)(len + 1);
+   uint8_t head[5] = { PROTO_SYNC, (uint8_t)total, (uint8_t)(total >> 8),
+                       (uint8_t)(type | PROTO_REPLY), status };
+   uint16_t crc = crc16(0xFFFF, &head[1], 4);
+   crc = crc16(crc, (const uint8_t *)data, len);
+   uint8_t tail[2] = { (uint8_t)crc, (uint8_t)(crc >> 8) };
+   send_bytes(head, sizeof(head));
+   send_bytes((const uint8_t *)data, len);
+   send_bytes(tail, sizeof(tail));
+}
+
+/* ---------- Built-in requests ---------- */
+
+static uint16_t ans_free(void)
+{
+   return (uint16_t)((ans_tail + PROTO_ANSWER_BUF - ans_head - 1) % PROTO_ANSWER_BUF);
+}
+
+static void ans_put(uint8_t b)
+{
+   ans_buf[ans_head] = b;
+   ans_head = (uint16_t)((ans_head + 1) % PROTO_ANSWER_BUF);
+}
+
+static void req_ping(const uint8_t *p, uint16_t len)
+{
+   (void)p;
+   (void)len;
+   uint8_t out[5] = { PROTO_VERSION, (uint8_t)PROTO_MAX_PAYLOAD, (uint8_t)(PROTO_MAX_PAYLOAD >> 8) };
+   uint16_t room = ans_free();
+   out[3] = (uint8_t)room;
+   out[4] = (uint8_t)(room >> 8);
+   proto_reply(PROTO_T_PING, PROTO_OK, out, sizeof(out));
+}
+
+/* As many answers as fit; the reply says how many were taken */
+static void req_answers(const uint8_t *p, uint16_t len)
+{
+   uint16_t at = 0, queued = 0;
+   uint8_t status = PROTO_OK;
+   while (at < len) {
+       uint8_t n = p[at];
+       if (at + 1U + n > len) {
+           status = PROTO_E_LEN;
+           break;
+       }
+       if (ans_free() < n + 1U) break;
+       ans_put(n);
+       for (uint8_t i = 0; i < n; ++i) ans_put(p[at + 1 + i]);
+       at = (uint16_t)(at + 1 + n);
+       queued++;
+   }
+   uint8_t out[2] = { (uint8_t)queued, (uint8_t)(queued >> 8) };
+   proto_reply(PROTO_T_ANSWERS, status, out, sizeof(out));
+}
+
+int proto_get_answer(char *out, uint16_t size)
+{
+   if (ans_tail == ans_head || size == 0) return -1;
+   uint8_t n = ans_buf[ans_tail];
+   uint16_t at = (uint16_t)((ans_tail + 1) % PROTO_ANSWER_BUF);
+   uint16_t keep = n < size - 1 ? n : (uint16_t)(size - 1);
+   for (uint16_t i = 0; i < keep; ++i) out[i] = (char)ans_buf[(at + i) % PROTO_ANSWER_BUF];
+   out[keep] = '\0';
+   ans_tail = (uint16_t)((at + n) % PROTO_ANSWER_BUF);
+   return (int)keep;
+}
+
+/* ---------- Thread side ---------- */
+
+void proto_init(proto_tx_fn_t tx)
+{
+   tx_fn = tx;
+   proto_register(PROTO_T_PING, req_ping);
+   proto_register(PROTO_T_ANSWERS, req_answers);
+}
+
+int proto_register(uint8_t type, proto_handler_fn_t fn)
+{
+   if (handler_count >= PROTO_MAX_HANDLERS) return -1;
+   handlers[handler_count].type = type;
+   handlers[handler_count].fn = fn;
+   handler_count++;
+   return 0;
+}
+
+void proto_task(void)
+{
+   /* give up on a frame that stopped arriving */
+   if (rx_state != RX_IDLE) {
+       uint32_t primask = __get_PRIMASK();
+       __disable_irq();
+       if (rx_state != RX_IDLE && HAL_GetTick() - rx_last > PROTO_RX_TIMEOUT_MS) {
+           if (rx_state != RX_SKIP) dropped++;
+           rx_state = RX_IDLE;
+       }
+       if (!primask) __enable_irq();
+   }
+
+   while (frame_rd != frame_wr) {
+       const proto_frame_t *f = &frames[frame_rd];
+       uint8_t i;
+       for (i = 0; i < handler_count; ++i) {
+           if (handlers[i].type == f->type) break;
+       }
+       if (i < handler_count) handlers[i].fn(f->data, f->len);
+       else proto_reply(f->type, PROTO_E_TYPE, NULL, 0);
+       frames_done++;
+       frame_rd = (uint8_t)((frame_rd + 1) % (PROTO_RX_FRAMES + 1));
+   }
+}
+
+uint32_t proto_frames(void)
+{
+   return frames_done;
+}
+
+uint32_t proto_crc_errors(void)
+{
+   return crc_errors;
+}
+
+uint32_t proto_dropped(void)
+{
+   return dropped;
+}
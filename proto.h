@@ -0,0 +1,113 @@
+#ifndef PROTO_H
+#define PROTO_H
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+/*
+* proto.h - framed binary control protocol on the quiz UART, next to the
+* text mode, for test rigs and remote consoles.
+*
+* A frame is
+*
+*     0xA5  len (2)  type  payload[len]  crc (2)
+*
+* little-endian, crc = CRC-16/CCITT (0x1021, init 0xFFFF) over len, type
+* and payload. 0xA5 never starts a typed line, so uart_rx hands a line
+* that starts with it to proto_rx_byte() (in its ISR) until the frame is
+* complete, and text answers and '!' commands keep working in between.
+* Frames with a bad length or CRC are dropped and counted, and a frame
+* that stops arriving for PROTO_RX_TIMEOUT_MS is given up.
+*
+* Requests are handed from proto_task() to the handler registered for
+* their type. Each one gets exactly one reply frame of type | 0x80 whose
+* payload starts with a status byte. Replies go out through the tx
+* function given to proto_init() (console_write(): the DMA TX ring).
+*/
+#ifndef PROTO_MAX_PAYLOAD
+#define PROTO_MAX_PAYLOAD 256
+#endif
+#ifndef PROTO_RX_FRAMES
+#define PROTO_RX_FRAMES 2          /* complete frames kept until handled */
+#endif
+#ifndef PROTO_RX_TIMEOUT_MS
+#define PROTO_RX_TIMEOUT_MS 100
+#endif
+#ifndef PROTO_MAX_HANDLERS
+#define PROTO_MAX_HANDLERS 16
+#endif
+/* Typed answers from PROTO_T_ANSWERS frames waiting for the quiz, bytes */
+#ifndef PROTO_ANSWER_BUF
+#define PROTO_ANSWER_BUF 512
+#endif
+
+#define PROTO_SYNC    0xA5
+#define PROTO_VERSION 1
+#define PROTO_REPLY   0x80         /* reply type = request type | PROTO_REPLY */
+
+/* Request types and their payloads (-> reply data after the status) */
+#define PROTO_T_PING       0x01    /* -> version, max payload (2), answer queue free (2) */
+#define PROTO_T_BAUD       0x02    /* baud (4): reply at the old rate, then switch */
+#define PROTO_T_ANSWERS    0x10    /* n x (len, text): queued as typed answers -> queued (2) */
+#define PROTO_T_CHECK      0x11    /* n x (q (2), len, text) -> n (2), verdict per entry */
+#define PROTO_T_BANK_BEGIN 0x20    /* blob size (4) */
+#define PROTO_T_BANK_DATA  0x21    /* offset (4), bytes, in order */
+#define PROTO_T_BANK_END   0x22    /* checks the blob CRC, restarts the quiz */
+#define PROTO_T_STATS      0x30    /* -> counters, see main.c */
+#define PROTO_T_TOTALS     0x31    /* first q (2), n -> first (2), n, n x 4 x u32 (flog_total_t) */
+#define PROTO_T_LCD_TEXT   0x40    /* row, col, text */
+#define PROTO_T_LCD_CLEAR  0x41
+#define PROTO_T_LED        0x42    /* mask (bit 0 R, 1 G, 2 B), ms (2) */
+
+/* Reply status */
+#define PROTO_OK           0
+#define PROTO_E_LEN        1       /* payload too short or malformed */
+#define PROTO_E_TYPE       2       /* no handler for this type */
+#define PROTO_E_UNSUPPORTED 3      /* not in this build or configuration */
+#define PROTO_E_FAIL       4
+#define PROTO_E_BUSY       5
+
+/* Verdicts in a PROTO_T_CHECK reply */
+#define PROTO_WRONG        0
+#define PROTO_RIGHT        1
+#define PROTO_UNCHECKED    2       /* question not available to this backend */
+
+typedef void (*proto_tx_fn_t)(const char *data, uint16_t len);
+typedef void (*proto_handler_fn_t)(const uint8_t *payload, uint16_t len);
+
+void proto_init(proto_tx_fn_t tx);
+/* Handle one request type; it must call proto_reply() once. Returns 0, or
+   -1 if the table is full. */
+int proto_register(uint8_t type, proto_handler_fn_t fn);
+/* uart_rx hook, ISR context: returns 1 if ch belongs to a frame */
+uint8_t proto_rx_byte(uint8_t ch, uint8_t line_start);
+/* Scheduler task: dispatches complete frames, gives up stalled ones */
+void proto_task(void);
+/* Reply to a request of the given type: status, then len bytes of data */
+void proto_reply(uint8_t type, uint8_t status, const void *data, uint16_t len);
+
+/* Oldest answer from a PROTO_T_ANSWERS frame (NUL-terminated, like
+   uart_rx_get_line()). Returns its length, or -1 if none is waiting. */
+int proto_get_answer(char *out, uint16_t size);
+
+uint32_t proto_frames(void);       /* requests handled */
+uint32_t proto_crc_errors(void);   /* frames dropped for a bad CRC or length */
+uint32_t proto_dropped(void);      /* good frames lost to a full queue or a stall */
+
+static inline uint16_t proto_u16(const uint8_t *p)
+{
+   return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t proto_u32(const uint8_t *p)
+{
+   return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint8_t *proto_put32(uint8_t *p, uint32_t v)
+{
+   p[0] = (uint8_t)v;
+   p[1] = (uint8_t)(v >> 8);
+   p[2] = (uint8_t)(v >> 16);
+   p[3] = (uint8_t)(v >> 24);
+   return p + 4;
+}
+#endif /* PROTO_H */
@@ -0,0 +1,95 @@
+/*
+* qbank.c - in-place reader for the packed question bank (see qbank.h)
+*
+* Nothing is copied: every accessor returns a pointer into the blob, which
+* normally sits in internal flash as a const array. RAM use is a handful
+* of pointers regardless of bank size.
+*/
+
+#include "qbank.h"
+#include <stddef.h>
+
+static const qbank_header_t *hdr = NULL;
+static const qbank_question_t *qtab = NULL;
+static const uint32_t *vtab = NULL;
+static const qbank_key_t *itab = NULL;
+static const char *pool = NULL;
+
+uint32_t qbank_crc32(uint32_t crc, const uint8_t *p, uint32_t n)
+{
+   crc = ~crc;
+   while (n--) {
+       crc ^= *p++;
+       for (int b = 0; b < 8; ++b) crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1U)));
+   }
+   return ~crc;
+}
+
+int qbank_open(const uint8_t *blob)
+{
+   const qbank_header_t *h = (const qbank_header_t *)blob;
+   if (h->magic != QBANK_MAGIC || h->version != QBANK_VERSION) return -1;
+   if (h->total_size < sizeof(*h) || h->pool_off + h->pool_size > h->total_size) return -1;
+   if ((h->question_off | h->variant_off | h->index_off) & 3U) return -1;
+#if QBANK_VERIFY_CRC
+   if (qbank_crc32(0, blob + sizeof(*h), h->total_size - sizeof(*h)) != h->crc32) return -1;
+#endif
+   hdr = h;
+   qtab = (const qbank_question_t *)(blob + h->question_off);
+   vtab = (const uint32_t *)(blob + h->variant_off);
+   itab = (const qbank_key_t *)(blob + h->index_off);
+   pool = (const char *)(blob + h->pool_off);
+   return 0;
+}
+
+uint16_t qbank_count(void)
+{
+   return hdr ? hdr->num_questions : 0;
+}
+
+const qbank_question_t *qbank_question(uint16_t q)
+{
+   return &qtab[q];
+}
+
+uint8_t qbank_cols(void)
+{
+   return hdr ? hdr->cols : 0;
+}
+
+uint8_t qbank_rows(void)
+{
+   return hdr ? hdr->rows : 0;
+}
+
+const char *qbank_text(uint16_t q)
+{
+   return pool + qtab[q].text_off;
+}
+
+const char *qbank_lines(uint16_t q, uint8_t *num_lines)
+{
+   *num_lines = qtab[q].num_lines;
+   return pool + qtab[q].lines_off;
+}
+
+uint16_t qbank_num_variants(uint16_t q)
+{
+   return qtab[q].num_variants;
+}
+
+const char *qbank_variant(uint16_t q, uint16_t i)
+{
+   return pool + vtab[qtab[q].first_variant + i];
+}
+
+uint8_t qbank_max_dist(uint16_t q)
+{
+   return qtab[q].max_dist;
+}
+
+const qbank_key_t *qbank_index(uint16_t *n)
+{
+   *n = hdr ? hdr->num_answers : 0;
+   return itab;
+}
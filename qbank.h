@@ -0,0 +1,93 @@
+#ifndef QBANK_H
+#define QBANK_H
+#include <stdint.h>
+/*
+* qbank.h - packed question bank, read in place (zero copy) from flash.
+*
+* The bank is one little-endian blob produced by tools/qbank_pack.py:
+*
+*   qbank_header_t                      at offset 0
+*   qbank_question_t[num_questions]     at question_off
+*   uint32_t variant_off[num_answers]   at variant_off (pool offsets, grouped
+*                                       by question, normalized text)
+*   qbank_key_t[num_answers]            at index_off, sorted by hash
+*   string pool                         at pool_off: one chunk per
+*                                       question, in question order
+*
+* A question's chunk starts at text_off and is chunk_len bytes long:
+*
+*   text NUL, num_lines rows of `cols` bytes, num_variants answers each NUL
+*
+* so it can be fetched from slow storage with one read (see qstore.h).
+*
+* Header offsets are from the start of the blob, string offsets (text_off,
+* lines_off, the variant table) from pool_off. Every table is 4-byte aligned.
+* Pre-wrapped rows are exactly `cols` bytes each (space padded, no NUL) and
+* num_lines is a whole number of pages of `rows` rows: page p is rows
+* p*rows .. p*rows+rows-1. Drawing a page is a straight copy into the LCD
+* framebuffer.
+*/
+#define QBANK_MAGIC   0x314B4251UL   /* "QBK1" */
+#define QBANK_VERSION 2
+
+/* Verify the CRC32 of the blob in qbank_open() (one pass over the bank) */
+#ifndef QBANK_VERIFY_CRC
+#define QBANK_VERIFY_CRC 1
+#endif
+
+typedef struct {
+   uint32_t magic;
+   uint16_t version;
+   uint16_t flags;
+   uint16_t num_questions;
+   uint16_t num_answers;
+   uint8_t  cols;            /* geometry the rows were wrapped for */
+   uint8_t  rows;
+   uint16_t reserved;
+   uint32_t question_off;
+   uint32_t variant_off;
+   uint32_t index_off;
+   uint32_t pool_off;
+   uint32_t pool_size;
+   uint32_t total_size;      /* whole blob, header included */
+   uint32_t crc32;           /* CRC-32 (IEEE) of bytes [sizeof header, total_size) */
+} qbank_header_t;
+
+typedef struct {
+   uint32_t text_off;        /* full question text (NUL-terminated) */
+   uint32_t lines_off;       /* num_lines rows of `cols` bytes */
+   uint16_t first_variant;   /* into the variant table */
+   uint16_t num_variants;
+   uint8_t  num_lines;
+   uint8_t  max_dist;        /* typo tolerance, 0 = exact only */
+   uint16_t chunk_len;       /* text + rows + variants, see above */
+} qbank_question_t;
+
+typedef struct {
+   uint32_t hash;            /* FNV-1a of (question, normalized answer) */
+   uint16_t question;
+   uint16_t variant;         /* i for qbank_variant(question, i) */
+} qbank_key_t;
+
+/* Bank linked into the image (qbank_blob.c, generated) */
+extern const uint8_t qbank_blob[];
+
+/* Validate and select a bank. Returns 0, or -1 if the blob is invalid. */
+int qbank_open(const uint8_t *blob);
+/* CRC-32 (IEEE) of n bytes, continuing from crc (0 to start) */
+uint32_t qbank_crc32(uint32_t crc, const uint8_t *p, uint32_t n);
+
+uint16_t qbank_count(void);
+const qbank_question_t *qbank_question(uint16_t q);
+uint8_t qbank_cols(void);
+uint8_t qbank_rows(void);
+const char *qbank_text(uint16_t q);
+/* Pointer to num_lines rows of qbank_cols() bytes each; *num_lines is set */
+const char *qbank_lines(uint16_t q, uint8_t *num_lines);
+uint16_t qbank_num_variants(uint16_t q);
+/* i-th accepted (normalized) answer of question q */
+const char *qbank_variant(uint16_t q, uint16_t i);
+uint8_t qbank_max_dist(uint16_t q);
+/* Hash index sorted by hash; *n is set to its length */
+const qbank_key_t *qbank_index(uint16_t *n);
+#endif /* QBANK_H */
@@ -0,0 +1,43 @@
+/* Generated by tools/qbank_pack.py from questions.txt - do not edit */
+#include "qbank.h"
+
+/* 432 bytes, packed question bank (layout in qbank.h) */
+__attribute__((aligned(4)))
+const uint8_t qbank_blob[432] = {
+   0x51, 0x42, 0x4B, 0x31, 0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x06, 0x00,
+   0x10, 0x02, 0x00, 0x00, 0x2C, 0x00, 0x00, 0x00, 0x5C, 0x00, 0x00, 0x00,
+   0x74, 0x00, 0x00, 0x00, 0xA4, 0x00, 0x00, 0x00, 0x0A, 0x01, 0x00, 0x00,
+   0xB0, 0x01, 0x00, 0x00, 0xBD, 0x29, 0x9B, 0x2C, 0x00, 0x00, 0x00, 0x00,
+   0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x00, 0x4D, 0x00,
+   0x4D, 0x00, 0x00, 0x00, 0x6D, 0x00, 0x00, 0x00, 0x02, 0x00, 0x03, 0x00,
+   0x02, 0x02, 0x59, 0x00, 0xA6, 0x00, 0x00, 0x00, 0xC4, 0x00, 0x00, 0x00,
+   0x05, 0x00, 0x01, 0x00, 0x04, 0x01, 0x64, 0x00, 0x3F, 0x00, 0x00, 0x00,
+   0x43, 0x00, 0x00, 0x00, 0x8D, 0x00, 0x00, 0x00, 0x9D, 0x00, 0x00, 0x00,
+   0xA2, 0x00, 0x00, 0x00, 0x04, 0x01, 0x00, 0x00, 0x48, 0xE3, 0x75, 0x22,
+   0x00, 0x00, 0x01, 0x00, 0xB5, 0x88, 0x97, 0x2E, 0x01, 0x00, 0x01, 0x00,
+   0xE4, 0x15, 0x4F, 0x42, 0x01, 0x00, 0x02, 0x00, 0xB3, 0x96, 0x07, 0x4F,
+   0x02, 0x00, 0x00, 0x00, 0xDB, 0x6C, 0xFB, 0xB4, 0x01, 0x00, 0x00, 0x00,
+   0x83, 0x0B, 0xF8, 0xE4, 0x00, 0x00, 0x00, 0x00, 0x48, 0x6F, 0x77, 0x20,
+   0x6D, 0x61, 0x6E, 0x79, 0x20, 0x62, 0x6F, 0x6E, 0x65, 0x73, 0x20, 0x64,
+   0x6F, 0x20, 0x68, 0x75, 0x6D, 0x61, 0x6E, 0x73, 0x20, 0x68, 0x61, 0x76,
+   0x65, 0x3F, 0x00, 0x48, 0x6F, 0x77, 0x20, 0x6D, 0x61, 0x6E, 0x79, 0x20,
+   0x62, 0x6F, 0x6E, 0x65, 0x73, 0x20, 0x20, 0x64, 0x6F, 0x20, 0x68, 0x75,
+   0x6D, 0x61, 0x6E, 0x73, 0x20, 0x68, 0x61, 0x76, 0x65, 0x3F, 0x20, 0x32,
+   0x30, 0x36, 0x00, 0x32, 0x30, 0x36, 0x20, 0x62, 0x6F, 0x6E, 0x65, 0x73,
+   0x00, 0x43, 0x75, 0x72, 0x72, 0x65, 0x6E, 0x63, 0x79, 0x20, 0x6F, 0x66,
+   0x20, 0x74, 0x68, 0x65, 0x20, 0x50, 0x68, 0x69, 0x6C, 0x69, 0x70, 0x70,
+   0x69, 0x6E, 0x65, 0x73, 0x20, 0x69, 0x73, 0x3F, 0x00, 0x43, 0x75, 0x72,
+   0x72, 0x65, 0x6E, 0x63, 0x79, 0x20, 0x6F, 0x66, 0x20, 0x74, 0x68, 0x65,
+   0x20, 0x50, 0x68, 0x69, 0x6C, 0x69, 0x70, 0x70, 0x69, 0x6E, 0x65, 0x73,
+   0x20, 0x69, 0x73, 0x3F, 0x20, 0x70, 0x68, 0x69, 0x6C, 0x69, 0x70, 0x70,
+   0x69, 0x6E, 0x65, 0x20, 0x70, 0x65, 0x73, 0x6F, 0x00, 0x70, 0x65, 0x73,
+   0x6F, 0x00, 0x70, 0x68, 0x70, 0x00, 0x57, 0x68, 0x61, 0x74, 0x20, 0x69,
+   0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x61, 0x70, 0x69, 0x74, 0x61,
+   0x6C, 0x20, 0x6F, 0x66, 0x20, 0x4A, 0x61, 0x70, 0x61, 0x6E, 0x3F, 0x00,
+   0x57, 0x68, 0x61, 0x74, 0x20, 0x69, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20,
+   0x20, 0x20, 0x20, 0x20, 0x63, 0x61, 0x70, 0x69, 0x74, 0x61, 0x6C, 0x20,
+   0x6F, 0x66, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x4A, 0x61, 0x70, 0x61,
+   0x6E, 0x3F, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+   0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+   0x20, 0x20, 0x20, 0x20, 0x74, 0x6F, 0x6B, 0x79, 0x6F, 0x00, 0x00, 0x00,
+};
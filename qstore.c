@@ -0,0 +1,533 @@
+/*
+* qstore.c - question bank backends and prefetch cache (see qstore.h)
+*
+* Every backend provides the same two primitives:
+*
+*   dev_start(off, dst, len)  begin reading len blob bytes at off into dst
+*   dev_poll()                0 = still reading, 1 = done, -1 = failed
+*
+* Only one read is in flight at a time. A slot is loaded in two reads: the
+* 16-byte question record, then the question's chunk (text, rows, answers),
+* which the packer keeps contiguous for exactly this reason. While the
+* current question is shown, qstore_task() fills the other slot with the
+* next one.
+*
+* The internal backend skips all of that: the blob is memory mapped, so the
+* item is built with pointers into flash on each advance.
+*/
+
+#include "qstore.h"
+#include <string.h>
+
+static uint16_t cur_q = 0;
+static uint32_t misses = 0;
+
+/* Fill *it from a question record and its chunk (in flash or a slot).
+   Returns -1 if the chunk does not match the record. */
+static int parse_chunk(qstore_item_t *it, uint16_t q, const qbank_question_t *r,
+                      const char *chunk, uint8_t cols)
+{
+   uint32_t rows_at = r->lines_off - r->text_off;
+   uint32_t vars_at = rows_at + (uint32_t)r->num_lines * cols;
+   if (r->lines_off < r->text_off || rows_at == 0 || vars_at > r->chunk_len) return -1;
+   if (chunk[rows_at - 1] != '\0') return -1;            /* text terminated */
+   uint16_t nul = 0;
+   for (uint32_t i = vars_at; i < r->chunk_len; ++i) nul += (chunk[i] == '\0');
+   if (nul != r->num_variants || (r->num_variants && chunk[r->chunk_len - 1] != '\0')) return -1;
+
+   it->q = q;
+   it->num_lines = r->num_lines;
+   it->max_dist = r->max_dist;
+   it->num_variants = r->num_variants;
+   it->text = chunk;
+   it->rows = chunk + rows_at;
+   it->variants = chunk + vars_at;
+   return 0;
+}
+
+/* Shown when a question cannot be read; no answer matches it */
+static void set_unreadable(qstore_item_t *it, uint16_t q)
+{
+   it->q = q;
+   it->num_lines = 0;
+   it->max_dist = 0;
+   it->num_variants = 0;
+   it->text = "Question unreadable";
+   it->rows = it->text;
+   it->variants = "";
+}
+
+#if QSTORE_BACKEND == QSTORE_BACKEND_INTERNAL
+
+static qstore_item_t item;
+
+static void load_item(void)
+{
+   const qbank_question_t *r = qbank_question(cur_q);
+   if (parse_chunk(&item, cur_q, r, qbank_text(cur_q), qbank_cols()) != 0) {
+       set_unreadable(&item, cur_q);
+   }
+}
+
+int qstore_init(void)
+{
+   if (qbank_open(qbank_blob) != 0 || qbank_count() == 0) return -1;
+   cur_q = 0;
+   load_item();
+   return 0;
+}
+
+uint16_t qstore_count(void)
+{
+   return qbank_count();
+}
+
+uint8_t qstore_cols(void)
+{
+   return qbank_cols();
+}
+
+const qstore_item_t *qstore_current(void)
+{
+   return &item;
+}
+
+int qstore_next(void)
+{
+   cur_q = (uint16_t)((cur_q + 1) % qbank_count());
+   load_item();
+   return cur_q == 0;
+}
+
+void qstore_task(void)
+{
+   /* memory mapped: nothing to fetch */
+}
+
+int qstore_upload_begin(uint32_t size)
+{
+   (void)size;
+   return -1;
+}
+
+int qstore_upload_write(uint32_t off, const uint8_t *data, uint16_t len)
+{
+   (void)off;
+   (void)data;
+   (void)len;
+   return -1;
+}
+
+int qstore_upload_end(void)
+{
+   return -1;
+}
+
+#else /* streamed backends */
+
+/* ---------- Device primitives ---------- */
+
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+
+#define NOR_CMD_READ 0x03U   /* READ DATA: works on every 25-series part */
+
+static SPI_HandleTypeDef *nor_spi = NULL;
+static volatile int8_t nor_result = 0;
+
+static void nor_cs(GPIO_PinState s)
+{
+   HAL_GPIO_WritePin(QSTORE_NOR_CS_PORT, QSTORE_NOR_CS_PIN, s);
+}
+
+static int dev_start(uint32_t off, void *dst, uint16_t len)
+{
+   uint32_t a = QSTORE_NOR_BASE + off;
+   uint8_t cmd[4] = { NOR_CMD_READ, (uint8_t)(a >> 16), (uint8_t)(a >> 8), (uint8_t)a };
+   nor_result = 0;
+   nor_cs(GPIO_PIN_RESET);
+   /* 4 command bytes are a few microseconds: not worth a DMA setup */
+   if (HAL_SPI_Transmit(nor_spi, cmd, sizeof(cmd), 2) != HAL_OK ||
+       HAL_SPI_Receive_DMA(nor_spi, (uint8_t *)dst, len) != HAL_OK) {
+       nor_cs(GPIO_PIN_SET);
+       return -1;
+   }
+   return 0;
+}
+
+static int dev_poll(void)
+{
+   return nor_result;
+}
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+   if (hspi != nor_spi) return;
+   nor_cs(GPIO_PIN_SET);
+   nor_result = 1;
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+   if (hspi != nor_spi) return;
+   nor_cs(GPIO_PIN_SET);
+   nor_result = -1;
+}
+
+/* Uploads: blocking write-enable + erase/program + status poll */
+#define NOR_CMD_WREN 0x06U
+#define NOR_CMD_RDSR 0x05U   /* bit 0 = write in progress */
+#define NOR_CMD_PP   0x02U   /* page program, up to the 256-byte page end */
+#define NOR_CMD_SE   0x20U   /* 4 KB sector erase */
+#define NOR_SECTOR   4096U
+#define NOR_PAGE     256U
+
+static int nor_wait(uint32_t ms)
+{
+   uint8_t cmd = NOR_CMD_RDSR, sr;
+   uint32_t t0 = HAL_GetTick();
+   do {
+       nor_cs(GPIO_PIN_RESET);
+       int ok = HAL_SPI_Transmit(nor_spi, &cmd, 1, 2) == HAL_OK &&
+                HAL_SPI_Receive(nor_spi, &sr, 1, 2) == HAL_OK;
+       nor_cs(GPIO_PIN_SET);
+       if (!ok) return -1;
+       if (!(sr & 1U)) return 0;
+   } while (HAL_GetTick() - t0 < ms);
+   return -1;
+}
+
+static int nor_write_op(uint8_t op, uint32_t a, const uint8_t *data, uint16_t len, uint32_t ms)
+{
+   uint8_t wren = NOR_CMD_WREN;
+   uint8_t cmd[4] = { op, (uint8_t)(a >> 16), (uint8_t)(a >> 8), (uint8_t)a };
+   int ok;
+   nor_cs(GPIO_PIN_RESET);
+   ok = HAL_SPI_Transmit(nor_spi, &wren, 1, 2) == HAL_OK;
+   nor_cs(GPIO_PIN_SET);
+   if (!ok) return -1;
+   nor_cs(GPIO_PIN_RESET);
+   ok = HAL_SPI_Transmit(nor_spi, cmd, sizeof(cmd), 2) == HAL_OK &&
+        (len == 0 || HAL_SPI_Transmit(nor_spi, (uint8_t *)data, len, 10) == HAL_OK);
+   nor_cs(GPIO_PIN_SET);
+   return ok ? nor_wait(ms) : -1;
+}
+
+static int dev_write_begin(void)
+{
+   return 0;
+}
+
+/* Sequential: each 4 KB sector is erased when the write reaches it */
+static int dev_write(uint32_t off, const uint8_t *data, uint16_t len)
+{
+   while (len) {
+       uint32_t a = QSTORE_NOR_BASE + off;
+       if (a % NOR_SECTOR == 0 && nor_write_op(NOR_CMD_SE, a, NULL, 0, 500) != 0) return -1;
+       uint16_t n = (uint16_t)(NOR_PAGE - a % NOR_PAGE);
+       if (n > len) n = len;
+       if (nor_write_op(NOR_CMD_PP, a, data, n, 10) != 0) return -1;
+       off += n;
+       data += n;
+       len = (uint16_t)(len - n);
+   }
+   return 0;
+}
+
+static int dev_write_end(void)
+{
+   return 0;
+}
+
+#elif QSTORE_BACKEND == QSTORE_BACKEND_FATFS
+
+#include "ff.h"
+
+static FATFS fs;
+static FIL fil;
+static uint32_t rd_off;
+static uint8_t *rd_dst;
+static uint16_t rd_left;
+
+static int dev_start(uint32_t off, void *dst, uint16_t len)
+{
+   rd_off = off;
+   rd_dst = (uint8_t *)dst;
+   rd_left = len;
+   return 0;
+}
+
+/* FatFs calls block, so read at most QSTORE_FATFS_STEP bytes per run */
+static int dev_poll(void)
+{
+   if (rd_left == 0) return 1;
+   UINT n = rd_left > QSTORE_FATFS_STEP ? QSTORE_FATFS_STEP : rd_left;
+   UINT got = 0;
+   if (f_lseek(&fil, rd_off) != FR_OK || f_read(&fil, rd_dst, n, &got) != FR_OK || got != n) {
+       return -1;
+   }
+   rd_off += n;
+   rd_dst += n;
+   rd_left = (uint16_t)(rd_left - n);
+   return rd_left ? 0 : 1;
+}
+
+/* Uploads rewrite the bank file in place */
+static int dev_write_begin(void)
+{
+   f_close(&fil);
+   return f_open(&fil, QSTORE_FATFS_PATH, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK ? 0 : -1;
+}
+
+static int dev_write(uint32_t off, const uint8_t *data, uint16_t len)
+{
+   UINT put = 0;
+   (void)off;   /* sequential */
+   return f_write(&fil, data, len, &put) == FR_OK && put == len ? 0 : -1;
+}
+
+static int dev_write_end(void)
+{
+   if (f_close(&fil) != FR_OK) return -1;
+   return f_open(&fil, QSTORE_FATFS_PATH, FA_READ) == FR_OK ? 0 : -1;
+}
+
+#else
+#error "unknown QSTORE_BACKEND"
+#endif
+
+/* ---------- Slots ---------- */
+
+typedef enum {
+   SLOT_EMPTY,
+   SLOT_RECORD,     /* reading the question record */
+   SLOT_CHUNK,      /* reading the chunk */
+   SLOT_READY
+} slot_state_t;
+
+typedef struct {
+   slot_state_t state;
+   uint8_t stale;             /* released while its read was in flight */
+   uint16_t q;
+   qbank_question_t rec;
+   qstore_item_t item;
+   char buf[QSTORE_CHUNK_MAX];
+} slot_t;
+
+#define NO_SLOT 0xFFU
+
+static qbank_header_t hdr;
+static slot_t slots[2];
+static uint8_t cur_slot = 0;
+static uint8_t busy_slot = NO_SLOT;   /* slot whose read is in flight */
+static uint8_t uploading = 0;
+
+static void slot_fail(slot_t *s)
+{
+   set_unreadable(&s->item, s->q);
+   s->state = SLOT_READY;
+}
+
+static void slot_start(uint8_t i, uint16_t q)
+{
+   slot_t *s = &slots[i];
+   s->q = q;
+   s->stale = 0;
+   s->state = SLOT_RECORD;
+   if (dev_start(hdr.question_off + (uint32_t)q * sizeof(qbank_question_t),
+                 &s->rec, sizeof(s->rec)) != 0) {
+       slot_fail(s);
+       return;
+   }
+   busy_slot = i;
+}
+
+/* The read for slot i finished (ok = 1) or failed (ok = 0) */
+static void slot_read_done(uint8_t i, int ok)
+{
+   slot_t *s = &slots[i];
+   busy_slot = NO_SLOT;
+   if (s->stale) {
+       s->stale = 0;
+       s->state = SLOT_EMPTY;
+       return;
+   }
+   if (!ok) {
+       slot_fail(s);
+       return;
+   }
+   if (s->state == SLOT_RECORD) {
+       if (s->rec.chunk_len == 0 || s->rec.chunk_len > QSTORE_CHUNK_MAX) {
+           slot_fail(s);
+           return;
+       }
+       s->state = SLOT_CHUNK;
+       if (dev_start(hdr.pool_off + s->rec.text_off, s->buf, s->rec.chunk_len) != 0) {
+           slot_fail(s);
+           return;
+       }
+       busy_slot = i;
+   } else {
+       if (parse_chunk(&s->item, s->q, &s->rec, s->buf, hdr.cols) != 0) {
+           slot_fail(s);
+           return;
+       }
+       s->state = SLOT_READY;
+   }
+}
+
+static void slot_release(uint8_t i)
+{
+   if (busy_slot == i) slots[i].stale = 1;
+   else slots[i].state = SLOT_EMPTY;
+}
+
+/* Read the header synchronously (start-up only) */
+static int read_header(void)
+{
+   if (dev_start(0, &hdr, sizeof(hdr)) != 0) return -1;
+   uint32_t t0 = HAL_GetTick();
+   int r;
+   while ((r = dev_poll()) == 0) {
+       if (HAL_GetTick() - t0 > 500U) return -1;
+   }
+   if (r < 0) return -1;
+   /* the CRC would need the whole bank read; check the framing instead */
+   if (hdr.magic != QBANK_MAGIC || hdr.version != QBANK_VERSION) return -1;
+   if (hdr.num_questions == 0 || hdr.pool_off + hdr.pool_size > hdr.total_size) return -1;
+   return 0;
+}
+
+/* Back to question 0 with both slots empty */
+static void restart(void)
+{
+   cur_q = 0;
+   cur_slot = 0;
+   busy_slot = NO_SLOT;
+   slots[0].state = SLOT_EMPTY;
+   slots[1].state = SLOT_EMPTY;
+   qstore_task();
+}
+
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+int qstore_init(SPI_HandleTypeDef *hspi)
+{
+   nor_spi = hspi;
+   nor_cs(GPIO_PIN_SET);
+#else
+int qstore_init(void)
+{
+   if (f_mount(&fs, "", 1) != FR_OK) return -1;
+   if (f_open(&fil, QSTORE_FATFS_PATH, FA_READ) != FR_OK) return -1;
+#endif
+   if (read_header() != 0) return -1;
+   restart();
+   return 0;
+}
+
+uint16_t qstore_count(void)
+{
+   return hdr.num_questions;
+}
+
+uint8_t qstore_cols(void)
+{
+   return hdr.cols;
+}
+
+const qstore_item_t *qstore_current(void)
+{
+   const slot_t *s = &slots[cur_slot];
+   if (uploading) return NULL;
+   return (s->state == SLOT_READY && s->q == cur_q) ? &s->item : NULL;
+}
+
+int qstore_next(void)
+{
+   if (hdr.num_questions < 2) return 1;   /* the one question stays loaded */
+   uint16_t nq = (uint16_t)((cur_q + 1) % hdr.num_questions);
+   uint8_t other = cur_slot ^ 1U;
+   slot_release(cur_slot);
+   if (slots[other].state != SLOT_EMPTY && !slots[other].stale && slots[other].q == nq) {
+       cur_slot = other;                  /* prefetched (or on its way) */
+   }
+   if (slots[cur_slot].state != SLOT_READY) misses++;
+   cur_q = nq;
+   qstore_task();
+   return nq == 0;
+}
+
+void qstore_task(void)
+{
+   if (uploading) return;
+   if (busy_slot != NO_SLOT) {
+       int r = dev_poll();
+       if (r == 0) return;
+       slot_read_done(busy_slot, r > 0);
+       if (busy_slot != NO_SLOT) return;  /* chained the chunk read */
+   }
+   slot_t *c = &slots[cur_slot];
+   if (c->state == SLOT_EMPTY) {
+       slot_start(cur_slot, cur_q);
+   } else if (c->state == SLOT_READY && hdr.num_questions > 1) {
+       uint8_t other = cur_slot ^ 1U;
+       if (slots[other].state == SLOT_EMPTY) {
+           slot_start(other, (uint16_t)((cur_q + 1) % hdr.num_questions));
+       }
+   }
+}
+
+/* ---------- Bank upload ---------- */
+
+static uint32_t up_size;
+static uint32_t up_done;
+static uint32_t up_crc;
+static qbank_header_t up_hdr;   /* the new header, as it goes past */
+
+int qstore_upload_begin(uint32_t size)
+{
+   /* let a read in flight finish before the storage is rewritten */
+   uint32_t t0 = HAL_GetTick();
+   while (busy_slot != NO_SLOT && dev_poll() == 0 && HAL_GetTick() - t0 < 100U) { }
+   uploading = 1;
+   busy_slot = NO_SLOT;
+   up_size = size;
+   up_done = 0;
+   up_crc = 0;
+   memset(&up_hdr, 0, sizeof(up_hdr));
+   if (size < sizeof(qbank_header_t)) return -1;
+   return dev_write_begin();
+}
+
+int qstore_upload_write(uint32_t off, const uint8_t *data, uint16_t len)
+{
+   if (!uploading || off != up_done || len > up_size - up_done) return -1;
+   if (dev_write(off, data, len) != 0) return -1;
+   for (uint16_t i = 0; i < len; ++i, ++off) {
+       if (off < sizeof(up_hdr)) ((uint8_t *)&up_hdr)[off] = data[i];
+       else up_crc = qbank_crc32(up_crc, &data[i], 1);
+   }
+   up_done += len;
+   return 0;
+}
+
+int qstore_upload_end(void)
+{
+   if (!uploading) return -1;
+   int rc = dev_write_end();
+   if (rc == 0 && (up_done != up_size || up_hdr.total_size != up_size || up_crc != up_hdr.crc32)) {
+       rc = -1;
+   }
+   if (rc == 0) rc = read_header();
+   /* a bad upload leaves no bank: qstore_current() stays NULL */
+   if (rc != 0) return -1;
+   uploading = 0;
+   restart();
+   return 0;
+}
+
+#endif /* QSTORE_BACKEND */
+
+uint32_t qstore_misses(void)
+{
+   return misses;
+}
@@ -0,0 +1,97 @@
+#ifndef QSTORE_H
+#define QSTORE_H
+#include "main.h"
+#include "qbank.h"
+/*
+* qstore.h - question bank storage with a prefetching iterator.
+*
+* The packed bank (qbank.h) can live in one of three places, picked at
+* build time with QSTORE_BACKEND:
+*
+*   QSTORE_BACKEND_INTERNAL  linked into internal flash (qbank_blob.c); the
+*                            items point straight into flash, no copies
+*   QSTORE_BACKEND_SPI_NOR   raw blob in a 25-series SPI NOR (W25Qxx &c.)
+*                            at QSTORE_NOR_BASE, read with 0x03 + DMA
+*   QSTORE_BACKEND_FATFS     QSTORE_FATFS_PATH on an SD card via FatFs
+*
+* For the external backends each question is one chunk read into a RAM
+* slot. There are two slots: the one being shown/answered and the one the
+* next question is prefetched into while the player thinks, so advancing
+* normally finds the next question already loaded. qstore_task() drives the
+* loads and must be run from the scheduler.
+*/
+#define QSTORE_BACKEND_INTERNAL 0
+#define QSTORE_BACKEND_SPI_NOR  1
+#define QSTORE_BACKEND_FATFS    2
+
+#ifndef QSTORE_BACKEND
+#define QSTORE_BACKEND QSTORE_BACKEND_INTERNAL
+#endif
+
+/* Largest question chunk the slots can hold (qbank_pack.py --chunk-max) */
+#ifndef QSTORE_CHUNK_MAX
+#define QSTORE_CHUNK_MAX 256
+#endif
+
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+#ifndef QSTORE_NOR_BASE
+#define QSTORE_NOR_BASE 0x000000UL   /* flash address of the blob (4 KB aligned for uploads) */
+#endif
+#ifndef QSTORE_NOR_CS_PORT
+#define QSTORE_NOR_CS_PORT GPIOA
+#define QSTORE_NOR_CS_PIN  GPIO_PIN_4
+#endif
+#elif QSTORE_BACKEND == QSTORE_BACKEND_FATFS
+#ifndef QSTORE_FATFS_PATH
+#define QSTORE_FATFS_PATH "QBANK.BIN"
+#endif
+/* Bytes read per qstore_task() run, so one run never blocks for long */
+#ifndef QSTORE_FATFS_STEP
+#define QSTORE_FATFS_STEP 512
+#endif
+#endif
+
+/* One loaded question. Pointers stay valid until the item is advanced past. */
+typedef struct {
+   uint16_t q;
+   uint8_t num_lines;
+   uint8_t max_dist;
+   uint16_t num_variants;
+   const char *text;
+   const char *rows;       /* num_lines rows of qstore_cols() bytes */
+   const char *variants;   /* num_variants NUL-terminated strings, back to back */
+} qstore_item_t;
+
+/* Open the bank and start loading question 0. Returns 0, or -1 if the
+   storage or the bank header is bad. */
+#if QSTORE_BACKEND == QSTORE_BACKEND_SPI_NOR
+int qstore_init(SPI_HandleTypeDef *hspi);
+#else
+int qstore_init(void);
+#endif
+uint16_t qstore_count(void);
+uint8_t qstore_cols(void);
+/* Current question, or NULL while it is still being read */
+const qstore_item_t *qstore_current(void);
+/* Move to the next question; returns 1 if it wrapped back to question 0 */
+int qstore_next(void);
+/* Times the iterator had to wait for storage (prefetch did not keep up) */
+uint32_t qstore_misses(void);
+/* Scheduler task: advances reads and prefetches */
+void qstore_task(void);
+/* Replace the stored bank (the link's bank upload): begin with the blob
+   size, write it front to back, then end checks it against its header
+   CRC and restarts at question 0. Meanwhile qstore_current() is NULL.
+   The blocking SPI NOR erases (one per 4 KB) and FatFs writes stall the
+   caller. Streamed backends only; with the internal one the bank is part
+   of the image and every call returns -1. */
+int qstore_upload_begin(uint32_t size);
+int qstore_upload_write(uint32_t off, const uint8_t *data, uint16_t len);
+int qstore_upload_end(void);
+/* Step to the variant after v in an item's variants list */
+static inline const char *qstore_next_variant(const char *v)
+{
+   while (*v) v++;
+   return v + 1;
+}
+#endif /* QSTORE_H */
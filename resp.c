@@ -0,0 +1,51 @@
+/*
+* resp.c - response-time statistics (see resp.h)
+*/
+
+#include "resp.h"
+#include <string.h>
+
+static uint32_t samples[RESP_MAX_SAMPLES];
+static uint16_t kept = 0;
+static uint16_t count = 0;
+static uint32_t min_ms = 0;
+static uint64_t sum_ms = 0;
+
+void resp_reset(void)
+{
+   kept = 0;
+   count = 0;
+   min_ms = 0;
+   sum_ms = 0;
+}
+
+void resp_add(uint32_t ms)
+{
+   if (count == 0 || ms < min_ms) min_ms = ms;
+   if (count < UINT16_MAX) count++;
+   sum_ms += ms;
+   if (kept < RESP_MAX_SAMPLES) samples[kept++] = ms;
+}
+
+int resp_summary(resp_summary_t *out)
+{
+   memset(out, 0, sizeof(*out));
+   if (count == 0) return 0;
+   out->count = count;
+   out->min_ms = min_ms;
+   out->mean_ms = (uint32_t)(sum_ms / count);
+
+   /* insertion sort: a round is a few dozen samples at most */
+   uint32_t s[RESP_MAX_SAMPLES];
+   memcpy(s, samples, kept * sizeof(s[0]));
+   for (uint16_t i = 1; i < kept; ++i) {
+       uint32_t v = s[i];
+       uint16_t j = i;
+       while (j > 0 && s[j - 1] > v) { s[j] = s[j - 1]; --j; }
+       s[j] = v;
+   }
+   /* nearest rank: smallest sample with at least 95% at or below it */
+   uint16_t rank = (uint16_t)((kept * 95U + 99U) / 100U);
+   out->p95_ms = s[rank ? rank - 1 : 0];
+   return 1;
+}
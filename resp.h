@@ -0,0 +1,28 @@
+#ifndef RESP_H
+#define RESP_H
+#include <stdint.h>
+/*
+* resp.h - response-time statistics for a round.
+*
+* The quiz adds one sample per answered question (milliseconds from the
+* question becoming visible to the answer's line terminator). The stats are
+* summarised at the end of the round and then reset. The first
+* RESP_MAX_SAMPLES samples are kept for the percentile; min and mean cover
+* every sample.
+*/
+#ifndef RESP_MAX_SAMPLES
+#define RESP_MAX_SAMPLES 64
+#endif
+
+typedef struct {
+   uint16_t count;
+   uint32_t min_ms;
+   uint32_t mean_ms;
+   uint32_t p95_ms;
+} resp_summary_t;
+
+void resp_reset(void);
+void resp_add(uint32_t ms);
+/* Returns 0 (and leaves *out zeroed) if there are no samples */
+int resp_summary(resp_summary_t *out);
+#endif /* RESP_H */
@@ -0,0 +1,54 @@
+/*
+* sched.c - cooperative tick scheduler (see sched.h)
+*/
+
+#include "sched.h"
+#include "stm32f4xx_hal.h"
+#include <stddef.h>
+
+typedef struct {
+   sched_fn_t fn;
+   uint32_t period_ms;
+   uint32_t next_ms;
+} sched_task_t;
+
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static uint8_t task_count = 0;
+
+int sched_add(sched_fn_t fn, uint32_t period_ms)
+{
+   if (task_count >= SCHED_MAX_TASKS || fn == NULL) return -1;
+   tasks[task_count].fn = fn;
+   tasks[task_count].period_ms = period_ms ? period_ms : 1;
+   tasks[task_count].next_ms = HAL_GetTick();
+   return task_count++;
+}
+
+void sched_run(void)
+{
+   for (uint8_t i = 0; i < task_count; ++i) {
+       sched_task_t *t = &tasks[i];
+       uint32_t now = HAL_GetTick();
+       if ((int32_t)(now - t->next_ms) < 0) continue;
+
+       t->fn();
+
+       /* keep the cadence, but do not try to catch up after a long stall */
+       t->next_ms += t->period_ms;
+       if ((int32_t)(HAL_GetTick() - t->next_ms) >= 0) {
+           t->next_ms = HAL_GetTick() + t->period_ms;
+       }
+   }
+}
+
+uint32_t sched_next_due_ms(void)
+{
+   uint32_t now = HAL_GetTick();
+   uint32_t best = UINT32_MAX;
+   for (uint8_t i = 0; i < task_count; ++i) {
+       int32_t d = (int32_t)(tasks[i].next_ms - now);
+       if (d <= 0) return 0;
+       if ((uint32_t)d < best) best = (uint32_t)d;
+   }
+   return best;
+}
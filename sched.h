@@ -0,0 +1,24 @@
+#ifndef SCHED_H
+#define SCHED_H
+#include <stdint.h>
+/*
+* sched.h - tiny cooperative scheduler on the HAL 1 ms tick.
+*
+* Tasks are plain functions run from the main loop when their period has
+* elapsed. They must not block: anything that takes time is started and
+* then checked again on a later run. The worst-case reaction time to an
+* event is therefore the longest single task run plus one period.
+*/
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS 8
+#endif
+
+typedef void (*sched_fn_t)(void);
+
+/* Register a task; returns its id, or -1 if the table is full */
+int sched_add(sched_fn_t fn, uint32_t period_ms);
+/* Run every task that is due (call from the main loop) */
+void sched_run(void);
+/* Milliseconds until the next task is due (0 = something is due now) */
+uint32_t sched_next_due_ms(void);
+#endif /* SCHED_H */
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+"""Pack questions.txt into the flash-resident question bank (see qbank.h).
+
+The output is one little-endian blob: a header, a fixed-size record per
+question, a variant offset table, the answer index sorted by hash and a
+string pool holding, per question, one contiguous chunk with the question
+text, the question word-wrapped into LCD rows and pages (wrap_rows) and the
+normalized answers.
+From internal flash the firmware reads it in place; from SPI NOR or an SD
+card it loads one chunk per question (see qstore.h). By default the blob is
+written as a C array (qbank_blob.c) that links into the image; --bin writes
+the raw bytes to program into external flash or copy to the card.
+
+The answer index lets the firmware check an answer with one
+normalize-and-hash pass, a binary search and a single string compare.
+Normalization and hashing here must match answer_normalize_hash() in
+answer.c.
+"""
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+FNV_OFFSET = 0x811C9DC5
+FNV_PRIME = 0x01000193
+
+
+ASCII_WS = " \t\n\r\v\f"
+
+
+def normalize(s):
+    """Trim, lowercase ASCII, collapse whitespace runs to one space.
+
+    Only ASCII is folded, exactly like isspace()/tolower() in the C locale.
+    """
+    words = [w for w in "".join(" " if c in ASCII_WS else c for c in s).split(" ") if w]
+    return "".join(chr(ord(c) + 32) if "A" <= c <= "Z" else c for c in " ".join(words))
+
+
+def fnv1a(h, byte):
+    return ((h ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+
+
+def answer_hash(question, text):
+    h = FNV_OFFSET
+    h = fnv1a(h, question & 0xFF)
+    h = fnv1a(h, (question >> 8) & 0xFF)
+    for b in text.encode("utf-8"):
+        h = fnv1a(h, b)
+    return h
+
+
+def parse(path):
+    questions = []
+    with open(path, encoding="utf-8") as f:
+        for lineno, raw in enumerate(f, 1):
+            line = raw.rstrip("\r\n")
+            if not line.strip() or line.lstrip().startswith("#"):
+                continue
+            tag, _, rest = line.partition(":")
+            tag = tag.strip().upper()
+            if tag == "Q":
+                # layout is done by wrap_rows(), so spacing is not significant
+                questions.append({"text": " ".join(rest.split()),
+                                  "answers": [], "max_dist": 0})
+            elif tag == "A":
+                if not questions:
+                    sys.exit("%s:%d: answer before any question" % (path, lineno))
+                for v in rest.split("|"):
+                    v = normalize(v)
+                    if v and v not in questions[-1]["answers"]:
+                        questions[-1]["answers"].append(v)
+            elif tag == "D":
+                if not questions:
+                    sys.exit("%s:%d: distance before any question" % (path, lineno))
+                try:
+                    d = int(rest.strip())
+                except ValueError:
+                    sys.exit("%s:%d: 'D:' needs a number" % (path, lineno))
+                if not 0 <= d <= 255:
+                    sys.exit("%s:%d: distance out of range" % (path, lineno))
+                questions[-1]["max_dist"] = d
+            else:
+                sys.exit("%s:%d: expected 'Q:', 'A:' or 'D:'" % (path, lineno))
+    for i, q in enumerate(questions):
+        if not q["answers"]:
+            sys.exit("%s: question %d has no answers" % (path, i + 1))
+    return questions
+
+
+QBANK_MAGIC = 0x314B4251  # "QBK1"
+QBANK_VERSION = 2
+HEADER_FMT = "<IHHHHBBHIIIIIII"
+QUESTION_FMT = "<IIHHBBH"
+KEY_FMT = "<IHH"
+
+
+def wrap_rows(text, cols, rows):
+    """Word wrap into rows of `cols` bytes, padded out to whole pages.
+
+    Greedy: as many words per row as fit, one space between them. A word
+    longer than a row is split across rows. Rows are space padded and the
+    last page is filled with blank rows, so the firmware can copy any page
+    as `rows` full rows.
+    """
+    lines = []
+    cur = b""
+    for w in text.encode("utf-8").split():
+        while len(w) > cols:
+            if cur:
+                lines.append(cur)
+                cur = b""
+            lines.append(w[:cols])
+            w = w[cols:]
+        if not w:
+            continue
+        if not cur:
+            cur = w
+        elif len(cur) + 1 + len(w) <= cols:
+            cur += b" " + w
+        else:
+            lines.append(cur)
+            cur = w
+    if cur or not lines:
+        lines.append(cur)
+    lines += [b""] * (-len(lines) % rows)
+    return [r.ljust(cols, b" ") for r in lines]
+
+
+def align4(buf):
+    buf += b"\0" * (-len(buf) % 4)
+
+
+def pack(questions, cols, rows, chunk_max):
+    pool = bytearray()
+    records = []
+    variant_offs = []
+    index = []
+    for qi, q in enumerate(questions):
+        # One contiguous chunk per question: text NUL, rows, variants NUL,
+        # so a streaming backend loads a question with a single read.
+        text_off = len(pool)
+        pool += q["text"].encode("utf-8") + b"\0"
+        lines = wrap_rows(q["text"], cols, rows)
+        if len(lines) > 255:
+            sys.exit("question %d is too long" % (qi + 1))
+        lines_off = len(pool)
+        pool += b"".join(lines)
+        first = len(variant_offs)
+        for vi, a in enumerate(q["answers"]):
+            index.append((answer_hash(qi, a), qi, vi))
+            variant_offs.append(len(pool))
+            pool += a.encode("utf-8") + b"\0"
+        chunk_len = len(pool) - text_off
+        if chunk_len > chunk_max:
+            sys.exit("question %d needs %d bytes, more than --chunk-max %d"
+                     % (qi + 1, chunk_len, chunk_max))
+        records.append((text_off, lines_off, first, len(q["answers"]),
+                        len(lines), q["max_dist"], chunk_len))
+    index.sort()
+    if len(questions) > 0xFFFF or len(variant_offs) > 0xFFFF:
+        sys.exit("too many questions or answers for 16-bit indices")
+
+    body = bytearray()
+    hdr_size = struct.calcsize(HEADER_FMT)
+    question_off = hdr_size
+    for r in records:
+        body += struct.pack(QUESTION_FMT, *r)
+    variant_off = hdr_size + len(body)
+    for off in variant_offs:
+        body += struct.pack("<I", off)
+    index_off = hdr_size + len(body)
+    for k in index:
+        body += struct.pack(KEY_FMT, *k)
+    pool_off = hdr_size + len(body)
+    body += pool
+    align4(body)
+    total = hdr_size + len(body)
+    header = struct.pack(HEADER_FMT, QBANK_MAGIC, QBANK_VERSION, 0,
+                         len(questions), len(variant_offs), cols, rows, 0,
+                         question_off, variant_off, index_off, pool_off,
+                         len(pool), total, zlib.crc32(bytes(body)))
+    return header + bytes(body)
+
+
+def emit_c(blob, path, src_name):
+    out = ["/* Generated by tools/qbank_pack.py from %s - do not edit */" % src_name,
+           "#include \"qbank.h\"",
+           "",
+           "/* %d bytes, packed question bank (layout in qbank.h) */" % len(blob),
+           "__attribute__((aligned(4)))",
+           "const uint8_t qbank_blob[%d] = {" % len(blob)]
+    for i in range(0, len(blob), 12):
+        out.append("   " + " ".join("0x%02X," % b for b in blob[i:i + 12]))
+    out.append("};")
+    with open(path, "w", newline="\n") as f:
+        f.write("\n".join(out) + "\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("source", help="questions.txt")
+    ap.add_argument("-o", "--output", default="qbank_blob.c", help="C array to write")
+    ap.add_argument("--bin", help="also write the raw blob here")
+    ap.add_argument("--cols", type=int, default=16, help="LCD columns (LCD_COLS)")
+    ap.add_argument("--rows", type=int, default=2, help="LCD rows (LCD_ROWS)")
+    ap.add_argument("--chunk-max", type=int, default=256,
+                    help="largest question chunk (QSTORE_CHUNK_MAX)")
+    args = ap.parse_args()
+    if not 1 <= args.cols <= 255 or not 1 <= args.rows <= 255:
+        sys.exit("bad display geometry")
+    blob = pack(parse(args.source), args.cols, args.rows, args.chunk_max)
+    emit_c(blob, args.output, os.path.basename(args.source))
+    if args.bin:
+        with open(args.bin, "wb") as f:
+            f.write(blob)
+
+
+if __name__ == "__main__":
+    main()
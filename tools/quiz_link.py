@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""Drive the quiz over its binary UART protocol (see proto.h).
+
+Every request waits for its reply frame, so the device's two-frame receive
+queue never overflows. Needs pyserial.
+
+    quiz_link.py -p /dev/ttyUSB0 ping
+    quiz_link.py -p /dev/ttyUSB0 --baud 921600 check answers.txt
+    quiz_link.py -p /dev/ttyUSB0 upload bank.bin
+    quiz_link.py -p /dev/ttyUSB0 stats
+    quiz_link.py -p /dev/ttyUSB0 totals 0 40
+    quiz_link.py -p /dev/ttyUSB0 lcd 0 0 "Rig connected"
+    quiz_link.py -p /dev/ttyUSB0 led 2 500
+
+--baud switches the link up from QUIZ_UART_BAUD first (until the next
+reset). check takes "question<TAB>answer" lines and prints the verdicts;
+answers sends plain lines to the running quiz as if typed.
+"""
+import argparse
+import struct
+import sys
+import time
+
+SYNC = 0xA5
+REPLY = 0x80
+MAX_PAYLOAD = 256
+
+T_PING, T_BAUD = 0x01, 0x02
+T_ANSWERS, T_CHECK = 0x10, 0x11
+T_BANK_BEGIN, T_BANK_DATA, T_BANK_END = 0x20, 0x21, 0x22
+T_STATS, T_TOTALS = 0x30, 0x31
+T_LCD_TEXT, T_LCD_CLEAR, T_LED = 0x40, 0x41, 0x42
+
+STATUS = ["ok", "bad length", "unknown type", "unsupported", "failed", "busy"]
+VERDICT = ["wrong", "right", "unchecked"]
+STATS = ["uptime_ms", "round", "log_records", "log_errors", "uart_dropped",
+         "frames", "frame_crc_errors", "frames_dropped", "prefetch_misses",
+         "lcd_errors", "lcd_bus_hz", "question"]
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT, as proto.c computes it."""
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def frame(ftype, payload=b""):
+    body = struct.pack("<HB", len(payload), ftype) + payload
+    return bytes([SYNC]) + body + struct.pack("<H", crc16(body))
+
+
+class Link:
+    def __init__(self, port, baud, timeout):
+        import serial
+        self.ser = serial.Serial(port, baud, timeout=timeout)
+
+    def _read_frame(self):
+        # skip console text until a sync byte
+        while True:
+            b = self.ser.read(1)
+            if not b:
+                sys.exit("no reply")
+            if b[0] == SYNC:
+                break
+        head = self.ser.read(3)
+        if len(head) < 3:
+            sys.exit("short reply")
+        n, ftype = struct.unpack("<HB", head)
+        rest = self.ser.read(n + 2)
+        if len(rest) < n + 2 or crc16(head + rest[:n]) != struct.unpack("<H", rest[n:])[0]:
+            sys.exit("reply CRC mismatch")
+        return ftype, rest[:n]
+
+    def request(self, ftype, payload=b""):
+        self.ser.write(frame(ftype, payload))
+        while True:
+            rtype, data = self._read_frame()
+            if rtype == ftype | REPLY:
+                break
+        if not data:
+            sys.exit("empty reply")
+        return data[0], data[1:]
+
+    def ok(self, ftype, payload=b""):
+        status, data = self.request(ftype, payload)
+        if status:
+            sys.exit("request 0x%02x: %s" % (ftype, STATUS[status] if status < len(STATUS) else status))
+        return data
+
+    def set_baud(self, baud):
+        self.ok(T_BAUD, struct.pack("<I", baud))
+        self.ser.flush()
+        time.sleep(0.05)   # the quiz switches once its reply is out
+        self.ser.baudrate = baud
+
+
+def batches(entries, size):
+    """Group encoded entries into payloads of at most size bytes."""
+    out = b""
+    for e in entries:
+        if out and len(out) + len(e) > size:
+            yield out
+            out = b""
+        out += e
+    if out:
+        yield out
+
+
+def cmd_check(link, args):
+    items = []
+    with open(args.file, encoding="utf-8") as f:
+        for line in f:
+            q, _, text = line.rstrip("\r\n").partition("\t")
+            if q.strip():
+                items.append((int(q), text.encode("utf-8")[:255]))
+    entries = [struct.pack("<HB", q, len(t)) + t for q, t in items]
+    at = 0
+    for payload in batches(entries, MAX_PAYLOAD - 1):
+        data = link.ok(T_CHECK, payload)
+        n = struct.unpack("<H", data[:2])[0]
+        for v in data[2:2 + n]:
+            q, t = items[at]
+            print("%u\t%s\t%s" % (q, VERDICT[v] if v < len(VERDICT) else v, t.decode("utf-8")))
+            at += 1
+
+
+def cmd_answers(link, args):
+    with open(args.file, encoding="utf-8") as f:
+        lines = [l.rstrip("\r\n").encode("utf-8")[:255] for l in f if l.strip()]
+    entries = [bytes([len(t)]) + t for t in lines]
+    for payload in batches(entries, MAX_PAYLOAD):
+        while payload:
+            queued = struct.unpack("<H", link.ok(T_ANSWERS, payload))[0]
+            # the quiz's queue was full: drop what it took and retry the rest
+            for _ in range(queued):
+                payload = payload[1 + payload[0]:]
+            if payload:
+                time.sleep(0.5)
+    print("%u answers queued" % len(lines))
+
+
+def cmd_upload(link, args):
+    with open(args.file, "rb") as f:
+        blob = f.read()
+    link.ok(T_BANK_BEGIN, struct.pack("<I", len(blob)))
+    step = MAX_PAYLOAD - 4
+    for off in range(0, len(blob), step):
+        link.ok(T_BANK_DATA, struct.pack("<I", off) + blob[off:off + step])
+    link.ok(T_BANK_END)
+    print("%u bytes uploaded" % len(blob))
+
+
+def cmd_stats(link, args):
+    data = link.ok(T_STATS)
+    vals = struct.unpack("<%uI" % (len(data) // 4), data)
+    for name, v in zip(STATS, vals):
+        print("%-18s %u" % (name, v))
+    for p, v in enumerate(vals[len(STATS):]):
+        print("score_p%-11u %d" % (p + 1, struct.unpack("<i", struct.pack("<I", v))[0]))
+
+
+def cmd_totals(link, args):
+    q, left = args.first, args.count
+    print("q,asked,correct,timed,ms_sum")
+    while left > 0:
+        data = link.ok(T_TOTALS, struct.pack("<HB", q, min(left, 255)))
+        n = data[2]
+        if n == 0:
+            break
+        for i in range(n):
+            print("%u,%u,%u,%u,%u" % ((q + i,) + struct.unpack("<4I", data[3 + 16 * i:19 + 16 * i])))
+        q += n
+        left -= n
+
+
+def cmd_lcd(link, args):
+    if args.text is None:
+        link.ok(T_LCD_CLEAR)
+    else:
+        link.ok(T_LCD_TEXT, bytes([args.row, args.col]) + args.text.encode("ascii", "replace"))
+
+
+def cmd_led(link, args):
+    link.ok(T_LED, struct.pack("<BH", args.mask, args.ms))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("-p", "--port", required=True, help="serial port of USART1")
+    ap.add_argument("--rate", type=int, default=9600, help="rate the quiz runs at now (QUIZ_UART_BAUD)")
+    ap.add_argument("--baud", type=int, help="switch the link to this rate first")
+    ap.add_argument("--timeout", type=float, default=3.0, help="seconds to wait for a reply")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    sub.add_parser("ping")
+    p = sub.add_parser("check", help="verdicts for question<TAB>answer lines")
+    p.add_argument("file")
+    p = sub.add_parser("answers", help="send lines to the quiz as typed answers")
+    p.add_argument("file")
+    p = sub.add_parser("upload", help="replace the bank (qbank_pack.py --bin output)")
+    p.add_argument("file")
+    sub.add_parser("stats")
+    p = sub.add_parser("totals", help="per-question history from the flash log")
+    p.add_argument("first", type=int)
+    p.add_argument("count", type=int)
+    p = sub.add_parser("lcd", help="write text at row/col (no text: clear)")
+    p.add_argument("row", type=int, nargs="?", default=0)
+    p.add_argument("col", type=int, nargs="?", default=0)
+    p.add_argument("text", nargs="?")
+    p = sub.add_parser("led", help="light LEDs (bit 0 R, 1 G, 2 B) for ms")
+    p.add_argument("mask", type=int)
+    p.add_argument("ms", type=int)
+    args = ap.parse_args()
+
+    link = Link(args.port, args.rate, args.timeout)
+    if args.baud:
+        link.set_baud(args.baud)
+    if args.cmd == "ping":
+        version, max_payload, room = struct.unpack("<BHH", link.ok(T_PING))
+        print("protocol %u, %u-byte payloads, %u bytes of answer queue free" % (version, max_payload, room))
+    else:
+        globals()["cmd_" + args.cmd](link, args)
+
+
+if __name__ == "__main__":
+    main()
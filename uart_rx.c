@@ -0,0 +1,162 @@
+/*
+* uart_rx.c - circular DMA receive + line queue (see uart_rx.h)
+*/
+
+#include "uart_rx.h"
+#include <string.h>
+
+/* One receiving UART: its DMA ring, the line being assembled (ISR only)
+   and the completed lines (ISR writes at line_wr, thread reads at line_rd) */
+typedef struct {
+   UART_HandleTypeDef *huart;
+   uart_rx_hook_fn_t hook;            /* binary frames, see uart_rx_set_hook() */
+   uint8_t dma_ring[UART_RX_DMA_SIZE];
+   uint16_t dma_pos;                  /* next ring index not yet parsed */
+   char cur_line[UART_LINE_MAX];
+   uint16_t cur_len;
+   uint8_t last_was_cr;
+   char lines[UART_RX_LINES][UART_LINE_MAX];
+   uint8_t line_lens[UART_RX_LINES];
+   uint32_t line_stamps[UART_RX_LINES];
+   volatile uint8_t line_rd;
+   volatile uint8_t line_wr;
+   volatile uint32_t lines_dropped;
+} rx_port_t;
+
+static rx_port_t ports[UART_RX_PORTS];
+static uint8_t num_ports = 0;
+static uart_rx_clock_fn_t rx_clock = NULL;
+
+static void push_line(rx_port_t *p)
+{
+   uint8_t next = (uint8_t)((p->line_wr + 1) % UART_RX_LINES);
+   if (next == p->line_rd) {
+       p->lines_dropped++;
+   } else {
+       memcpy(p->lines[p->line_wr], p->cur_line, p->cur_len);
+       p->lines[p->line_wr][p->cur_len] = '\0';
+       p->line_lens[p->line_wr] = (uint8_t)p->cur_len;
+       p->line_stamps[p->line_wr] = rx_clock ? rx_clock() : HAL_GetTick();
+       p->line_wr = next;
+   }
+   p->cur_len = 0;
+}
+
+static void parse_bytes(rx_port_t *p, const uint8_t *d, uint16_t n)
+{
+   while (n--) {
+       uint8_t ch = *d++;
+       if (p->hook && p->hook(ch, p->cur_len == 0)) {
+           p->last_was_cr = 0;
+           continue;
+       }
+       if (ch == '\r' || ch == '\n') {
+           /* LF straight after CR is the second half of CRLF */
+           if (!(ch == '\n' && p->last_was_cr)) push_line(p);
+           p->last_was_cr = (ch == '\r');
+           continue;
+       }
+       p->last_was_cr = 0;
+       /* keep the first UART_LINE_MAX-1 bytes, drop the rest of the line */
+       if (p->cur_len < UART_LINE_MAX - 1) p->cur_line[p->cur_len++] = (char)ch;
+   }
+}
+
+static rx_port_t *find_port(UART_HandleTypeDef *huart)
+{
+   for (uint8_t i = 0; i < num_ports; ++i) {
+       if (ports[i].huart == huart) return &ports[i];
+   }
+   return NULL;
+}
+
+int uart_rx_start(UART_HandleTypeDef *huart)
+{
+   rx_port_t *p = find_port(huart);
+   if (!p) {
+       if (num_ports >= UART_RX_PORTS) return -1;
+       p = &ports[num_ports++];
+   }
+   p->huart = huart;
+   p->dma_pos = 0;
+   p->cur_len = 0;
+   p->last_was_cr = 0;
+   HAL_UARTEx_ReceiveToIdle_DMA(huart, p->dma_ring, UART_RX_DMA_SIZE);
+   return (int)(p - ports);
+}
+
+void uart_rx_set_clock(uart_rx_clock_fn_t now)
+{
+   rx_clock = now;
+}
+
+/* Called by HAL on IDLE, DMA half transfer and DMA transfer complete.
+   pos is the DMA write index (UART_RX_DMA_SIZE on full transfer). */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t pos)
+{
+   rx_port_t *p = find_port(huart);
+   if (!p) return;
+   if (pos != p->dma_pos) {
+       if (pos > p->dma_pos) {
+           parse_bytes(p, &p->dma_ring[p->dma_pos], (uint16_t)(pos - p->dma_pos));
+       } else {
+           parse_bytes(p, &p->dma_ring[p->dma_pos], (uint16_t)(UART_RX_DMA_SIZE - p->dma_pos));
+           parse_bytes(p, &p->dma_ring[0], pos);
+       }
+       p->dma_pos = pos;
+   }
+   if (p->dma_pos >= UART_RX_DMA_SIZE) p->dma_pos = 0;
+}
+
+/* Overrun/noise/framing errors abort the DMA; restart reception */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+   rx_port_t *p = find_port(huart);
+   if (!p) return;
+   p->dma_pos = 0;
+   HAL_UARTEx_ReceiveToIdle_DMA(huart, p->dma_ring, UART_RX_DMA_SIZE);
+}
+
+void uart_rx_set_hook(uint8_t port, uart_rx_hook_fn_t hook)
+{
+   if (port < num_ports) ports[port].hook = hook;
+}
+
+int uart_rx_get_line_port(uint8_t port, char *out, uint16_t size, uint32_t *stamp)
+{
+   if (port >= num_ports) return -1;
+   rx_port_t *p = &ports[port];
+   if (p->line_rd == p->line_wr || size == 0) return -1;
+   uint16_t n = p->line_lens[p->line_rd];
+   if (n > size - 1) n = size - 1;
+   memcpy(out, p->lines[p->line_rd], n);
+   out[n] = '\0';
+   if (stamp) *stamp = p->line_stamps[p->line_rd];
+   p->line_rd = (uint8_t)((p->line_rd + 1) % UART_RX_LINES);
+   return (int)n;
+}
+
+int uart_rx_peek_first_port(uint8_t port)
+{
+   if (port >= num_ports) return -1;
+   rx_port_t *p = &ports[port];
+   if (p->line_rd == p->line_wr) return -1;
+   return (unsigned char)p->lines[p->line_rd][0];
+}
+
+int uart_rx_get_line(char *out, uint16_t size)
+{
+   return uart_rx_get_line_port(0, out, size, NULL);
+}
+
+int uart_rx_peek_first(void)
+{
+   return uart_rx_peek_first_port(0);
+}
+
+uint32_t uart_rx_dropped(void)
+{
+   uint32_t n = 0;
+   for (uint8_t i = 0; i < num_ports; ++i) n += ports[i].lines_dropped;
+   return n;
+}
@@ -0,0 +1,60 @@
+#ifndef UART_RX_H
+#define UART_RX_H
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+/*
+* uart_rx.h - DMA circular UART receive with idle-line framing.
+*
+* The DMA writes every received byte into a circular buffer on its own; the
+* HAL RX event callback (IDLE line, half and full transfer) hands new bytes to
+* a line assembler, and completed lines (terminated by CR, LF or CRLF) are
+* pushed into a small line queue. Nothing is lost while the application is
+* busy, as long as it drains the queue before UART_RX_LINES lines pile up.
+*
+* CubeMX: USART1 global interrupt on, USART1_RX on DMA2 Stream2 (or Stream5)
+* in CIRCULAR mode, byte width.
+*
+* Up to UART_RX_PORTS UARTs can be received at once (same setup each); the
+* first one started is port 0, which the plain calls below read. Every line
+* is stamped in the ISR that sees its terminator, with the clock set by
+* uart_rx_set_clock() (HAL_GetTick() if none).
+*
+* A port can also carry binary frames (proto.h): its hook sees every byte
+* first, with line_start set if no text is pending on the line, and takes
+* the bytes it returns 1 for out of the line assembler.
+*/
+#ifndef UART_RX_DMA_SIZE
+#define UART_RX_DMA_SIZE 256   /* raw DMA ring (bytes) */
+#endif
+#ifndef UART_LINE_MAX
+#define UART_LINE_MAX    64    /* longest line incl. terminating NUL */
+#endif
+#ifndef UART_RX_LINES
+#define UART_RX_LINES    8     /* completed lines kept until read */
+#endif
+#ifndef UART_RX_PORTS
+#define UART_RX_PORTS    1     /* UARTs received at once */
+#endif
+
+typedef uint32_t (*uart_rx_clock_fn_t)(void);
+typedef uint8_t (*uart_rx_hook_fn_t)(uint8_t ch, uint8_t line_start);
+
+/* Start (or restart) receiving on huart. Returns its port number, or -1 if
+   UART_RX_PORTS are already in use. */
+int uart_rx_start(UART_HandleTypeDef *huart);
+/* Clock for the line stamps, called from the UART ISRs */
+void uart_rx_set_clock(uart_rx_clock_fn_t now);
+/* Byte hook for a started port, called from its ISR (NULL removes it) */
+void uart_rx_set_hook(uint8_t port, uart_rx_hook_fn_t hook);
+/* Copy the oldest completed line into out (NUL-terminated, longer lines are
+   truncated). Returns its length, or -1 if no line is waiting. */
+int uart_rx_get_line(char *out, uint16_t size);
+/* First character of the oldest waiting line (0 for an empty line), or -1
+   if none; lets the caller route commands without consuming answers. */
+int uart_rx_peek_first(void);
+/* Same for any port; stamp (may be NULL) gets the time the terminator was seen */
+int uart_rx_get_line_port(uint8_t port, char *out, uint16_t size, uint32_t *stamp);
+int uart_rx_peek_first_port(uint8_t port);
+/* Lines lost because a queue was full (all ports) */
+uint32_t uart_rx_dropped(void);
+#endif /* UART_RX_H */
@@ -1,48 +1,88 @@
 #include "ws2812b.h"
+#include "delay.h"
+#include "probe.h"
+
+#if WS2812B_BACKEND == WS2812B_BACKEND_BITBANG
 
 // Timing values for the WS2812 (in nanoseconds)
 #define T0H  350  // 0 bit high time
 #define T1H  700  // 1 bit high time
 #define T0L  800  // 0 bit low time
 #define T1L  600  // 1 bit low time
+#define TRESET_US 300  // latch: >= 280 us low for newer parts
 
-// Convert nanoseconds to cycles, assumes 168MHz clock (STM32F4 default)
-// Adjust if using a different MCU/clock
-#define NS_TO_CYCLES(n)  ((n) * SystemCoreClock / 1000000000UL)
+// Convert nanoseconds to core cycles at the current SystemCoreClock.
+// Only evaluated in ws2812b_init(), never inside the bit loop.
+#define NS_TO_CYCLES(n)  (((n) * (SystemCoreClock / 1000000UL) + 500UL) / 1000UL)
 
-static void ws2812b_delay(uint32_t ns) {
-    uint32_t cycles = NS_TO_CYCLES(ns)/2; // Adjust loop to actual cycle count
-    while(cycles--) {
-        __NOP();
-    }
+// Edge times in DWT cycles, relative to the start of each bit
+static uint32_t cyc_0h, cyc_0bit;
+static uint32_t cyc_1h, cyc_1bit;
+
+void ws2812b_init(void) {
+    delay_init();
+    cyc_0h   = NS_TO_CYCLES(T0H);
+    cyc_0bit = NS_TO_CYCLES(T0H + T0L);
+    cyc_1h   = NS_TO_CYCLES(T1H);
+    cyc_1bit = NS_TO_CYCLES(T1H + T1L);
 }
 
+// Pin is driven through BSRR (one store, no read-modify-write, no call)
+// and every edge is placed against the free-running DWT cycle counter, so
+// timing does not depend on compiler optimisation level. Bit starts are
+// scheduled absolutely (t += bit period), so loop overhead never
+// accumulates over a long strip.
 void ws2812b_send(uint8_t *led_buffer, uint16_t led_count) {
+    if (cyc_0bit == 0) ws2812b_init();
+    PROBE_BEGIN(PROBE_WS2812B_SEND);
+
+    volatile uint32_t *bsrr = &WS2812B_PORT->BSRR;
+    const uint32_t set = WS2812B_PIN;
+    const uint32_t reset = (uint32_t)WS2812B_PIN << 16;
+    const uint32_t n = (uint32_t)led_count * 3;
+
     uint32_t irq_state = __get_PRIMASK();
     __disable_irq(); // Timing is critical!
 
-    for (uint16_t i = 0; i < led_count * 3; i++) {
+    uint32_t t = DWT->CYCCNT;
+    for (uint32_t i = 0; i < n; i++) {
         uint8_t cur_byte = led_buffer[i];
-        for (int8_t bit = 7; bit >= 0; bit--) {
-            if (cur_byte & (1 << bit)) {
-                // '1' bit
-                HAL_GPIO_WritePin(WS2812B_PORT, WS2812B_PIN, GPIO_PIN_SET);
-                ws2812b_delay(T1H);
-                HAL_GPIO_WritePin(WS2812B_PORT, WS2812B_PIN, GPIO_PIN_RESET);
-                ws2812b_delay(T1L);
+        for (uint8_t mask = 0x80; mask; mask >>= 1) {
+            uint32_t high, period;
+            if (cur_byte & mask) {
+                high = cyc_1h;   // '1' bit
+                period = cyc_1bit;
             } else {
-                // '0' bit
-                HAL_GPIO_WritePin(WS2812B_PORT, WS2812B_PIN, GPIO_PIN_SET);
-                ws2812b_delay(T0H);
-                HAL_GPIO_WritePin(WS2812B_PORT, WS2812B_PIN, GPIO_PIN_RESET);
-                ws2812b_delay(T0L);
+                high = cyc_0h;   // '0' bit
+                period = cyc_0bit;
             }
+            while ((int32_t)(DWT->CYCCNT - t) < 0) { }  // wait for bit start
+            *bsrr = set;
+            while ((DWT->CYCCNT - t) < high) { }
+            *bsrr = reset;
+            t += period;
         }
     }
-    // Reset pulse: > 50us
-    HAL_GPIO_WritePin(WS2812B_PORT, WS2812B_PIN, GPIO_PIN_RESET);
-    HAL_Delay(1);
+    // let the last low time elapse before the reset pulse starts counting
+    while ((int32_t)(DWT->CYCCNT - t) < 0) { }
 
     // Restore IRQs
     if (!irq_state) __enable_irq();
+
+    // Reset pulse: line is already low, only the latch time remains
+    delay_us(TRESET_US);
+    PROBE_END(PROBE_WS2812B_SEND);
 }
+
+int ws2812b_busy(void) {
+    return 0;
+}
+
+// Bit-banging cannot run in the background: send now, then report done
+int ws2812b_send_async(uint8_t *led_buffer, uint16_t led_count, ws2812b_done_cb_t cb) {
+    ws2812b_send(led_buffer, led_count);
+    if (cb) cb();
+    return 0;
+}
+
+#endif
@@ -7,6 +7,45 @@
 #define WS2812B_PORT    GPIOB
 #define WS2812B_PIN     GPIO_PIN_1
 
+// Output backend, selected at compile time
+//   BITBANG: GPIO toggling with interrupts disabled for the whole frame
+//   TIMER:   PWM on a timer channel fed by circular DMA, IRQs stay enabled
+//            (default: TIM3_CH4 on PB1/AF2, DMA1 Stream2 Channel5,
+//             memory->peripheral, half-word, circular)
+//   SPI:     each bit sent as a 3-bit (100/110) or 4-bit (1000/1100) symbol on
+//            SPI MOSI with circular byte DMA, for pins without a timer channel
+//            (e.g. SPI1 MOSI on PA7/PB5; 8-bit, MSB first, TX only, prescaler
+//             giving ~2.4-2.8 MHz for 3-bit or ~3.2 MHz for 4-bit symbols)
+#define WS2812B_BACKEND_BITBANG 0
+#define WS2812B_BACKEND_TIMER   1
+#define WS2812B_BACKEND_SPI     2
+#ifndef WS2812B_BACKEND
+#define WS2812B_BACKEND WS2812B_BACKEND_TIMER
+#endif
+// SPI backend: SPI bits per WS2812B bit (3 or 4)
+#ifndef WS2812B_SPI_BITS
+#define WS2812B_SPI_BITS 3
+#endif
+
+// Called from interrupt context once the reset (latch) time has elapsed
+typedef void (*ws2812b_done_cb_t)(void);
+
+#if WS2812B_BACKEND == WS2812B_BACKEND_TIMER
+// The timer must be configured for PWM on that channel with its DMA request
+// linked; ws2812b_init() sets prescaler/period for 800 kHz itself.
+void ws2812b_init(TIM_HandleTypeDef *htim, uint32_t channel);
+#elif WS2812B_BACKEND == WS2812B_BACKEND_SPI
+// The SPI must be configured (clock, circular TX DMA) as described above
+void ws2812b_init(SPI_HandleTypeDef *hspi);
+#else
+void ws2812b_init(void);
+#endif
+
+// Blocking: returns after the frame has been latched
 void ws2812b_send(uint8_t *led_buffer, uint16_t led_count);
+// Non-blocking: returns immediately, led_buffer must stay valid until cb.
+// Returns 0 if started, -1 if a frame is still being sent.
+int ws2812b_send_async(uint8_t *led_buffer, uint16_t led_count, ws2812b_done_cb_t cb);
+int ws2812b_busy(void);
 
 #endif
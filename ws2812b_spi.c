@@ -0,0 +1,149 @@
+#include "ws2812b.h"
+#include "probe.h"
+
+#if WS2812B_BACKEND == WS2812B_BACKEND_SPI
+
+// SPI + DMA backend.
+//
+// Every WS2812B bit becomes a WS2812B_SPI_BITS-bit symbol on MOSI: a short
+// high for '0' (100 / 1000) and a long high for '1' (110 / 1100). A whole
+// GRB byte maps to 24 or 32 SPI bits through a 256-entry table built at
+// compile time, so encoding costs one table load and three or four byte
+// stores per colour byte. Like the timer backend, the DMA buffer is
+// circular with two halves refilled from the half/complete interrupts.
+
+#if WS2812B_SPI_BITS == 3
+#define SYM0  0x4UL   // 100
+#define SYM1  0x6UL   // 110
+#elif WS2812B_SPI_BITS == 4
+#define SYM0  0x8UL   // 1000
+#define SYM1  0xCUL   // 1100
+#else
+#error "WS2812B_SPI_BITS must be 3 or 4"
+#endif
+
+#define SYM_BYTES  WS2812B_SPI_BITS   // SPI bytes per colour byte
+
+#define SB(b, i)   (((((b) >> (i)) & 1U) ? SYM1 : SYM0) << (WS2812B_SPI_BITS * (i)))
+#define ENC(b)     (SB(b, 7) | SB(b, 6) | SB(b, 5) | SB(b, 4) | \
+                    SB(b, 3) | SB(b, 2) | SB(b, 1) | SB(b, 0))
+#define E4(b)      ENC(b), ENC((b) + 1), ENC((b) + 2), ENC((b) + 3)
+#define E16(b)     E4(b), E4((b) + 4), E4((b) + 8), E4((b) + 12)
+#define E64(b)     E16(b), E16((b) + 16), E16((b) + 32), E16((b) + 48)
+
+// Byte -> symbol stream, right-aligned, sent MSB first
+static const uint32_t sym_lut[256] = {
+    E64(0), E64(64), E64(128), E64(192)
+};
+
+// LEDs encoded per half buffer
+#ifndef WS2812B_DMA_LEDS
+#define WS2812B_DMA_LEDS 8
+#endif
+
+#define WS2812B_HALF_LEN   (WS2812B_DMA_LEDS * 3 * SYM_BYTES)
+
+// Reset (latch) time: >= 280 us of MOSI low. Half duration depends on the
+// SPI clock, so it is computed in ws2812b_init().
+#define WS2812B_RESET_US   300
+
+static uint8_t dma_buf[2 * WS2812B_HALF_LEN];
+
+static SPI_HandleTypeDef *ws_hspi = NULL;
+static uint8_t reset_halves = 1;
+
+static uint8_t *frame = NULL;
+static uint32_t frame_len = 0;   // bytes
+static uint32_t frame_pos = 0;   // next byte to encode
+static uint8_t zero_halves = 0;
+static ws2812b_done_cb_t done_cb = NULL;
+static volatile uint8_t busy = 0;
+
+static void fill_half(uint8_t *dst)
+{
+    uint32_t n = 0;
+    while (n < WS2812B_HALF_LEN && frame_pos < frame_len) {
+        uint32_t sym = sym_lut[frame[frame_pos++]];
+#if WS2812B_SPI_BITS == 4
+        dst[n++] = (uint8_t)(sym >> 24);
+#endif
+        dst[n++] = (uint8_t)(sym >> 16);
+        dst[n++] = (uint8_t)(sym >> 8);
+        dst[n++] = (uint8_t)sym;
+    }
+    if (n == 0) zero_halves++;
+    while (n < WS2812B_HALF_LEN) dst[n++] = 0;
+}
+
+void ws2812b_init(SPI_HandleTypeDef *hspi)
+{
+    ws_hspi = hspi;
+
+    // Derive the SPI bit clock from the configured prescaler
+    // (BaudRatePrescaler field is the BR[2:0] value shifted to bit 3)
+    uint32_t pclk = HAL_RCC_GetPCLK2Freq();
+    uint32_t div = 2UL << ((hspi->Init.BaudRatePrescaler >> 3) & 0x7U);
+    uint32_t bit_hz = pclk / div;
+    if (bit_hz == 0) bit_hz = 1;
+
+    // One half lasts HALF_LEN * 8 SPI bits
+    uint32_t half_us = (uint32_t)(((uint64_t)WS2812B_HALF_LEN * 8U * 1000000U) / bit_hz);
+    if (half_us == 0) half_us = 1;
+    reset_halves = (uint8_t)((WS2812B_RESET_US + half_us - 1) / half_us);
+}
+
+int ws2812b_busy(void)
+{
+    return busy;
+}
+
+int ws2812b_send_async(uint8_t *led_buffer, uint16_t led_count, ws2812b_done_cb_t cb)
+{
+    if (busy || ws_hspi == NULL) return -1;
+
+    frame = led_buffer;
+    frame_len = (uint32_t)led_count * 3;
+    frame_pos = 0;
+    zero_halves = 0;
+    done_cb = cb;
+    busy = 1;
+
+    fill_half(&dma_buf[0]);
+    fill_half(&dma_buf[WS2812B_HALF_LEN]);
+    if (HAL_SPI_Transmit_DMA(ws_hspi, dma_buf, 2 * WS2812B_HALF_LEN) != HAL_OK) {
+        busy = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void ws2812b_send(uint8_t *led_buffer, uint16_t led_count)
+{
+    PROBE_BEGIN(PROBE_WS2812B_SEND);
+    while (ws2812b_send_async(led_buffer, led_count, NULL) != 0) { }
+    while (busy) { }
+    PROBE_END(PROBE_WS2812B_SEND);
+}
+
+static void half_done(uint8_t *half)
+{
+    if (zero_halves > reset_halves) {
+        HAL_SPI_DMAStop(ws_hspi);
+        busy = 0;
+        if (done_cb) done_cb();
+        return;
+    }
+    fill_half(half);
+}
+
+void HAL_SPI_TxHalfCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == ws_hspi && busy) half_done(&dma_buf[0]);
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == ws_hspi && busy) half_done(&dma_buf[WS2812B_HALF_LEN]);
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include "ws2812b.h"
+#include "probe.h"
+
+#if WS2812B_BACKEND == WS2812B_BACKEND_TIMER
+
+// Timer PWM + DMA backend.
+//
+// Each bit is one 1.25 us PWM period; the compare value (high time) comes
+// from a small circular DMA buffer split in two halves. While DMA plays one
+// half, the half/complete interrupts encode the next WS2812B_DMA_LEDS LEDs
+// into the other half, so RAM use does not grow with the strip length and
+// the CPU only spends a few microseconds per interrupt.
+
+// LEDs encoded per half buffer (each half lasts WS2812B_DMA_LEDS * 30 us)
+#ifndef WS2812B_DMA_LEDS
+#define WS2812B_DMA_LEDS 4
+#endif
+
+// Reset (latch) time in halves of zero duty: >= 280 us for newer parts
+#define WS2812B_RESET_US     300
+#define WS2812B_HALF_US      (WS2812B_DMA_LEDS * 24 * 125 / 100)
+#define WS2812B_RESET_HALVES ((WS2812B_RESET_US + WS2812B_HALF_US - 1) / WS2812B_HALF_US)
+
+// Timer input clock. APB timers run at 2x PCLK when the APB prescaler != 1.
+#ifndef WS2812B_TIM_CLK_HZ
+#define WS2812B_TIM_CLK_HZ   0   // 0 = derive from PCLK1 at init
+#endif
+
+#define WS2812B_HALF_LEN     (WS2812B_DMA_LEDS * 24)
+
+static uint16_t dma_buf[2 * WS2812B_HALF_LEN];
+
+static TIM_HandleTypeDef *ws_htim = NULL;
+static uint32_t ws_channel = 0;
+static uint16_t duty_0 = 0, duty_1 = 0;
+
+static uint8_t *frame = NULL;
+static uint32_t frame_len = 0;   // bytes
+static uint32_t frame_pos = 0;   // next byte to encode
+static uint8_t zero_halves = 0;  // halves of reset encoded so far
+static ws2812b_done_cb_t done_cb = NULL;
+static volatile uint8_t busy = 0;
+
+// Encode the next chunk of the frame (or reset slots) into one half
+static void fill_half(uint16_t *dst)
+{
+    uint32_t n = 0;
+    while (n < WS2812B_HALF_LEN && frame_pos < frame_len) {
+        uint8_t b = frame[frame_pos++];
+        for (uint8_t mask = 0x80; mask; mask >>= 1) {
+            dst[n++] = (b & mask) ? duty_1 : duty_0;
+        }
+    }
+    if (n == 0) zero_halves++;
+    while (n < WS2812B_HALF_LEN) dst[n++] = 0;
+}
+
+void ws2812b_init(TIM_HandleTypeDef *htim, uint32_t channel)
+{
+    ws_htim = htim;
+    ws_channel = channel;
+
+    uint32_t clk = WS2812B_TIM_CLK_HZ;
+    if (clk == 0) {
+        clk = HAL_RCC_GetPCLK1Freq();
+        if (clk != HAL_RCC_GetHCLKFreq()) clk *= 2;
+    }
+    // 800 kHz bit rate, no prescaler: period in timer ticks
+    uint32_t period = (clk + 400000UL) / 800000UL;
+    duty_0 = (uint16_t)((clk / 1000UL * 350UL + 500000UL) / 1000000UL);  // T0H 350 ns
+    duty_1 = (uint16_t)((clk / 1000UL * 700UL + 500000UL) / 1000000UL);  // T1H 700 ns
+
+    __HAL_TIM_SET_PRESCALER(htim, 0);
+    __HAL_TIM_SET_AUTORELOAD(htim, period - 1);
+    __HAL_TIM_SET_COMPARE(htim, channel, 0);
+}
+
+int ws2812b_busy(void)
+{
+    return busy;
+}
+
+int ws2812b_send_async(uint8_t *led_buffer, uint16_t led_count, ws2812b_done_cb_t cb)
+{
+    if (busy || ws_htim == NULL) return -1;
+
+    frame = led_buffer;
+    frame_len = (uint32_t)led_count * 3;
+    frame_pos = 0;
+    zero_halves = 0;
+    done_cb = cb;
+    busy = 1;
+
+    fill_half(&dma_buf[0]);
+    fill_half(&dma_buf[WS2812B_HALF_LEN]);
+    if (HAL_TIM_PWM_Start_DMA(ws_htim, ws_channel, (const uint32_t *)dma_buf, 2 * WS2812B_HALF_LEN) != HAL_OK) {
+        busy = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void ws2812b_send(uint8_t *led_buffer, uint16_t led_count)
+{
+    PROBE_BEGIN(PROBE_WS2812B_SEND);
+    while (ws2812b_send_async(led_buffer, led_count, NULL) != 0) { }
+    while (busy) { }
+    PROBE_END(PROBE_WS2812B_SEND);
+}
+
+// One half has finished playing: refill it, or stop once the reset time
+// has been fully played out
+static void half_done(uint16_t *half)
+{
+    if (zero_halves > WS2812B_RESET_HALVES) {
+        HAL_TIM_PWM_Stop_DMA(ws_htim, ws_channel);
+        __HAL_TIM_SET_COMPARE(ws_htim, ws_channel, 0);
+        busy = 0;
+        if (done_cb) done_cb();
+        return;
+    }
+    fill_half(half);
+}
+
+void HAL_TIM_PWM_PulseFinishedHalfCpltCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim == ws_htim && busy) half_done(&dma_buf[0]);
+}
+
+void HAL_TIM_PWM_PulseFinishedCallback(TIM_HandleTypeDef *htim)
+{
+    if (htim == ws_htim && busy) half_done(&dma_buf[WS2812B_HALF_LEN]);
+}
+
+#endif